@@ -0,0 +1,53 @@
+# Checks that traffic-sim-latency --scenarios prints for every scenario what
+# a run of its own (--delay, --links, --RngSeed) prints, i.e. that both fail
+# links from the same converged network.
+#   check-scenarios.py scenarios program [arguments...]
+# The arguments (topology, paths, packets, ...) are given to every run.
+import subprocess
+import sys
+
+def read_scenarios(filename):
+  # Same format as ParseScenarios: "<delay> [links] [seed]"
+  scenarios = []
+  for line in open(filename):
+    fields = line.split()
+    if not fields or fields[0].startswith('#'):
+      continue
+    links = [f for f in fields[1:] if '=' in f]
+    seeds = [f for f in fields[1:] if '=' not in f]
+    scenarios.append((fields[0], ','.join(links), seeds[-1] if seeds else None))
+  return scenarios
+
+def split_sweep(output):
+  # One chunk per "delay = " line, that line included
+  chunks = []
+  for line in output.splitlines(True):
+    if line.startswith('delay = '):
+      chunks.append('')
+    if chunks:
+      chunks[-1] += line
+  return chunks
+
+if __name__ == "__main__":
+  if len(sys.argv) < 3:
+    print "%s scenarios program [arguments...]"%(sys.argv[0])
+    sys.exit(1)
+  command = sys.argv[2:]
+  scenarios = read_scenarios(sys.argv[1])
+  sweep = split_sweep(subprocess.check_output(command + ['--scenarios=%s'%(sys.argv[1])]))
+  if len(sweep) != len(scenarios):
+    print "sweep ran %d of %d scenarios"%(len(sweep), len(scenarios))
+    sys.exit(1)
+  failed = 0
+  for i, (delay, links, seed) in enumerate(scenarios):
+    alone = command + ['--delay=%s'%(delay)]
+    if links:
+      alone.append('--links=%s'%(links))
+    if seed is not None:
+      alone.append('--RngSeed=%s'%(seed))
+    expected = sweep[i].split('\n', 1)[0] + '\n' + subprocess.check_output(alone)
+    if sweep[i] != expected:
+      print "scenario %d (%s) differs from %s"%(i + 1, ' '.join(filter(None, [delay, links, seed])), ' '.join(alone))
+      failed += 1
+  print "%d of %d scenarios match their own runs"%(len(scenarios) - failed, len(scenarios))
+  sys.exit(1 if failed else 0)
@@ -0,0 +1,64 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Merges the --stats summaries of traffic-sim-latency runs (for instance
+// one per seed) and prints latency, reordering and stretch per experiment
+// and delay, or writes the merged summary with --out.
+
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  std::string out;
+  CommandLine cmd;
+  cmd.AddValue("out", "Write the merged summary here instead of printing a table", out);
+  cmd.Parse(argc, argv);
+
+  Ptr<EchoStats> stats = CreateObject<EchoStats>();
+  uint32_t files = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 2, "--") == 0) {
+      continue;
+    }
+    std::ifstream in(arg.c_str());
+    if (!in.is_open() || !stats->Load(in)) {
+      std::cerr << "Cannot read summary " << arg << std::endl;
+      return 1;
+    }
+    files++;
+  }
+  if (files == 0) {
+    std::cerr << "Usage: " << argv[0] << " [--out=<summary>] <summary>..." << std::endl;
+    return 1;
+  }
+  if (!out.empty()) {
+    std::ofstream merged(out.c_str());
+    stats->Write(merged);
+  }
+  else {
+    stats->PrintTable(std::cout);
+  }
+  return 0;
+}
@@ -23,6 +23,7 @@
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/global-route-manager-impl.h"
 #include "ns3/partition-aggregate-client.h"
+#include "ns3/schedule-source.h"
 #include "boost/algorithm/string.hpp"
 #include "ns3/data-rate.h"
 #include "ns3/inet-socket-address.h"
@@ -69,6 +70,10 @@ class Topology : public Object
     double m_delay;
     double m_linkLatency;
     bool m_repair;
+    uint32_t m_bufferSize;
+    double m_bufferAlpha;
+    Ptr<ScheduleSource> m_schedule;
+    uint32_t m_requests;
   public:
     void SetRepair (bool repair)
     {
@@ -79,6 +84,25 @@ class Topology : public Object
       m_linkLatency = latency;
     }
 
+    // Switch ports also share a buffer of this many bytes, 0 for none
+    void SetSharedBuffer (uint32_t size, double alpha)
+    {
+      m_bufferSize = size;
+      m_bufferAlpha = alpha;
+    }
+
+    void PrintBufferStats ()
+    {
+      if (m_bufferSize == 0) {
+        return;
+      }
+      for (uint32_t i = 0; i < m_numNodes; i++) {
+        Ptr<SharedBuffer> buffer = m_nodes.Get(i)->GetObject<SharedBuffer>();
+        std::cout << m_nodeTranslate[i] << ",B," << buffer->GetAdmissionDrops()
+                  << "," << buffer->GetPeakOccupancy() << std::endl;
+      }
+    }
+
     void RetransmitCallback (std::string path, bool fastRetransmit)
     {
       std::cout << path << "," << (fastRetransmit ? "FR" : "T") << std::endl;
@@ -125,6 +149,9 @@ class Topology : public Object
       m_simulationEnd = Seconds(60.0 * 60.0 * 24 * 100);
       m_linkLatency = 10.0;
       m_repair = true;
+      m_bufferSize = 0;
+      m_bufferAlpha = 1.0;
+      m_requests = 0;
    }
    
     virtual ~Topology()
@@ -199,6 +226,11 @@ class Topology : public Object
       std::cout << "Latency = " << Time::FromDouble(m_linkLatency, Time::MS).GetMicroSeconds() << " us" << std::endl;
       pointToPoint.SetChannelAttribute("Delay", TimeValue(Time::FromDouble(m_linkLatency, Time::MS))); 
       Config::SetDefault ("ns3::RttEstimator::MinRTO", TimeValue(MilliSeconds(11)));
+      if (m_bufferSize > 0) {
+        // The port queues keep their type and limits, only admission
+        // into the shared buffer is added
+        pointToPoint.SetSharedBuffer("Size", UintegerValue(m_bufferSize), "Alpha", DoubleValue(m_bufferAlpha));
+      }
       for (uint32_t i = 0; i < m_numNodes; i++) {
         m_callbacks.push_back(NodeCallback(m_nodeTranslate[i], this));
         NS_ASSERT(!m_connectivityGraph[i]->empty());
@@ -304,48 +336,39 @@ class Topology : public Object
       m_channelMap[key]->SetLinkDown();
     }
 
+    // Events are read from the schedule as the simulation reaches them
     void ScheduleEvents (std::string schedule)
     {
-      std::ifstream scheduleFile(schedule.c_str());
-      NS_ASSERT(scheduleFile.is_open());
-      //boost::split(linkParts, links, boost::is_any_of(","));
-      uint32_t req = 0;
-      while (scheduleFile.good()) {
-        std::string input;
-        getline(scheduleFile, input);
-        if (input.empty()) {
-          continue;
-        }
-        std::vector<std::string> parts;
-        boost::split(parts, input, boost::is_any_of(" "));
-        double time = (double)std::atof(parts[0].c_str());
-        bool query = (parts[1].compare("q") == 0);
-        bool linkfail = (parts[1].compare("f") == 0);
-        if (query) {
-          uint32_t client = std::atoi(parts[2].c_str());
-          Ptr<Request> request = Create<Request> ();
-          request->client = client;
-          request->requestNumber = req;
-          request->issueTime = Seconds(time);
-          req++;
-          for (uint32_t it2 = 3; it2 < parts.size(); it2++) {
-            uint32_t serverIndex = std::atoi(parts[it2].c_str());
-            Ipv4Address server = m_nodes.Get(m_nodeForwardTranslationMap[serverIndex])->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
-            request->addresses.push_back(InetSocketAddress(server, 5000));
-            request->nodes[InetSocketAddress(server, 5000)] = serverIndex;
-          }
-          Simulator::Schedule(Seconds(time), &PartitionAggregateClient::IssueRequest, m_partClients[client], request);
+      m_schedule = CreateObject<ScheduleSource>();
+      bool opened = m_schedule->Open(schedule);
+      NS_ASSERT(opened);
+      m_schedule->SetEventCallback(MakeCallback(&Topology::RunEvent, this));
+      m_schedule->Start();
+      std::cout << "Done scheduling" << std::endl;
+    }
+
+    void RunEvent (const ScheduleEvent &event)
+    {
+      if (event.type == 'q') {
+        uint32_t client = event.args[0];
+        Ptr<Request> request = Create<Request> ();
+        request->client = client;
+        request->requestNumber = m_requests;
+        request->issueTime = event.time;
+        m_requests++;
+        for (uint32_t it2 = 1; it2 < event.args.size(); it2++) {
+          uint32_t serverIndex = event.args[it2];
+          Ipv4Address server = m_nodes.Get(m_nodeForwardTranslationMap[serverIndex])->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+          request->addresses.push_back(InetSocketAddress(server, 5000));
+          request->nodes[InetSocketAddress(server, 5000)] = serverIndex;
         }
-        else if (linkfail) {
-          for (uint32_t it3 = 2; it3 < parts.size(); it3++) {
-            std::vector<std::string> nodeParts;
-            boost::split(nodeParts, parts[it3], boost::is_any_of("="));
-            NS_ASSERT(nodeParts.size() == 2);
-            Simulator::Schedule(Seconds(time), &Topology::FailLink, this, std::atoi(nodeParts[0].c_str()), std::atoi(nodeParts[1].c_str()));
-          }
+        m_partClients[client]->IssueRequest(request);
+      }
+      else if (event.type == 'f') {
+        for (uint32_t it3 = 0; it3 + 1 < event.args.size(); it3 += 2) {
+          FailLink(event.args[it3], event.args[it3 + 1]);
         }
       }
-      std::cout << "Done scheduling" << std::endl;
     }
 };
 
@@ -427,22 +450,33 @@ main (int argc, char *argv[])
   double linkLatency = 0.5;
   std::string schedule;
   bool repair;
+  uint32_t bufferSize = 0;
+  double bufferAlpha = 1.0;
+  std::string binarySchedule;
   CommandLine cmd;
   cmd.AddValue("topology", "Topology file", topology);
   cmd.AddValue("delay", "Delay for repairs", delay);
   cmd.AddValue("latency", "Propagation delay (ms)", linkLatency);
   cmd.AddValue("schedule", "Simulation schedule", schedule);
   cmd.AddValue("repair", "Allow reversals", repair);
+  cmd.AddValue("buffer", "Bytes of a buffer the port queues of a switch also share, 0 for none", bufferSize);
+  cmd.AddValue("alpha", "Dynamic threshold of the shared buffer", bufferAlpha);
+  cmd.AddValue("binarySchedule", "Write the schedule in binary to this file and exit", binarySchedule);
   cmd.Parse(argc, argv);
+  if (!binarySchedule.empty()) {
+    return ScheduleSource::WriteBinary(schedule, binarySchedule) ? 0 : 1;
+  }
   std::cerr << "Repair  = " << repair <<std::endl;
   Topology simulationTopology;
   simulationTopology.SetRepair(repair);
   simulationTopology.SetDelay(delay);
   simulationTopology.SetPropagationDelay(linkLatency);
+  simulationTopology.SetSharedBuffer(bufferSize, bufferAlpha);
   simulationTopology.PopulateGraph(topology);
   simulationTopology.HookupSimulation();
   simulationTopology.ScheduleEvents(schedule);
   Simulator::Run ();
+  simulationTopology.PrintBufferStats();
   Simulator::Destroy ();
 
   return 0;
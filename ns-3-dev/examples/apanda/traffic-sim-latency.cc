@@ -25,6 +25,7 @@
 #include "ns3/global-route-manager-impl.h"
 #include "ns3/data-rate.h"
 #include "ns3/ipv4-header.h"
+#include "ns3/rng-stream.h"
 
 #include <list>
 #include <vector>
@@ -38,6 +39,11 @@
 #include <string>
 #include <utility>
 #include <functional>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "stretch-classes.h"
 
@@ -53,7 +59,6 @@ class Topology : public Object
     UniformVariable randVar;
     uint32_t m_numNodes;
     std::vector<std::list<uint32_t>*> m_connectivityGraph;
-    Time m_simulationEnd;
     std::vector<uint32_t> m_nodeTranslate;
     std::map<std::pair<uint32_t, uint32_t>, PointToPointChannel*> m_channelMap;
     std::map<uint32_t, uint32_t> m_nodeForwardTranslationMap;
@@ -63,13 +68,49 @@ class Topology : public Object
     std::vector<NetDeviceContainer> m_linkDevices;
     std::vector<NodeCallback> m_callbacks;
     std::vector<std::pair<uint32_t, uint32_t> > m_pathsToTest;
+    /// Echo client of each path to test, reused by every scenario of a sweep
+    std::vector<UdpEchoClient*> m_pathClients;
     uint32_t m_currentPath;
     uint32_t m_currentTrial;
     uint32_t m_packets;
     double m_delay;
     double m_linkLatency;
+    Ptr<TraceRecorder> m_recorder;
+    Ptr<EchoStats> m_stats;
+    Time m_epoch;
+    std::vector<std::pair<uint32_t, uint32_t> > m_failedLinks;
+
+    /// Links on a shortest path between two nodes, 0 if they are not connected
+    uint32_t Distance (uint32_t from, uint32_t to)
+    {
+      std::vector<uint32_t> distance(m_numNodes, 0);
+      std::list<uint32_t> queue;
+      queue.push_back(from);
+      while (!queue.empty() && from != to) {
+        uint32_t node = queue.front();
+        queue.pop_front();
+        for (std::list<uint32_t>::iterator it = m_connectivityGraph[node]->begin();
+             it != m_connectivityGraph[node]->end();
+             it++) {
+          if (*it != from && distance[*it] == 0) {
+            distance[*it] = distance[node] + 1;
+            if (*it == to) {
+              return distance[to];
+            }
+            queue.push_back(*it);
+          }
+        }
+      }
+      return 0;
+    }
   public:
     
+    /// Simulation time since the current scenario began
+    Time Now ()
+    {
+      return Simulator::Now() - m_epoch;
+    }
+
     void SetPropagationDelay (double latency) 
     {
       m_linkLatency = latency;
@@ -89,21 +130,96 @@ class Topology : public Object
     {
       uint32_t seq = 0;
       packet->CopyData ((uint8_t*)&seq, sizeof(seq));
-      std::cout << "TX_s," << Simulator::Now() << "," << CannonicalNode(AddressForNode(header.GetDestination()))
+      std::cout << "TX_s," << Now() << "," << CannonicalNode(AddressForNode(header.GetDestination()))
                 <<"," << CannonicalNode(AddressForNode(header.GetSource())) <<"," << seq << std::endl;
     }
 
     void ClienTx (Ptr<const Packet> packet, uint32_t node, Ipv4Address addr) {
       uint32_t seq = 0;
       packet->CopyData ((uint8_t*)&seq, sizeof(seq));
-      std::cout << "TX_c," << Simulator::Now() << "," << CannonicalNode(node)
+      std::cout << "TX_c," << Now() << "," << CannonicalNode(node)
                 <<"," << CannonicalNode(AddressForNode(addr)) << ","<< seq << std::endl;
     }
 
+    /// Record packet events in a binary trace rather than printing them
+    void SetTraceRecorder (Ptr<TraceRecorder> recorder)
+    {
+      m_recorder = recorder;
+    }
+
+    /// Summarize echoes in online statistics rather than printing them
+    void SetEchoStats (Ptr<EchoStats> stats)
+    {
+      m_stats = stats;
+    }
+
     void SetDelay(double delay)
     {
       m_delay = delay;
     }
+
+    /// Change the reversal delay of every router, in microseconds
+    void SetRepairDelay(double delay)
+    {
+      m_delay = delay;
+      for (uint32_t i = 0; i < m_numNodes; i++) {
+        Ptr<Ipv4GlobalRouting> gr = m_nodes.Get(i)->GetObject<GlobalRouter>()->GetRoutingProtocol();
+        gr->SetAttribute("ReverseOutputToInputDelay", TimeValue(Seconds(m_delay * 1e-6)));
+        gr->SetAttribute("ReverseInputToOutputDelay", TimeValue(Seconds(m_delay * 1e-6)));
+      }
+    }
+
+    /**
+     * Start a scenario on the converged network: fail the given links and
+     * echo over the given paths with the given reversal delay.  Times are
+     * printed relative to the failures, as in a run of its own.
+     */
+    void BeginScenario(double delay,
+                       std::vector<std::pair<uint32_t, uint32_t> >& links,
+                       std::vector<std::pair<uint32_t, uint32_t> >& paths)
+    {
+      SetRepairDelay(delay);
+      if (m_stats) {
+        m_stats->SetAttribute("Delay", DoubleValue(delay));
+      }
+      m_epoch = Simulator::Now();
+      if (m_recorder) {
+        m_recorder->SetEpoch(m_epoch);
+      }
+      for (std::vector<std::pair<uint32_t, uint32_t> >::iterator it = links.begin();
+           it != links.end();
+           it++) {
+        Simulator::ScheduleNow(&Topology::FailLinkPair, this, *it);
+      }
+      if (m_pathClients.empty()) {
+        AddPathsToTest(paths);
+        return;
+      }
+      NS_ASSERT(paths == m_pathsToTest);
+      if (m_stats) {
+        m_stats->Restart();
+      }
+      // Draw the intervals again from a new stream, which starts from the
+      // seed of this scenario as the first one did
+      randVar = UniformVariable();
+      for (uint32_t path = 0; path < m_pathClients.size(); path++) {
+        m_pathClients[path]->SetAttribute("Interval", TimeValue(Seconds(randVar.GetValue(1.0, 3000.0))));
+        StartPath(path);
+      }
+    }
+
+    /// Repair the failed links and return routing to its converged state
+    void EndScenario()
+    {
+      for (std::vector<std::pair<uint32_t, uint32_t> >::iterator it = m_failedLinks.begin();
+           it != m_failedLinks.end();
+           it++) {
+        m_channelMap[*it]->SetLinkUp();
+      }
+      m_failedLinks.clear();
+      Simulator::Run();
+      GlobalRouteManager::RestoreRoutingState();
+    }
     void AddPathsToTest(std::vector<std::pair<uint32_t, uint32_t> > paths)
     {
       m_pathsToTest.insert(m_pathsToTest.end(), paths.begin(), paths.end());
@@ -117,15 +233,31 @@ class Topology : public Object
         echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
         ApplicationContainer clientApps = echoClient.Install (m_nodes.Get (client));
         UdpEchoClient* clientApp = (UdpEchoClient*)(PeekPointer(clientApps.Get(0)));
-        clientApp->AddReceivePacketEvent(MakeCallback(&NodeCallback::RxPacket, &m_callbacks[client]));
-        clientApp->AddTransmitPacketEvent(MakeCallback(&Topology::ClienTx, this));
-        std::cout << m_pathsToTest[m_currentPath].first << "," << m_pathsToTest[m_currentPath].second << ",S" << std::endl;
+        if (m_stats) {
+          m_stats->ConnectUdpEchoClient(clientApp, m_pathsToTest[m_currentPath].first,
+                                        m_pathsToTest[m_currentPath].second, Distance(client, server));
+        }
+        if (m_recorder) {
+          m_recorder->ConnectUdpEchoClient(clientApp);
+        }
+        if (!m_recorder && !m_stats) {
+          clientApp->AddReceivePacketEvent(MakeCallback(&NodeCallback::RxPacket, &m_callbacks[client]));
+          clientApp->AddTransmitPacketEvent(MakeCallback(&Topology::ClienTx, this));
+        }
         clientApp->SetRemote(m_nodes.Get(server)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal(), 9);
-        Simulator::ScheduleNow(&UdpEchoClient::StartApplication, clientApp);
-        Simulator::Schedule(Seconds(2.0), &Topology::PingMachines, this, clientApp);
+        m_pathClients.push_back(clientApp);
+        StartPath(m_currentPath);
       }
     }
 
+    /// Echo a burst over the path to test with the given index
+    void StartPath(uint32_t path)
+    {
+      std::cout << m_pathsToTest[path].first << "," << m_pathsToTest[path].second << ",S" << std::endl;
+      Simulator::ScheduleNow(&UdpEchoClient::StartApplication, m_pathClients[path]);
+      Simulator::Schedule(Seconds(2.0), &Topology::PingMachines, this, m_pathClients[path]);
+    }
+
     void RouteEnded ()
     {
       NS_ASSERT(false);
@@ -157,9 +289,9 @@ class Topology : public Object
       m_numNodes = 0;
       m_currentPath = 0;
       m_currentTrial = 0;
-      m_simulationEnd = Seconds(60.0 * 60.0 * 24 * 7);
       m_packets = 0;
       m_linkLatency = 1.0;
+      m_epoch = Seconds(0);
    }
    
     virtual ~Topology()
@@ -223,6 +355,9 @@ class Topology : public Object
     {
       NS_LOG_INFO("Creating nodes");
       m_nodes.Create (m_numNodes);
+      if (m_recorder) {
+        m_recorder->SetNodeLabels(m_nodeTranslate);
+      }
       m_nodeDevices.resize(m_numNodes);
       NS_LOG_INFO("Creating point to point connections");
       PointToPointHelper pointToPoint;
@@ -242,9 +377,15 @@ class Topology : public Object
           NetDeviceContainer p2pDevices = 
             pointToPoint.Install (m_nodes.Get(i), m_nodes.Get(*iterator));
           m_nodeDevices[i].Add(p2pDevices.Get(0));
-          p2pDevices.Get(0)->TraceConnectWithoutContext("MacTxDrop", MakeCallback(&NodeCallback::PhyDropTrace, &m_callbacks[i]));
           m_nodeDevices[*iterator].Add(p2pDevices.Get(1));
-          p2pDevices.Get(1)->TraceConnectWithoutContext("MacTxDrop", MakeCallback(&NodeCallback::PhyDropTrace, &m_callbacks[*iterator]));
+          if (m_recorder) {
+            m_recorder->ConnectMacTxDrop(p2pDevices.Get(0));
+            m_recorder->ConnectMacTxDrop(p2pDevices.Get(1));
+          }
+          if (!m_recorder && !m_stats) {
+            p2pDevices.Get(0)->TraceConnectWithoutContext("MacTxDrop", MakeCallback(&NodeCallback::PhyDropTrace, &m_callbacks[i]));
+            p2pDevices.Get(1)->TraceConnectWithoutContext("MacTxDrop", MakeCallback(&NodeCallback::PhyDropTrace, &m_callbacks[*iterator]));
+          }
           m_linkDevices.push_back(p2pDevices);
           PointToPointChannel* channel = (PointToPointChannel*)GetPointer(p2pDevices.Get(0)->GetChannel());
           m_channels.push_back(channel);
@@ -288,8 +429,8 @@ class Topology : public Object
       UdpEchoServerHelper echoServer (9);
 
       ApplicationContainer serverApps = echoServer.Install (m_nodes);
+      // Servers run to the end, so that every scenario finds them up
       serverApps.Start (Seconds (1.0));
-      serverApps.Stop (m_simulationEnd);
       m_clients.resize(m_numNodes);
       m_servers.resize(m_numNodes);
       for (uint32_t i = 0; i < m_numNodes; i++) {
@@ -298,10 +439,18 @@ class Topology : public Object
         gr->SetAttribute("ReverseOutputToInputDelay", TimeValue(Seconds(m_delay * 1e-6)));
         gr->SetAttribute("ReverseInputToOutputDelay", TimeValue(Seconds(m_delay * 1e-6)));
         Ptr<Ipv4L3Protocol> l3 = m_nodes.Get(i)->GetObject<Ipv4L3Protocol>();
-        l3->TraceConnectWithoutContext("Drop", MakeCallback(&NodeCallback::DropTrace, &m_callbacks[i]));
         l3->SetAttribute("DefaultTtl", UintegerValue(255));
-        gr->AddReversalCallback(MakeCallback(&NodeCallback::NodeReversal, &m_callbacks[i]));
         m_servers[i] =  (UdpEchoServer*)PeekPointer(serverApps.Get(i));
+        if (m_recorder) {
+          m_recorder->ConnectIpv4Drop(m_nodes.Get(i));
+          m_recorder->ConnectReversals(m_nodes.Get(i));
+          m_recorder->ConnectUdpEchoServer(m_servers[i]);
+        }
+        if (m_recorder || m_stats) {
+          continue;
+        }
+        l3->TraceConnectWithoutContext("Drop", MakeCallback(&NodeCallback::DropTrace, &m_callbacks[i]));
+        gr->AddReversalCallback(MakeCallback(&NodeCallback::NodeReversal, &m_callbacks[i]));
         m_servers[i]->AddReceivePacketEvent(MakeCallback(&NodeCallback::ServerRxPacket, &m_callbacks[i]));
         m_servers[i]->AddTransmitPacketEvent(MakeCallback(&Topology::ServerTx, this));
       }
@@ -318,7 +467,14 @@ class Topology : public Object
       NS_LOG_LOGIC("Sending between " << client);
       Simulator::ScheduleNow(&UdpEchoClient::StartApplication, client);
       uint32_t controlFlag = Ipv4Header::GetControlFlag();
-      Simulator::Schedule(Seconds(1.0), &UdpEchoClient::SendBurst, client, m_packets, MicroSeconds(900), controlFlag);
+      Simulator::Schedule(Seconds(1.0), &Topology::SendBurst, this, client, controlFlag);
+    }
+
+    void SendBurst (UdpEchoClient* client, uint32_t flags)
+    {
+      // Keep the offset UdpEchoClient::SendBurst gives a run of its own,
+      // measured from the start of the scenario
+      client->SendBurstAfter(m_packets, Now(), MicroSeconds(900), flags);
     }
     
     void FailLink (uint32_t from, uint32_t to)
@@ -333,6 +489,7 @@ class Topology : public Object
       NS_LOG_LOGIC("Failing link between " << key.first << " and " << key.second);
       std::cout << key.first << "," << key.second << ",F" << std::endl;
       m_channelMap[key]->SetLinkDown();
+      m_failedLinks.push_back(key);
     }
 };
 
@@ -341,7 +498,7 @@ void NodeCallback::RxPacket (Ptr<const Packet> packet, Ipv4Header& header) {
   NS_LOG_LOGIC(m_id << " Received packet " << (uint32_t)header.GetTtl());
   uint32_t seq = 0;
   packet->CopyData ((uint8_t*)&seq, sizeof(seq));
-  std::cout << "RX_s,"<< Simulator::Now() << "," << m_topology->CannonicalNode(m_topology->AddressForNode(header.GetSource()))
+  std::cout << "RX_s,"<< m_topology->Now() << "," << m_topology->CannonicalNode(m_topology->AddressForNode(header.GetSource()))
             <<"," << m_id << ","<< seq << std::endl;
 }
 
@@ -349,7 +506,7 @@ void NodeCallback::ServerRxPacket (Ptr<const Packet> packet, Ipv4Header& header)
   NS_LOG_LOGIC(m_id << " Server Received packet " << (uint32_t)header.GetTtl());
   uint32_t seq = 0;
   packet->CopyData ((uint8_t*)&seq, sizeof(seq));
-  std::cout << "RX_c," << Simulator::Now() << "," << m_topology->CannonicalNode(m_topology->AddressForNode(header.GetSource()))
+  std::cout << "RX_c," << m_topology->Now() << "," << m_topology->CannonicalNode(m_topology->AddressForNode(header.GetSource()))
             <<"," << m_id << ","<< seq << std::endl;
   //std::cout << seq << ",";
 }
@@ -361,13 +518,13 @@ void NodeCallback::NodeReversal (uint32_t iface, Ipv4Address addr) {
 
 void NodeCallback::DropTrace (const Ipv4Header& hdr, Ptr<const Packet> packet, Ipv4L3Protocol::DropReason drop, Ptr<Ipv4> ipv4, uint32_t iface) {
   NS_LOG_LOGIC(m_id << " dropped packet " << iface);
-  std::cout << "D,"<<Simulator::Now() << "," <<  m_topology->CannonicalNode(m_topology->AddressForNode(hdr.GetSource()))
+  std::cout << "D,"<<m_topology->Now() << "," <<  m_topology->CannonicalNode(m_topology->AddressForNode(hdr.GetSource()))
             << "," << m_topology->CannonicalNode(m_topology->AddressForNode(hdr.GetDestination()))
             << ",D(" << (uint32_t)hdr.GetTtl() << ")" << std::endl;
 }
 
 void NodeCallback::PhyDropTrace (Ptr<const Packet> p) {
-  std::cout << "P," << Simulator::Now() << std::endl;
+  std::cout << "P," << m_topology->Now() << std::endl;
 }
 
 void
@@ -385,6 +542,122 @@ ParseLinks(std::string links, std::vector<std::pair<uint32_t, uint32_t> >& resul
   }
 }
 
+/**
+ * A scenario of a sweep: a reversal delay, the links to fail, a seed and
+ * the experiment label of its paths in the --stats summary
+ */
+struct Scenario
+{
+  double delay;
+  std::vector<std::pair<uint32_t, uint32_t> > links;
+  uint32_t seed;
+  std::string experiment;
+};
+
+/**
+ * Read one scenario per line, "<delay> [<links>] [<seed>]" with the links
+ * as for --links; a seed of 0 or none keeps the seed of the command line.
+ * Blank lines and lines starting with # are skipped.
+ */
+bool
+ParseScenarios(std::string filename, std::vector<Scenario>& results)
+{
+  std::ifstream in(filename.c_str());
+  if (!in.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (getline(in, line)) {
+    boost::trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    Scenario scenario;
+    scenario.seed = 0;
+    if (!(fields >> scenario.delay)) {
+      return false;
+    }
+    std::string field;
+    while (fields >> field) {
+      if (field.find("=") != std::string::npos) {
+        ParseLinks(field, scenario.links);
+      }
+      else {
+        scenario.seed = std::atoi(field.c_str());
+      }
+    }
+    results.push_back(scenario);
+  }
+  return true;
+}
+
+/**
+ * Seed the random variables a scenario draws from first.  SeedManager
+ * alone only counts before the first variable is drawn from.
+ */
+void
+SetScenarioSeed(uint32_t seed)
+{
+  SeedManager::SetSeed(seed);
+  RngStream::SetPackageSeed(seed);
+}
+
+/**
+ * Run one scenario of a sweep in a child process, which shares the
+ * converged network with its parent until either writes to it.  The
+ * child prints to output and writes its summary, if any, to stats.
+ */
+pid_t
+ForkScenario(Topology& topology, Scenario& scenario,
+             std::vector<std::pair<uint32_t, uint32_t> >& paths,
+             std::string output, Ptr<EchoStats> echoStats, std::string stats)
+{
+  std::cout.flush();
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+  if (!std::freopen(output.c_str(), "w", stdout)) {
+    std::cerr << "Cannot create " << output << std::endl;
+    _exit(1);
+  }
+  SetScenarioSeed(scenario.seed);
+  if (echoStats) {
+    echoStats->SetAttribute("Experiment", StringValue(scenario.experiment));
+  }
+  std::cout << "delay = " << scenario.delay << std::endl;
+  topology.BeginScenario(scenario.delay, scenario.links, paths);
+  Simulator::Run ();
+  if (echoStats) {
+    std::ofstream summary(stats.c_str());
+    echoStats->Write(summary);
+  }
+  std::cout.flush();
+  // Skip the destructors, the parent still owns the network
+  _exit(std::ferror(stdout) ? 1 : 0);
+}
+
+/**
+ * Wait for whichever forked scenario ends first and take it off running;
+ * false if it failed or none can be waited for (running is then cleared)
+ */
+bool
+WaitScenario(std::list<pid_t>& running)
+{
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, 0)) < 0) {
+    if (errno != EINTR) {
+      std::perror("waitpid");
+      running.clear();
+      return false;
+    }
+  }
+  running.remove(pid);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -395,6 +668,12 @@ main (int argc, char *argv[])
   std::string topology;
   std::string links;
   std::string paths;
+  std::string trace;
+  std::string stats;
+  std::string experiment = "latency";
+  std::string scenarios;
+  std::string output = "scenario";
+  uint32_t workers = 0;
   uint32_t packets = 1;
   double delay = 0.0;
   double linkLatency = 1.0;
@@ -409,6 +688,12 @@ main (int argc, char *argv[])
   cmd.AddValue("packets", "Packets to send per trial", packets);
   cmd.AddValue("delay", "Delay for repairs (microseconds)", delay);
   cmd.AddValue("latency", "Propagation delay (ms)", linkLatency);
+  cmd.AddValue("trace", "Write packet events to this binary trace instead of stdout", trace);
+  cmd.AddValue("stats", "Write a mergeable summary of each path to this file instead of packet events", stats);
+  cmd.AddValue("experiment", "Label of the paths in the --stats summary (\"/<n>\" added for scenario n)", experiment);
+  cmd.AddValue("scenarios", "Run each \"<delay> [links] [seed]\" line of this file on one converged network", scenarios);
+  cmd.AddValue("workers", "Run this many --scenarios at once in forked processes (0 runs them in turn)", workers);
+  cmd.AddValue("output", "Prefix of the output (and --stats) files of forked scenarios, numbered from 1", output);
   cmd.Parse(argc, argv);
   if (!links.empty()) {
     ParseLinks(links, linksToFail);
@@ -416,25 +701,123 @@ main (int argc, char *argv[])
   if (!paths.empty()) {
     ParseLinks(paths, pathsToTest);
   }
+  std::vector<Scenario> sweep;
+  if (!scenarios.empty()) {
+    if (!trace.empty()) {
+      std::cerr << "--trace cannot be combined with --scenarios" << std::endl;
+      return 1;
+    }
+    if (!ParseScenarios(scenarios, sweep)) {
+      std::cerr << "Cannot read scenarios from " << scenarios << std::endl;
+      return 1;
+    }
+    // Scenarios without a seed go back to the one of the command line, so
+    // they draw the same in turn after a seeded scenario as in a worker.
+    // Paths are summarized per scenario, numbered from 1 as the outputs are,
+    // since scenarios of the same delay would otherwise merge.
+    uint32_t seed = SeedManager::GetSeed();
+    for (uint32_t i = 0; i < sweep.size(); i++) {
+      if (sweep[i].seed == 0) {
+        sweep[i].seed = seed;
+      }
+      std::ostringstream label;
+      label << experiment << "/" << i + 1;
+      sweep[i].experiment = label.str();
+    }
+  }
   Topology simulationTopology;
   simulationTopology.SetDelay(delay);
   simulationTopology.SetPackets(packets);
   simulationTopology.SetPropagationDelay(linkLatency);
+  Ptr<TraceRecorder> recorder;
+  if (!trace.empty()) {
+    recorder = CreateObject<TraceRecorder>();
+    if (!recorder->Open(trace)) {
+      std::cerr << "Cannot create " << trace << std::endl;
+      return 1;
+    }
+    simulationTopology.SetTraceRecorder(recorder);
+  }
+  Ptr<EchoStats> echoStats;
+  if (!stats.empty()) {
+    echoStats = CreateObject<EchoStats>();
+    echoStats->SetAttribute("Experiment", StringValue(experiment));
+    echoStats->SetAttribute("Delay", DoubleValue(delay));
+    echoStats->SetAttribute("InitialTtl", UintegerValue(255));
+    simulationTopology.SetEchoStats(echoStats);
+  }
   simulationTopology.PopulateGraph(topology);
   simulationTopology.HookupSimulation();
+  // Let the network converge, so that links fail in the same state whether
+  // alone or in a scenario; every scenario then gets a copy of this state
+  Simulator::Run ();
+  if (!scenarios.empty()) {
+    if (workers > 0) {
+      // Every worker starts from the converged state, so there is nothing to
+      // save or restore
+      std::list<pid_t> running;
+      uint32_t failed = 0;
+      for (uint32_t i = 0; i < sweep.size(); i++) {
+        if (running.size() == workers) {
+          failed += WaitScenario(running) ? 0 : 1;
+        }
+        std::ostringstream name;
+        name << output << "." << i + 1;
+        std::ostringstream summary;
+        summary << stats << "." << i + 1;
+        pid_t pid = ForkScenario(simulationTopology, sweep[i], pathsToTest, name.str(),
+                                 echoStats, summary.str());
+        if (pid < 0) {
+          std::cerr << "Cannot fork scenario " << i + 1 << std::endl;
+          failed++;
+          continue;
+        }
+        running.push_back(pid);
+      }
+      while (!running.empty()) {
+        failed += WaitScenario(running) ? 0 : 1;
+      }
+      if (failed > 0) {
+        std::cerr << failed << " scenarios failed" << std::endl;
+      }
+      Simulator::Destroy ();
+      return failed > 0 ? 1 : 0;
+    }
+    GlobalRouteManager::SaveRoutingState ();
+    for (std::vector<Scenario>::iterator it = sweep.begin(); it != sweep.end(); it++) {
+      SetScenarioSeed(it->seed);
+      if (echoStats) {
+        echoStats->SetAttribute("Experiment", StringValue(it->experiment));
+      }
+      std::cout << "delay = " << it->delay << std::endl;
+      simulationTopology.BeginScenario(it->delay, it->links, pathsToTest);
+      Simulator::Run ();
+      simulationTopology.EndScenario();
+    }
+    if (echoStats) {
+      std::ofstream summary(stats.c_str());
+      echoStats->Write(summary);
+    }
+    Simulator::Destroy ();
+    return 0;
+  }
   //LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
   //LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
   //Simulator::ScheduleNow(&Topology::FailLink, &simulationTopology, 5, 6);
   //Simulator::ScheduleNow(&Topology::FailLink, &simulationTopology, 6, 7);
-  for (std::vector<std::pair<uint32_t, uint32_t> >::iterator it = linksToFail.begin();
-       it != linksToFail.end();
-       it++) {
-    Simulator::Schedule(Seconds(0.0), &Topology::FailLinkPair, &simulationTopology, *it);
-  }
-  simulationTopology.AddPathsToTest(pathsToTest);
+  // Reseed as a scenario does, so both draw the same from the same seed
+  SetScenarioSeed(SeedManager::GetSeed());
+  simulationTopology.BeginScenario(delay, linksToFail, pathsToTest);
   //Simulator::Schedule(Seconds(1.0), &Topology::PingMachines, &simulationTopology, 1, 6);
   //simulationTopology.PingMachines(1, 6);
   Simulator::Run ();
+  if (recorder) {
+    recorder->Close();
+  }
+  if (echoStats) {
+    std::ofstream summary(stats.c_str());
+    echoStats->Write(summary);
+  }
   Simulator::Destroy ();
 
   return 0;
@@ -431,6 +431,7 @@ main (int argc, char *argv[])
   uint32_t packets = 1;
   double delay = 0.0;
   double linkLatency = 1.0;
+  bool nextHopBytes = false;
   std::vector<std::pair<uint32_t, uint32_t> > linksToFail;
   std::vector<std::pair<uint32_t, uint32_t> > pathsToTest;
   CommandLine cmd;
@@ -442,6 +443,7 @@ main (int argc, char *argv[])
   cmd.AddValue("packets", "Packets to send per trial", packets);
   cmd.AddValue("delay", "Delay for repairs", delay);
   cmd.AddValue("latency", "Propagation delay (ms)", linkLatency);
+  cmd.AddValue("nexthops", "Print bytes forwarded per next hop, see also --ns3::Ipv4GlobalRouting::FlowEcmpRouting", nextHopBytes);
   cmd.Parse(argc, argv);
   if (!links.empty()) {
     ParseLinks(links, linksToFail);
@@ -470,6 +472,17 @@ main (int argc, char *argv[])
   //Simulator::Schedule(Seconds(1.0), &Topology::PingMachines, &simulationTopology, 1, 6);
   //simulationTopology.PingMachines(1, 6);
   Simulator::Run ();
+  if (nextHopBytes) {
+    for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); it++) {
+      Ptr<Ipv4GlobalRouting> gr = (*it)->GetObject<GlobalRouter>()->GetRoutingProtocol();
+      uint32_t interfaces = (*it)->GetObject<Ipv4>()->GetNInterfaces();
+      for (uint32_t i = 1; i < interfaces; i++) {
+        if (gr->GetNextHopBytes(i) > 0) {
+          std::cout << (*it)->GetId() << "," << i << "," << gr->GetNextHopBytes(i) << ",B" << std::endl;
+        }
+      }
+    }
+  }
   Simulator::Destroy ();
 
   return 0;
@@ -0,0 +1,55 @@
+# Reads the binary traces of TraceRecorder (traffic-sim-latency --trace=...).
+# As a script it prints them in the text format traffic-sim-latency prints
+# without --trace; read_trace() yields the records as dicts for other scripts.
+# Numbers in the trace are little-endian on every host.
+import struct
+import sys
+
+TRACE_MAGIC = 0x54434444
+FORMATS = {1: 'B', 2: 'H', 4: 'I', 8: 'q'}
+CLIENT_TX, CLIENT_RX, SERVER_TX, SERVER_RX, DROP, MAC_TX_DROP, REVERSAL = range(1, 8)
+
+def read_trace(filename):
+  f = open(filename, 'rb')
+  magic, version, ncolumns = struct.unpack('<IHH', f.read(8))
+  if magic != TRACE_MAGIC:
+    raise ValueError("%s is not a trace"%(filename))
+  columns = []
+  for i in xrange(ncolumns):
+    width, length = struct.unpack('<BB', f.read(2))
+    columns.append((f.read(length), width))
+  while True:
+    head = f.read(4)
+    if len(head) < 4:
+      break
+    count, = struct.unpack('<I', head)
+    data = []
+    for name, width in columns:
+      data.append(struct.unpack('<%d%s'%(count, FORMATS[width]), f.read(count * width)))
+    for row in xrange(count):
+      yield dict((columns[c][0], data[c][row]) for c in xrange(ncolumns))
+
+def format_time(ns):
+  # Time prints as signed nanoseconds with a unit suffix
+  return "%+d.0ns"%(ns)
+
+if __name__ == "__main__":
+  if len(sys.argv) < 2:
+    print "%s trace"%(sys.argv[0])
+    sys.exit(1)
+  for r in read_trace(sys.argv[1]):
+    t = r['type']
+    if t == CLIENT_TX:
+      print "TX_c,%s,%d,%d,%d"%(format_time(r['time']), r['src'], r['dst'], r['seq'])
+    elif t == CLIENT_RX:
+      print "RX_s,%s,%d,%d,%d"%(format_time(r['time']), r['src'], r['dst'], r['seq'])
+    elif t == SERVER_TX:
+      print "TX_s,%s,%d,%d,%d"%(format_time(r['time']), r['dst'], r['src'], r['seq'])
+    elif t == SERVER_RX:
+      print "RX_c,%s,%d,%d,%d"%(format_time(r['time']), r['src'], r['dst'], r['seq'])
+    elif t == DROP:
+      print "D,%s,%d,%d,D(%d)"%(format_time(r['time']), r['src'], r['dst'], r['value'] & 0xff)
+    elif t == MAC_TX_DROP:
+      print "P,%s"%(format_time(r['time']))
+    elif t == REVERSAL:
+      print "R,%d"%(r['node'])
@@ -0,0 +1,302 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <sstream>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "udp-echo-client.h"
+#include "echo-stats.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EchoStats");
+NS_OBJECT_ENSURE_REGISTERED (EchoStats);
+
+bool
+EchoStats::Key::operator< (const Key &other) const
+{
+  if (experiment != other.experiment)
+    {
+      return experiment < other.experiment;
+    }
+  if (delay != other.delay)
+    {
+      return delay < other.delay;
+    }
+  if (src != other.src)
+    {
+      return src < other.src;
+    }
+  return dst < other.dst;
+}
+
+EchoStats::PathStats::PathStats ()
+  : sent (0),
+    received (0),
+    reordered (0),
+    maxDisplacement (0)
+{
+}
+
+void
+EchoStats::PathStats::Merge (const PathStats &other)
+{
+  sent += other.sent;
+  received += other.received;
+  reordered += other.reordered;
+  maxDisplacement = std::max (maxDisplacement, other.maxDisplacement);
+  latency.Merge (other.latency);
+  hops.Merge (other.hops);
+  stretch.Merge (other.stretch);
+}
+
+TypeId
+EchoStats::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::EchoStats")
+    .SetParent<Object> ()
+    .AddConstructor<EchoStats> ()
+    .AddAttribute ("Experiment",
+                   "Label of the paths connected or restarted next, without spaces.",
+                   StringValue ("default"),
+                   MakeStringAccessor (&EchoStats::m_experiment),
+                   MakeStringChecker ())
+    .AddAttribute ("Delay",
+                   "Repair delay of the paths connected or restarted next.",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&EchoStats::m_delay),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("InitialTtl",
+                   "TTL echo replies are sent with, to count their hops.",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&EchoStats::m_initialTtl),
+                   MakeUintegerChecker<uint32_t> (1, 255))
+  ;
+  return tid;
+}
+
+EchoStats::EchoStats ()
+  : m_experiment ("default"),
+    m_delay (0),
+    m_initialTtl (64)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+EchoStats::~EchoStats ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+EchoStats::DoDispose (void)
+{
+  m_tracers.clear ();
+  Object::DoDispose ();
+}
+
+void
+EchoStats::ConnectUdpEchoClient (Ptr<UdpEchoClient> client, uint32_t src, uint32_t dst, uint32_t distance)
+{
+  NS_ASSERT_MSG (m_experiment.find_first_of (" \t\n") == std::string::npos,
+                 "Experiment label \"" << m_experiment << "\" has spaces");
+  Key key;
+  key.experiment = m_experiment;
+  key.delay = m_delay;
+  key.src = src;
+  key.dst = dst;
+  // std::map nodes stay put, so the tracer may keep a pointer
+  Ptr<PathTracer> tracer = Create<PathTracer> (key, &m_paths[key], m_initialTtl, distance);
+  m_tracers.push_back (tracer);
+  client->AddTransmitPacketEvent (MakeCallback (&PathTracer::Tx, tracer));
+  client->AddReceivePacketEvent (MakeCallback (&PathTracer::Rx, tracer));
+}
+
+void
+EchoStats::Restart (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_experiment.find_first_of (" \t\n") == std::string::npos,
+                 "Experiment label \"" << m_experiment << "\" has spaces");
+  for (std::vector<Ptr<PathTracer> >::iterator it = m_tracers.begin (); it != m_tracers.end (); it++)
+    {
+      Key key = (*it)->GetKey ();
+      key.experiment = m_experiment;
+      key.delay = m_delay;
+      (*it)->Restart (key, &m_paths[key]);
+    }
+}
+
+const EchoStats::PathMap &
+EchoStats::GetPaths (void) const
+{
+  return m_paths;
+}
+
+void
+EchoStats::Write (std::ostream &os) const
+{
+  for (PathMap::const_iterator it = m_paths.begin (); it != m_paths.end (); it++)
+    {
+      const PathStats &path = it->second;
+      os << "path " << it->first.experiment << " " << it->first.delay << " " << it->first.src << " "
+         << it->first.dst << " " << path.sent << " " << path.received << " " << path.reordered << " "
+         << path.maxDisplacement << " ";
+      path.latency.Serialize (os);
+      os << " ";
+      path.hops.Serialize (os);
+      os << " ";
+      path.stretch.Serialize (os);
+      os << std::endl;
+    }
+}
+
+bool
+EchoStats::Load (std::istream &is)
+{
+  PathMap loaded;
+  std::string line;
+  while (std::getline (is, line))
+    {
+      if (line.empty ())
+        {
+          continue;
+        }
+      std::istringstream fields (line);
+      std::string tag;
+      Key key;
+      PathStats path;
+      if (!(fields >> tag >> key.experiment >> key.delay >> key.src >> key.dst >> path.sent >> path.received
+                   >> path.reordered >> path.maxDisplacement)
+          || tag != "path"
+          || !path.latency.Deserialize (fields)
+          || !path.hops.Deserialize (fields)
+          || !path.stretch.Deserialize (fields))
+        {
+          NS_LOG_WARN ("Malformed summary line: " << line);
+          return false;
+        }
+      loaded[key].Merge (path);
+    }
+  for (PathMap::const_iterator it = loaded.begin (); it != loaded.end (); it++)
+    {
+      m_paths[it->first].Merge (it->second);
+    }
+  return true;
+}
+
+void
+EchoStats::PrintTable (std::ostream &os) const
+{
+  os << "# experiment,delay,paths,sent,received,latency_mean,latency_std,latency_max,latency_p50,"
+     << "latency_p99,reordered,reordered_paths,stretch_mean,stretch_max" << std::endl;
+  PathMap::const_iterator it = m_paths.begin ();
+  while (it != m_paths.end ())
+    {
+      PathStats total;
+      uint32_t paths = 0;
+      uint32_t reorderedPaths = 0;
+      PathMap::const_iterator first = it;
+      for (; it != m_paths.end () && it->first.experiment == first->first.experiment
+           && it->first.delay == first->first.delay; it++)
+        {
+          total.Merge (it->second);
+          paths++;
+          reorderedPaths += it->second.reordered > 0;
+        }
+      os << first->first.experiment << "," << first->first.delay << "," << paths << "," << total.sent << ","
+         << total.received << "," << total.latency.getMean () << "," << total.latency.getStddev () << ","
+         << total.latency.getMax () << "," << total.latency.GetQuantile (0.5) << ","
+         << total.latency.GetQuantile (0.99) << "," << (double)total.reordered / total.received << ","
+         << (double)reorderedPaths / paths << "," << total.stretch.getMean () << ","
+         << total.stretch.getMax () << std::endl;
+    }
+}
+
+EchoStats::PathTracer::PathTracer (const Key &key, PathStats *stats, uint32_t initialTtl, uint32_t distance)
+  : m_key (key),
+    m_stats (stats),
+    m_initialTtl (initialTtl),
+    m_distance (distance),
+    m_arrivals (0),
+    m_highestSeq (0)
+{
+}
+
+const EchoStats::Key &
+EchoStats::PathTracer::GetKey (void) const
+{
+  return m_key;
+}
+
+void
+EchoStats::PathTracer::Restart (const Key &key, PathStats *stats)
+{
+  m_key = key;
+  m_stats = stats;
+  m_pending.clear ();
+  m_arrivals = 0;
+  m_highestSeq = 0;
+}
+
+void
+EchoStats::PathTracer::Tx (Ptr<const Packet> packet, uint32_t node, Ipv4Address to)
+{
+  uint32_t seq = 0;
+  packet->CopyData ((uint8_t *)&seq, sizeof (seq));
+  m_pending[seq] = Simulator::Now ();
+  m_stats->sent++;
+}
+
+void
+EchoStats::PathTracer::Rx (Ptr<const Packet> packet, Ipv4Header &header)
+{
+  uint32_t seq = 0;
+  packet->CopyData ((uint8_t *)&seq, sizeof (seq));
+  std::map<uint32_t, Time>::iterator sent = m_pending.find (seq);
+  if (sent == m_pending.end ())
+    {
+      NS_LOG_LOGIC ("Reply " << seq << " was not sent or is a duplicate");
+      return;
+    }
+  m_stats->latency.Update ((Simulator::Now () - sent->second).GetSeconds ());
+  m_pending.erase (sent);
+
+  // Every router on the way decrements the TTL, the destination does not
+  uint32_t hops = m_initialTtl >= header.GetTtl () ? m_initialTtl - header.GetTtl () + 1 : 0;
+  m_stats->hops.Update (hops);
+  if (m_distance > 0)
+    {
+      m_stats->stretch.Update ((double)hops / m_distance);
+    }
+
+  if (m_arrivals > 0 && seq < m_highestSeq)
+    {
+      m_stats->reordered++;
+    }
+  m_highestSeq = std::max (m_highestSeq, seq);
+  uint32_t displacement = seq > m_arrivals ? seq - m_arrivals : m_arrivals - seq;
+  m_stats->maxDisplacement = std::max (m_stats->maxDisplacement, displacement);
+  m_arrivals++;
+  m_stats->received++;
+}
+
+} // namespace ns3
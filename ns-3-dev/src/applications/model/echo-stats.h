@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ECHO_STATS_H
+#define ECHO_STATS_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/log-histogram.h"
+
+namespace ns3 {
+
+class UdpEchoClient;
+
+/**
+ * \ingroup applications
+ * \brief Online latency, stretch and reordering statistics of echo paths
+ *
+ * Hooked to the Tx and Rx traces of UdpEchoClient applications, it keeps
+ * per path the round trip latencies, the hop counts and stretch of the
+ * replies and how far replies arrived out of sequence, without storing
+ * packets.  Paths are keyed by experiment, delay and endpoints.
+ *
+ * Write () emits one line per path; Load () merges such lines, so the
+ * summaries of separate runs (such as seeds) combine into one.
+ */
+class EchoStats : public Object
+{
+public:
+  struct Key
+  {
+    std::string experiment;
+    double delay;
+    uint32_t src;
+    uint32_t dst;
+    bool operator< (const Key &other) const;
+  };
+
+  struct PathStats
+  {
+    PathStats ();
+    void Merge (const PathStats &other);
+
+    uint64_t sent;
+    uint64_t received;
+    /// Replies with a lower sequence number than one received before
+    uint64_t reordered;
+    /// Largest distance between a reply's arrival index and its sequence number
+    uint32_t maxDisplacement;
+    /// Round trip seconds
+    LogHistogram latency;
+    /// Links the replies crossed
+    LogHistogram hops;
+    /// Hops over the shortest distance, when one was given
+    LogHistogram stretch;
+  };
+
+  typedef std::map<Key, PathStats> PathMap;
+
+  static TypeId GetTypeId (void);
+
+  EchoStats ();
+  virtual ~EchoStats ();
+
+  /**
+   * Count the echoes of client as the path from src to dst
+   * \param distance links on the shortest path between them, 0 if unknown
+   */
+  void ConnectUdpEchoClient (Ptr<UdpEchoClient> client, uint32_t src, uint32_t dst, uint32_t distance = 0);
+  /**
+   * Count the echoes of the clients connected so far under the current
+   * Experiment and Delay from now on, as if they had just been connected.
+   * Echoes still pending are forgotten.
+   */
+  void Restart (void);
+
+  const PathMap &GetPaths (void) const;
+
+  /// Write the summary, one line per path
+  void Write (std::ostream &os) const;
+  /// Merge a summary written by Write; false if it is malformed
+  bool Load (std::istream &is);
+  /// Print CSV with the paths of each experiment and delay merged
+  void PrintTable (std::ostream &os) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// Follows the echoes of one client
+  class PathTracer : public SimpleRefCount<PathTracer>
+  {
+  public:
+    PathTracer (const Key &key, PathStats *stats, uint32_t initialTtl, uint32_t distance);
+    const Key &GetKey (void) const;
+    /// Count into stats under key, starting a new run of sequence numbers
+    void Restart (const Key &key, PathStats *stats);
+    void Tx (Ptr<const Packet> packet, uint32_t node, Ipv4Address to);
+    void Rx (Ptr<const Packet> packet, Ipv4Header &header);
+  private:
+    Key m_key;
+    PathStats *m_stats;
+    uint32_t m_initialTtl;
+    uint32_t m_distance;
+    /// Send times of the echoes not answered yet, by sequence number
+    std::map<uint32_t, Time> m_pending;
+    uint32_t m_arrivals;
+    uint32_t m_highestSeq;
+  };
+
+  std::string m_experiment;
+  double m_delay;
+  uint32_t m_initialTtl;
+  PathMap m_paths;
+  std::vector<Ptr<PathTracer> > m_tracers;
+};
+
+} // namespace ns3
+
+#endif /* ECHO_STATS_H */
@@ -0,0 +1,316 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "schedule-source.h"
+
+NS_LOG_COMPONENT_DEFINE ("ScheduleSource");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (ScheduleSource);
+
+TypeId
+ScheduleSource::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ScheduleSource")
+    .SetParent<Object> ()
+    .AddConstructor<ScheduleSource> ()
+    .AddAttribute ("Lookahead",
+                   "How far ahead of the simulation time events are handed to the simulator.",
+                   TimeValue (Seconds (1.0)),
+                   MakeTimeAccessor (&ScheduleSource::m_lookahead),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxPending",
+                   "The most events handed to the simulator at once.",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&ScheduleSource::m_maxPending),
+                   MakeUintegerChecker<uint32_t> (2))
+  ;
+  return tid;
+}
+
+ScheduleSource::ScheduleSource ()
+  : m_binary (false),
+    m_hasNext (false),
+    m_eventsRead (0),
+    m_peakPending (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+ScheduleSource::~ScheduleSource ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+ScheduleSource::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_refillEvent);
+  m_window.clear ();
+  m_callback = Callback<void, const ScheduleEvent &> ();
+  if (m_file.is_open ())
+    {
+      m_file.close ();
+    }
+  Object::DoDispose ();
+}
+
+bool
+ScheduleSource::Open (std::string filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  m_file.open (filename.c_str (), std::ios::in | std::ios::binary);
+  if (!m_file.is_open ())
+    {
+      return false;
+    }
+  uint32_t magic = 0;
+  m_file.read (reinterpret_cast<char *> (&magic), sizeof (magic));
+  m_binary = m_file.gcount () == sizeof (magic) && magic == SCHEDULE_MAGIC;
+  if (!m_binary)
+    {
+      m_file.clear ();
+      m_file.seekg (0);
+    }
+  m_hasNext = ReadNext ();
+  return true;
+}
+
+void
+ScheduleSource::SetEventCallback (Callback<void, const ScheduleEvent &> callback)
+{
+  m_callback = callback;
+}
+
+void
+ScheduleSource::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+  Refill ();
+}
+
+uint64_t
+ScheduleSource::GetEventsRead (void) const
+{
+  return m_eventsRead;
+}
+
+uint32_t
+ScheduleSource::GetPeakPending (void) const
+{
+  return m_peakPending;
+}
+
+bool
+ScheduleSource::ParseLine (const std::string &line, ScheduleEvent &event, double &seconds)
+{
+  const char *p = line.c_str ();
+  char *end;
+  seconds = strtod (p, &end);
+  if (end == p)
+    {
+      return false;
+    }
+  p = end;
+  while (*p == ' ')
+    {
+      p++;
+    }
+  if (*p == 0)
+    {
+      return false;
+    }
+  event.time = Seconds (seconds);
+  event.type = *p++;
+  event.args.clear ();
+  while (*p != 0)
+    {
+      if (*p == ' ' || *p == '=' || *p == '\r')
+        {
+          p++;
+          continue;
+        }
+      uint64_t value = strtoull (p, &end, 10);
+      if (*end == '.' || *end == 'e' || *end == 'E')
+        {
+          // Sizes written as floating point numbers
+          value = (uint64_t)strtod (p, &end);
+        }
+      NS_ABORT_MSG_IF (end == p, "Bad schedule argument in \"" << line << "\"");
+      event.args.push_back (value);
+      p = end;
+    }
+  return true;
+}
+
+static bool
+ReadVarint (std::istream &in, uint64_t &value)
+{
+  value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+      int byte = in.get ();
+      if (byte == EOF)
+        {
+          return false;
+        }
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+static void
+WriteVarint (std::ostream &out, uint64_t value)
+{
+  while (value >= 0x80)
+    {
+      out.put ((char)((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+  out.put ((char)value);
+}
+
+bool
+ScheduleSource::ReadBinaryEvent (ScheduleEvent &event)
+{
+  double seconds;
+  m_file.read (reinterpret_cast<char *> (&seconds), sizeof (seconds));
+  if (m_file.gcount () != sizeof (seconds))
+    {
+      return false;
+    }
+  int type = m_file.get ();
+  uint64_t args;
+  NS_ABORT_MSG_UNLESS (type != EOF && ReadVarint (m_file, args), "Truncated binary schedule");
+  event.time = Seconds (seconds);
+  event.type = (char)type;
+  event.args.resize (args);
+  for (uint64_t i = 0; i < args; i++)
+    {
+      NS_ABORT_MSG_UNLESS (ReadVarint (m_file, event.args[i]), "Truncated binary schedule");
+    }
+  return true;
+}
+
+bool
+ScheduleSource::ReadNext (void)
+{
+  bool read = false;
+  if (m_binary)
+    {
+      read = ReadBinaryEvent (m_next);
+    }
+  else
+    {
+      std::string line;
+      double seconds;
+      while (!read && std::getline (m_file, line))
+        {
+          read = ParseLine (line, m_next, seconds);
+        }
+    }
+  if (read)
+    {
+      m_eventsRead++;
+    }
+  return read;
+}
+
+void
+ScheduleSource::Refill (void)
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  Time horizon = now + m_lookahead;
+  while (m_hasNext && m_window.size () < m_maxPending && m_next.time <= horizon)
+    {
+      NS_ABORT_MSG_IF (m_next.time < now, "Schedule not sorted by time at " << m_next.time);
+      m_window.push_back (m_next);
+      Simulator::Schedule (m_next.time - now, &ScheduleSource::Fire, this);
+      m_hasNext = ReadNext ();
+    }
+  m_peakPending = std::max (m_peakPending, (uint32_t)m_window.size ());
+  if (!m_hasNext)
+    {
+      NS_LOG_LOGIC ("Whole schedule read, " << m_eventsRead << " events");
+      return;
+    }
+  // Come back when the next event enters the window or, if the window is
+  // full, once half of it has fired
+  Time when = m_next.time - m_lookahead;
+  if (m_window.size () >= m_maxPending)
+    {
+      when = m_window[m_window.size () / 2].time;
+    }
+  m_refillEvent = Simulator::Schedule (Max (when, now) - now, &ScheduleSource::Refill, this);
+}
+
+void
+ScheduleSource::Fire (void)
+{
+  NS_ASSERT (!m_window.empty () && m_window.front ().time == Simulator::Now ());
+  ScheduleEvent event = m_window.front ();
+  m_window.pop_front ();
+  if (!m_callback.IsNull ())
+    {
+      m_callback (event);
+    }
+}
+
+bool
+ScheduleSource::WriteBinary (std::string text, std::string binary)
+{
+  std::ifstream in (text.c_str ());
+  std::ofstream out (binary.c_str (), std::ios::out | std::ios::binary);
+  if (!in.is_open () || !out.is_open ())
+    {
+      return false;
+    }
+  uint32_t magic = SCHEDULE_MAGIC;
+  out.write (reinterpret_cast<const char *> (&magic), sizeof (magic));
+  std::string line;
+  ScheduleEvent event;
+  double seconds;
+  while (std::getline (in, line))
+    {
+      // Keep the time as written so that both formats give the same events
+      if (!ParseLine (line, event, seconds))
+        {
+          continue;
+        }
+      out.write (reinterpret_cast<const char *> (&seconds), sizeof (seconds));
+      out.put (event.type);
+      WriteVarint (out, event.args.size ());
+      for (uint32_t i = 0; i < event.args.size (); i++)
+        {
+          WriteVarint (out, event.args[i]);
+        }
+    }
+  return out.good ();
+}
+
+} // namespace ns3
@@ -0,0 +1,120 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHEDULE_SOURCE_H
+#define SCHEDULE_SOURCE_H
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/callback.h"
+#include "ns3/event-id.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup applications
+ * \brief One event of a workload schedule
+ *
+ * A line "0.05 q 3 6 2" of a text schedule has time 0.05 s, type 'q' and
+ * arguments 3, 6 and 2.  An argument "3=6" (such as a failed link) counts
+ * as the two arguments 3 and 6.
+ */
+struct ScheduleEvent
+{
+  Time time;
+  char type;
+  std::vector<uint64_t> args;
+};
+
+/**
+ * \ingroup applications
+ * \brief Feeds a workload schedule file to the simulator as it runs
+ *
+ * The schedules written by create-query-schedule.py and friends can hold
+ * millions of events.  Rather than scheduling them all at the start, the
+ * source reads the file as the simulation advances and only keeps the
+ * events of the next Lookahead (at most MaxPending of them) in the
+ * simulator, calling the event callback at the time of each.  Events must
+ * be sorted by time.
+ *
+ * Schedules are either text, one event per line, or the binary format of
+ * WriteBinary (): a uint32 SCHEDULE_MAGIC, then per event a double time in
+ * seconds, a uint8 type, the number of arguments and the arguments, both as
+ * LEB128 varints.  Numbers are in host byte order.
+ */
+class ScheduleSource : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  ScheduleSource ();
+  virtual ~ScheduleSource ();
+
+  /**
+   * Open a text or binary schedule
+   * \returns false if the file cannot be read
+   */
+  bool Open (std::string filename);
+  void SetEventCallback (Callback<void, const ScheduleEvent &> callback);
+  /// Start feeding events, the schedule's times being absolute
+  void Start (void);
+
+  /// Events read from the file so far
+  uint64_t GetEventsRead (void) const;
+  /// Most events that were in the simulator at once
+  uint32_t GetPeakPending (void) const;
+
+  /**
+   * Convert a text schedule to the binary format
+   * \returns false if either file cannot be opened
+   */
+  static bool WriteBinary (std::string text, std::string binary);
+
+  static const uint32_t SCHEDULE_MAGIC = 0x53434844;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// Read the next event of the file into m_next
+  bool ReadNext (void);
+  static bool ParseLine (const std::string &line, ScheduleEvent &event, double &seconds);
+  bool ReadBinaryEvent (ScheduleEvent &event);
+  /// Move the events entering the lookahead window into the simulator
+  void Refill (void);
+  void Fire (void);
+
+  Time m_lookahead;
+  uint32_t m_maxPending;
+  std::ifstream m_file;
+  bool m_binary;
+  ScheduleEvent m_next;
+  bool m_hasNext;
+  /// Events in the simulator, in time order
+  std::deque<ScheduleEvent> m_window;
+  EventId m_refillEvent;
+  Callback<void, const ScheduleEvent &> m_callback;
+  uint64_t m_eventsRead;
+  uint32_t m_peakPending;
+};
+
+} // namespace ns3
+
+#endif /* SCHEDULE_SOURCE_H */
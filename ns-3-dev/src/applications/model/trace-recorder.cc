@@ -0,0 +1,573 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstring>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/net-device.h"
+#include "ns3/ipv4.h"
+#include "ns3/global-router-interface.h"
+#include "ns3/ipv4-global-routing.h"
+#include "udp-echo-client.h"
+#include "udp-echo-server.h"
+#include "trace-recorder.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TraceRecorder");
+NS_OBJECT_ENSURE_REGISTERED (TraceRecorder);
+
+namespace {
+
+/// Columns in the order TraceRecorder writes them
+struct Column
+{
+  const char *name;
+  uint8_t width;
+};
+
+const Column g_columns[] = {
+  { "time", 8 },
+  { "type", 1 },
+  { "node", 4 },
+  { "src", 4 },
+  { "dst", 4 },
+  { "seq", 4 },
+  { "value", 4 },
+};
+
+const uint32_t N_COLUMNS = sizeof (g_columns) / sizeof (g_columns[0]);
+
+/// Store the low width bytes of value, least significant first
+void
+PutLittleEndian (uint8_t *buffer, uint64_t value, uint32_t width)
+{
+  for (uint32_t i = 0; i < width; i++)
+    {
+      buffer[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+uint64_t
+GetLittleEndian (const uint8_t *buffer, uint32_t width)
+{
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < width; i++)
+    {
+      value |= (uint64_t)buffer[i] << (8 * i);
+    }
+  return value;
+}
+
+void
+WriteLittleEndian (std::ostream &os, uint64_t value, uint32_t width)
+{
+  uint8_t buffer[8];
+  PutLittleEndian (buffer, value, width);
+  os.write ((const char *)buffer, width);
+}
+
+uint64_t
+ReadLittleEndian (std::istream &is, uint32_t width)
+{
+  uint8_t buffer[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  is.read ((char *)buffer, width);
+  return GetLittleEndian (buffer, width);
+}
+
+uint64_t
+GetField (const TraceRecord &record, uint32_t field)
+{
+  switch (field)
+    {
+    case 0: return record.time;
+    case 1: return record.type;
+    case 2: return record.node;
+    case 3: return record.src;
+    case 4: return record.dst;
+    case 5: return record.seq;
+    default: return record.value;
+    }
+}
+
+void
+SetField (TraceRecord &record, uint32_t field, uint64_t value)
+{
+  switch (field)
+    {
+    case 0: record.time = value; break;
+    case 1: record.type = value; break;
+    case 2: record.node = value; break;
+    case 3: record.src = value; break;
+    case 4: record.dst = value; break;
+    case 5: record.seq = value; break;
+    default: record.value = value; break;
+    }
+}
+
+} // anonymous namespace
+
+TypeId
+TraceRecorder::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TraceRecorder")
+    .SetParent<Object> ()
+    .AddConstructor<TraceRecorder> ()
+    .AddAttribute ("BlockRecords",
+                   "Records buffered in memory before they are written out as one block.",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&TraceRecorder::m_blockRecords),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+TraceRecorder::TraceRecorder ()
+  : m_blockRecords (65536),
+    m_records (0),
+    m_epoch (Seconds (0))
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TraceRecorder::~TraceRecorder ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TraceRecorder::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+  m_tracers.clear ();
+  m_addressNodes.clear ();
+  Object::DoDispose ();
+}
+
+bool
+TraceRecorder::Open (std::string filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  Close ();
+  m_file.open (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!m_file.is_open ())
+    {
+      NS_LOG_WARN ("Cannot create trace " << filename);
+      return false;
+    }
+  WriteLittleEndian (m_file, TRACE_MAGIC, 4);
+  WriteLittleEndian (m_file, TRACE_VERSION, 2);
+  WriteLittleEndian (m_file, N_COLUMNS, 2);
+  for (uint32_t i = 0; i < N_COLUMNS; i++)
+    {
+      uint8_t length = std::strlen (g_columns[i].name);
+      m_file.write ((const char *)&g_columns[i].width, 1);
+      m_file.write ((const char *)&length, 1);
+      m_file.write (g_columns[i].name, length);
+    }
+  m_block.reserve (m_blockRecords);
+  return true;
+}
+
+void
+TraceRecorder::Close (void)
+{
+  if (!m_file.is_open ())
+    {
+      return;
+    }
+  NS_LOG_FUNCTION (this);
+  WriteBlock ();
+  m_file.close ();
+}
+
+void
+TraceRecorder::WriteBlock (void)
+{
+  if (m_block.empty ())
+    {
+      return;
+    }
+  // Columns are written one after the other, each through a scratch buffer
+  // so a block costs N_COLUMNS writes whatever its size.
+  uint32_t count = m_block.size ();
+  WriteLittleEndian (m_file, count, 4);
+  std::vector<uint8_t> column;
+  for (uint32_t i = 0; i < N_COLUMNS; i++)
+    {
+      uint32_t width = g_columns[i].width;
+      column.resize (count * width);
+      for (uint32_t j = 0; j < count; j++)
+        {
+          PutLittleEndian (&column[j * width], GetField (m_block[j], i), width);
+        }
+      m_file.write ((const char *)&column[0], column.size ());
+    }
+  m_block.clear ();
+}
+
+void
+TraceRecorder::SetNodeLabels (const std::vector<uint32_t> &labels)
+{
+  m_labels = labels;
+}
+
+uint32_t
+TraceRecorder::GetLabel (uint32_t nodeId) const
+{
+  if (nodeId == TraceRecord::NO_NODE || m_labels.empty ())
+    {
+      return nodeId;
+    }
+  return nodeId < m_labels.size () ? m_labels[nodeId] : TraceRecord::NO_NODE;
+}
+
+void
+TraceRecorder::SetEpoch (Time epoch)
+{
+  m_epoch = epoch;
+}
+
+int64_t
+TraceRecorder::GetTime (void) const
+{
+  return (Simulator::Now () - m_epoch).GetNanoSeconds ();
+}
+
+void
+TraceRecorder::Record (const TraceRecord &record)
+{
+  if (!m_file.is_open ())
+    {
+      return;
+    }
+  m_block.push_back (record);
+  m_records++;
+  if (m_block.size () >= m_blockRecords)
+    {
+      WriteBlock ();
+    }
+}
+
+uint64_t
+TraceRecorder::GetRecords (void) const
+{
+  return m_records;
+}
+
+uint32_t
+TraceRecorder::GetAddressNode (Ipv4Address address)
+{
+  if (m_addressNodes.empty ())
+    {
+      // Addresses are assigned before traffic starts, so one pass suffices
+      for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); it++)
+        {
+          Ptr<Ipv4> ipv4 = (*it)->GetObject<Ipv4> ();
+          if (ipv4 == 0)
+            {
+              continue;
+            }
+          for (uint32_t i = 1; i < ipv4->GetNInterfaces (); i++)
+            {
+              for (uint32_t j = 0; j < ipv4->GetNAddresses (i); j++)
+                {
+                  m_addressNodes[ipv4->GetAddress (i, j).GetLocal ()] = (*it)->GetId ();
+                }
+            }
+        }
+    }
+  std::map<Ipv4Address, uint32_t>::const_iterator it = m_addressNodes.find (address);
+  if (it == m_addressNodes.end ())
+    {
+      return TraceRecord::NO_NODE;
+    }
+  return GetLabel (it->second);
+}
+
+Ptr<TraceRecorder::NodeTracer>
+TraceRecorder::GetTracer (uint32_t nodeId)
+{
+  if (nodeId >= m_tracers.size ())
+    {
+      m_tracers.resize (nodeId + 1);
+    }
+  if (m_tracers[nodeId] == 0)
+    {
+      m_tracers[nodeId] = Create<NodeTracer> (this, nodeId);
+    }
+  return m_tracers[nodeId];
+}
+
+void
+TraceRecorder::ConnectUdpEchoClient (Ptr<UdpEchoClient> client)
+{
+  Ptr<NodeTracer> tracer = GetTracer (client->GetNode ()->GetId ());
+  client->AddTransmitPacketEvent (MakeCallback (&NodeTracer::ClientTx, tracer));
+  client->AddReceivePacketEvent (MakeCallback (&NodeTracer::ClientRx, tracer));
+}
+
+void
+TraceRecorder::ConnectUdpEchoServer (Ptr<UdpEchoServer> server)
+{
+  Ptr<NodeTracer> tracer = GetTracer (server->GetNode ()->GetId ());
+  server->AddTransmitPacketEvent (MakeCallback (&NodeTracer::ServerTx, tracer));
+  server->AddReceivePacketEvent (MakeCallback (&NodeTracer::ServerRx, tracer));
+}
+
+void
+TraceRecorder::ConnectIpv4Drop (Ptr<Node> node)
+{
+  Ptr<Ipv4L3Protocol> l3 = node->GetObject<Ipv4L3Protocol> ();
+  NS_ASSERT_MSG (l3 != 0, "Node " << node->GetId () << " has no IPv4 stack");
+  l3->TraceConnectWithoutContext ("Drop", MakeCallback (&NodeTracer::Drop, GetTracer (node->GetId ())));
+}
+
+void
+TraceRecorder::ConnectMacTxDrop (Ptr<NetDevice> device)
+{
+  device->TraceConnectWithoutContext ("MacTxDrop",
+                                      MakeCallback (&NodeTracer::MacTxDrop, GetTracer (device->GetNode ()->GetId ())));
+}
+
+void
+TraceRecorder::ConnectReversals (Ptr<Node> node)
+{
+  Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
+  NS_ASSERT_MSG (router != 0, "Node " << node->GetId () << " has no global router");
+  router->GetRoutingProtocol ()->AddReversalCallback (MakeCallback (&NodeTracer::Reversal,
+                                                                    GetTracer (node->GetId ())));
+}
+
+TraceRecorder::NodeTracer::NodeTracer (TraceRecorder *recorder, uint32_t node)
+  : m_recorder (recorder),
+    m_node (node)
+{
+}
+
+void
+TraceRecorder::NodeTracer::RecordEcho (uint8_t type, Ptr<const Packet> packet, uint32_t src, uint32_t dst,
+                                       uint32_t value)
+{
+  TraceRecord record;
+  record.time = m_recorder->GetTime ();
+  record.type = type;
+  record.node = m_recorder->GetLabel (m_node);
+  record.src = src;
+  record.dst = dst;
+  record.seq = 0;
+  packet->CopyData ((uint8_t *)&record.seq, sizeof (record.seq));
+  record.value = value;
+  m_recorder->Record (record);
+}
+
+void
+TraceRecorder::NodeTracer::ClientTx (Ptr<const Packet> packet, uint32_t node, Ipv4Address to)
+{
+  RecordEcho (TraceRecord::ClientTx, packet, m_recorder->GetLabel (node), m_recorder->GetAddressNode (to), 0);
+}
+
+void
+TraceRecorder::NodeTracer::ClientRx (Ptr<const Packet> packet, Ipv4Header &header)
+{
+  RecordEcho (TraceRecord::ClientRx, packet, m_recorder->GetAddressNode (header.GetSource ()),
+              m_recorder->GetLabel (m_node), header.GetTtl ());
+}
+
+void
+TraceRecorder::NodeTracer::ServerTx (Ptr<const Packet> packet, Ipv4Header &header)
+{
+  RecordEcho (TraceRecord::ServerTx, packet, m_recorder->GetAddressNode (header.GetSource ()),
+              m_recorder->GetAddressNode (header.GetDestination ()), 0);
+}
+
+void
+TraceRecorder::NodeTracer::ServerRx (Ptr<const Packet> packet, Ipv4Header &header)
+{
+  RecordEcho (TraceRecord::ServerRx, packet, m_recorder->GetAddressNode (header.GetSource ()),
+              m_recorder->GetLabel (m_node), header.GetTtl ());
+}
+
+void
+TraceRecorder::NodeTracer::Drop (const Ipv4Header &header, Ptr<const Packet> packet,
+                                 Ipv4L3Protocol::DropReason reason, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+  TraceRecord record;
+  record.time = m_recorder->GetTime ();
+  record.type = TraceRecord::Drop;
+  record.node = m_recorder->GetLabel (m_node);
+  record.src = m_recorder->GetAddressNode (header.GetSource ());
+  record.dst = m_recorder->GetAddressNode (header.GetDestination ());
+  record.seq = 0;
+  record.value = ((uint32_t)reason << 8) | header.GetTtl ();
+  m_recorder->Record (record);
+}
+
+void
+TraceRecorder::NodeTracer::MacTxDrop (Ptr<const Packet> packet)
+{
+  TraceRecord record;
+  record.time = m_recorder->GetTime ();
+  record.type = TraceRecord::MacTxDrop;
+  record.node = m_recorder->GetLabel (m_node);
+  record.src = TraceRecord::NO_NODE;
+  record.dst = TraceRecord::NO_NODE;
+  record.seq = 0;
+  record.value = packet->GetSize ();
+  m_recorder->Record (record);
+}
+
+void
+TraceRecorder::NodeTracer::Reversal (uint32_t interface, Ipv4Address destination)
+{
+  TraceRecord record;
+  record.time = m_recorder->GetTime ();
+  record.type = TraceRecord::Reversal;
+  record.node = m_recorder->GetLabel (m_node);
+  record.src = record.node;
+  record.dst = m_recorder->GetAddressNode (destination);
+  record.seq = 0;
+  record.value = interface;
+  m_recorder->Record (record);
+}
+
+TraceReader::TraceReader ()
+  : m_blockSize (0),
+    m_row (0)
+{
+  for (uint32_t i = 0; i < N_COLUMNS; i++)
+    {
+      m_fields[i] = -1;
+    }
+}
+
+bool
+TraceReader::Open (std::string filename)
+{
+  m_file.open (filename.c_str (), std::ios::in | std::ios::binary);
+  uint32_t magic = ReadLittleEndian (m_file, 4);
+  uint16_t version = ReadLittleEndian (m_file, 2);
+  uint16_t columns = ReadLittleEndian (m_file, 2);
+  if (!m_file || magic != TraceRecorder::TRACE_MAGIC || version != TraceRecorder::TRACE_VERSION)
+    {
+      NS_LOG_WARN ("Not a trace: " << filename);
+      return false;
+    }
+  uint32_t offset = 0;
+  for (uint16_t i = 0; i < columns; i++)
+    {
+      uint8_t width = 0;
+      uint8_t length = 0;
+      m_file.read ((char *)&width, 1);
+      m_file.read ((char *)&length, 1);
+      std::string name (length, ' ');
+      if (length > 0)
+        {
+          m_file.read (&name[0], length);
+        }
+      if (!m_file || width == 0 || width > 8)
+        {
+          NS_LOG_WARN ("Bad schema in " << filename);
+          return false;
+        }
+      m_names.push_back (name);
+      m_widths.push_back (width);
+      for (uint32_t j = 0; j < N_COLUMNS; j++)
+        {
+          if (name == g_columns[j].name)
+            {
+              m_fields[j] = i;
+            }
+        }
+      m_offsets.push_back (offset);
+      offset += width;
+    }
+  return true;
+}
+
+uint32_t
+TraceReader::GetNColumns (void) const
+{
+  return m_names.size ();
+}
+
+std::string
+TraceReader::GetColumnName (uint32_t column) const
+{
+  NS_ASSERT (column < m_names.size ());
+  return m_names[column];
+}
+
+uint32_t
+TraceReader::GetColumnWidth (uint32_t column) const
+{
+  NS_ASSERT (column < m_widths.size ());
+  return m_widths[column];
+}
+
+bool
+TraceReader::ReadBlock (void)
+{
+  uint32_t count = ReadLittleEndian (m_file, 4);
+  if (!m_file || count == 0)
+    {
+      return false;
+    }
+  // m_offsets hold the bytes of one row; a column's data is count times its
+  // offset into the block.
+  uint32_t rowBytes = m_offsets.empty () ? 0 : m_offsets.back () + m_widths.back ();
+  m_block.resize ((size_t)count * rowBytes);
+  if (!m_block.empty ())
+    {
+      m_file.read ((char *)&m_block[0], m_block.size ());
+      if (!m_file)
+        {
+          return false;
+        }
+    }
+  m_blockSize = count;
+  m_row = 0;
+  return true;
+}
+
+uint64_t
+TraceReader::GetValue (uint32_t column, uint32_t row) const
+{
+  uint32_t width = m_widths[column];
+  return GetLittleEndian (&m_block[(size_t)m_offsets[column] * m_blockSize + (size_t)row * width], width);
+}
+
+bool
+TraceReader::Next (TraceRecord &record)
+{
+  if (m_row >= m_blockSize && !ReadBlock ())
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < N_COLUMNS; i++)
+    {
+      SetField (record, i, m_fields[i] < 0 ? 0 : GetValue (m_fields[i], m_row));
+    }
+  m_row++;
+  return true;
+}
+
+} // namespace ns3
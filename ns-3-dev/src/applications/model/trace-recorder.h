@@ -0,0 +1,200 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+class NetDevice;
+class Node;
+class UdpEchoClient;
+class UdpEchoServer;
+
+/**
+ * \ingroup applications
+ * \brief One event of a binary trace
+ *
+ * Nodes are node IDs, or the labels given to TraceRecorder::SetNodeLabels
+ * (such as the node numbers of a topology file); NO_NODE when unknown.
+ */
+struct TraceRecord
+{
+  enum Type {
+    ClientTx = 1,     ///< echo request sent: src client, dst server
+    ClientRx = 2,     ///< echo reply received: src server, dst client, value TTL
+    ServerTx = 3,     ///< echo reply sent: src server, dst client
+    ServerRx = 4,     ///< echo request received: src client, dst server, value TTL
+    Drop = 5,         ///< IPv4 drop: src and dst of the packet, value reason << 8 | TTL
+    MacTxDrop = 6,    ///< device queue drop: value bytes
+    Reversal = 7      ///< DDC link reversal: dst node of the destination, value interface
+  };
+
+  int64_t time;       ///< nanoseconds since the recorder's epoch
+  uint8_t type;
+  uint32_t node;      ///< node the event happened at
+  uint32_t src;
+  uint32_t dst;
+  uint32_t seq;       ///< first four payload bytes of echo packets
+  uint32_t value;
+
+  static const uint32_t NO_NODE = 0xffffffff;
+};
+
+/**
+ * \ingroup applications
+ * \brief Records typed packet events into a columnar binary file
+ *
+ * A replacement for printing a text line per packet event.  The file starts
+ * with a schema header: uint32 TRACE_MAGIC, uint16 version, uint16 number
+ * of columns, then per column its width in bytes (uint8), the length of its
+ * name (uint8) and the name.  Records follow in blocks of up to BlockRecords
+ * records: a uint32 count, then that many values of the first column, that
+ * many of the second, and so on.  Numbers are little-endian whatever the
+ * host byte order.
+ *
+ * Blocks are buffered in memory and written whole, when full and by
+ * Close ().  The Connect methods hook the recorder to the trace sources the
+ * DDC experiment programs print from.
+ */
+class TraceRecorder : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  TraceRecorder ();
+  virtual ~TraceRecorder ();
+
+  /**
+   * Start a trace file, replacing any existing one
+   * \returns false if it cannot be created
+   */
+  bool Open (std::string filename);
+  /// Write the buffered records and close the file
+  void Close (void);
+
+  /// Record nodes by label rather than node ID, indexed by node ID
+  void SetNodeLabels (const std::vector<uint32_t> &labels);
+  /// Record times since this simulation time rather than since zero
+  void SetEpoch (Time epoch);
+
+  void Record (const TraceRecord &record);
+  uint64_t GetRecords (void) const;
+
+  void ConnectUdpEchoClient (Ptr<UdpEchoClient> client);
+  void ConnectUdpEchoServer (Ptr<UdpEchoServer> server);
+  /// The Drop trace of the node's Ipv4L3Protocol
+  void ConnectIpv4Drop (Ptr<Node> node);
+  void ConnectMacTxDrop (Ptr<NetDevice> device);
+  /// Reversals of the node's Ipv4GlobalRouting
+  void ConnectReversals (Ptr<Node> node);
+
+  /// Node label of an interface address, NO_NODE if unknown
+  uint32_t GetAddressNode (Ipv4Address address);
+
+  static const uint32_t TRACE_MAGIC = 0x54434444;
+  static const uint16_t TRACE_VERSION = 1;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// Reports the events of one node
+  class NodeTracer : public SimpleRefCount<NodeTracer>
+  {
+  public:
+    NodeTracer (TraceRecorder *recorder, uint32_t node);
+    void ClientTx (Ptr<const Packet> packet, uint32_t node, Ipv4Address to);
+    void ClientRx (Ptr<const Packet> packet, Ipv4Header &header);
+    void ServerTx (Ptr<const Packet> packet, Ipv4Header &header);
+    void ServerRx (Ptr<const Packet> packet, Ipv4Header &header);
+    void Drop (const Ipv4Header &header, Ptr<const Packet> packet, Ipv4L3Protocol::DropReason reason,
+               Ptr<Ipv4> ipv4, uint32_t interface);
+    void MacTxDrop (Ptr<const Packet> packet);
+    void Reversal (uint32_t interface, Ipv4Address destination);
+  private:
+    void RecordEcho (uint8_t type, Ptr<const Packet> packet, uint32_t src, uint32_t dst, uint32_t value);
+    TraceRecorder *m_recorder;
+    uint32_t m_node;
+  };
+
+  Ptr<NodeTracer> GetTracer (uint32_t nodeId);
+  uint32_t GetLabel (uint32_t nodeId) const;
+  int64_t GetTime (void) const;
+  void WriteBlock (void);
+
+  uint32_t m_blockRecords;
+  std::ofstream m_file;
+  std::vector<TraceRecord> m_block;
+  uint64_t m_records;
+  Time m_epoch;
+  std::vector<uint32_t> m_labels;
+  std::map<Ipv4Address, uint32_t> m_addressNodes;
+  std::vector<Ptr<NodeTracer> > m_tracers;
+};
+
+/**
+ * \ingroup applications
+ * \brief Reads the files of TraceRecorder
+ *
+ * Columns are found by name, so files with added columns stay readable;
+ * missing columns read as 0.
+ */
+class TraceReader
+{
+public:
+  TraceReader ();
+
+  /// \returns false if the file is not a trace
+  bool Open (std::string filename);
+  /// Read the next record, false at the end of the file
+  bool Next (TraceRecord &record);
+
+  uint32_t GetNColumns (void) const;
+  std::string GetColumnName (uint32_t column) const;
+  uint32_t GetColumnWidth (uint32_t column) const;
+
+private:
+  bool ReadBlock (void);
+  uint64_t GetValue (uint32_t column, uint32_t row) const;
+
+  std::ifstream m_file;
+  std::vector<std::string> m_names;
+  std::vector<uint32_t> m_widths;
+  /// Offset of each column in m_block
+  std::vector<uint32_t> m_offsets;
+  std::vector<uint8_t> m_block;
+  uint32_t m_blockSize;
+  uint32_t m_row;
+  /// Column of each TraceRecord field, or -1
+  int32_t m_fields[7];
+};
+
+} // namespace ns3
+
+#endif /* TRACE_RECORDER_H */
@@ -365,8 +365,15 @@ void
 UdpEchoClient::SendBurst (uint32_t burstLength, Time time, uint32_t flags)
 {
   NS_LOG_FUNCTION_NOARGS ();
+  SendBurstAfter (burstLength, Simulator::Now (), time, flags);
+}
+
+void 
+UdpEchoClient::SendBurstAfter (uint32_t burstLength, Time start, Time time, uint32_t flags)
+{
+  NS_LOG_FUNCTION (this << burstLength << start << time << flags);
   uint32_t burstCount = 0;
-  Time packetTime = Simulator::Now();
+  Time packetTime = start;
   while (burstLength > 0) {
     Ptr<Packet> p;
     p = Create<Packet> ((uint8_t*)&burstCount, sizeof(burstCount));
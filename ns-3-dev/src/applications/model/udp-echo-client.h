@@ -123,7 +123,19 @@ public:
    */
   void SetFill (uint8_t *fill, uint32_t fillSize, uint32_t dataSize);
 
+  /**
+   * @apanda
+   * Send a burst of packets spaced time apart. The first packet leaves after
+   * as long as the simulation has already run, i.e. a burst requested at t
+   * starts at 2t.
+   */
   void SendBurst (uint32_t, Time, uint32_t flags);
+  /**
+   * @apanda
+   * Send a burst of burstLength packets spaced time apart, the first one
+   * start from now.
+   */
+  void SendBurstAfter (uint32_t burstLength, Time start, Time time, uint32_t flags);
   void Send (void);
 
   /**
@@ -0,0 +1,183 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <sstream>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/udp-echo-helper.h"
+#include "ns3/udp-echo-client.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simple-channel.h"
+#include "ns3/echo-stats.h"
+
+using namespace ns3;
+
+/// Two nodes on one channel, echoing from a client on the first to the second
+static Ptr<UdpEchoClient>
+BuildEchoPair (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  Ptr<SimpleNetDevice> txDev = CreateObject<SimpleNetDevice> ();
+  Ptr<SimpleNetDevice> rxDev = CreateObject<SimpleNetDevice> ();
+  nodes.Get (0)->AddDevice (txDev);
+  nodes.Get (1)->AddDevice (rxDev);
+  Ptr<SimpleChannel> channel = CreateObject<SimpleChannel> ();
+  txDev->SetChannel (channel);
+  rxDev->SetChannel (channel);
+  NetDeviceContainer devices;
+  devices.Add (txDev);
+  devices.Add (rxDev);
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  UdpEchoServerHelper echoServer (9);
+  ApplicationContainer serverApps = echoServer.Install (nodes.Get (1));
+  serverApps.Start (Seconds (1.0));
+  serverApps.Stop (Seconds (10.0));
+  UdpEchoClientHelper echoClient (interfaces.GetAddress (1), 9);
+  echoClient.SetAttribute ("MaxPackets", UintegerValue (0));
+  echoClient.SetAttribute ("Interval", TimeValue (Seconds (100.0)));
+  ApplicationContainer clientApps = echoClient.Install (nodes.Get (0));
+  clientApps.Start (Seconds (1.0));
+  clientApps.Stop (Seconds (10.0));
+  return DynamicCast<UdpEchoClient> (clientApps.Get (0));
+}
+
+class EchoStatsTestCase : public TestCase
+{
+public:
+  EchoStatsTestCase ();
+  virtual void DoRun (void);
+};
+
+EchoStatsTestCase::EchoStatsTestCase ()
+  : TestCase ("Echo path statistics collected online and merged across runs")
+{
+}
+
+void
+EchoStatsTestCase::DoRun (void)
+{
+  Ptr<UdpEchoClient> client = BuildEchoPair ();
+
+  Ptr<EchoStats> stats = CreateObject<EchoStats> ();
+  stats->SetAttribute ("Experiment", StringValue ("direct"));
+  stats->SetAttribute ("Delay", DoubleValue (100));
+  stats->ConnectUdpEchoClient (client, 0, 1, 1);
+  Simulator::Schedule (Seconds (2.0), &UdpEchoClient::SendBurst, PeekPointer (client), 5, MilliSeconds (1), 0);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (stats->GetPaths ().size (), 1, "one path");
+  const EchoStats::Key &key = stats->GetPaths ().begin ()->first;
+  const EchoStats::PathStats &path = stats->GetPaths ().begin ()->second;
+  NS_TEST_EXPECT_MSG_EQ (key.experiment, "direct", "experiment label");
+  NS_TEST_EXPECT_MSG_EQ (key.delay, 100, "delay");
+  NS_TEST_EXPECT_MSG_EQ (path.sent, 5, "echoes sent");
+  NS_TEST_EXPECT_MSG_EQ (path.received, 5, "echoes answered");
+  NS_TEST_EXPECT_MSG_EQ (path.reordered, 0, "in order");
+  NS_TEST_EXPECT_MSG_EQ (path.maxDisplacement, 0, "in place");
+  NS_TEST_EXPECT_MSG_EQ (path.latency.getCount (), 5, "a latency per reply");
+  NS_TEST_EXPECT_MSG_EQ (path.hops.getMean (), 1, "one hop back");
+  NS_TEST_EXPECT_MSG_EQ (path.stretch.getMax (), 1, "shortest path");
+
+  // Two runs' summaries merge into one path
+  std::ostringstream summary;
+  stats->Write (summary);
+  Ptr<EchoStats> merged = CreateObject<EchoStats> ();
+  std::istringstream first (summary.str ());
+  std::istringstream second (summary.str ());
+  NS_TEST_ASSERT_MSG_EQ (merged->Load (first), true, "read " << summary.str ());
+  NS_TEST_ASSERT_MSG_EQ (merged->Load (second), true, "read again");
+  NS_TEST_ASSERT_MSG_EQ (merged->GetPaths ().size (), 1, "same path");
+  const EchoStats::PathStats &both = merged->GetPaths ().begin ()->second;
+  NS_TEST_EXPECT_MSG_EQ (both.sent, 10, "merged sent");
+  NS_TEST_EXPECT_MSG_EQ (both.latency.getCount (), 10, "merged latencies");
+  NS_TEST_EXPECT_MSG_EQ (both.latency.getMax (), path.latency.getMax (), "merged maximum");
+
+  std::ostringstream table;
+  merged->PrintTable (table);
+  NS_TEST_EXPECT_MSG_EQ (table.str ().find ("\ndirect,100,1,10,10,"), table.str ().find ('\n'), "one row " << table.str ());
+
+  std::istringstream bad ("path direct 100 0 1 5\n");
+  NS_TEST_EXPECT_MSG_EQ (merged->Load (bad), false, "truncated line");
+  NS_TEST_EXPECT_MSG_EQ (merged->GetPaths ().begin ()->second.sent, 10, "left alone on error");
+}
+
+class EchoStatsRestartTestCase : public TestCase
+{
+public:
+  EchoStatsRestartTestCase ();
+  virtual void DoRun (void);
+};
+
+EchoStatsRestartTestCase::EchoStatsRestartTestCase ()
+  : TestCase ("Restarted echo clients count under the new delay")
+{
+}
+
+void
+EchoStatsRestartTestCase::DoRun (void)
+{
+  Ptr<UdpEchoClient> client = BuildEchoPair ();
+
+  Ptr<EchoStats> stats = CreateObject<EchoStats> ();
+  stats->SetAttribute ("Delay", DoubleValue (100));
+  stats->ConnectUdpEchoClient (client, 0, 1, 1);
+  Simulator::Schedule (Seconds (2.0), &UdpEchoClient::SendBurstAfter, PeekPointer (client), 5, Seconds (0),
+                       MilliSeconds (1), 0);
+  Simulator::Stop (Seconds (3.0));
+  Simulator::Run ();
+  // The second run of sequence numbers starts over without counting as reordered
+  stats->SetAttribute ("Delay", DoubleValue (200));
+  stats->Restart ();
+  client->SendBurstAfter (3, Seconds (1.0), MilliSeconds (1), 0);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (stats->GetPaths ().size (), 2, "a path per delay");
+  const EchoStats::PathStats &before = stats->GetPaths ().begin ()->second;
+  const EchoStats::PathStats &after = stats->GetPaths ().rbegin ()->second;
+  NS_TEST_EXPECT_MSG_EQ (stats->GetPaths ().rbegin ()->first.delay, 200, "new delay");
+  NS_TEST_EXPECT_MSG_EQ (before.sent, 5, "first burst");
+  NS_TEST_EXPECT_MSG_EQ (before.received, 5, "first burst answered");
+  NS_TEST_EXPECT_MSG_EQ (after.sent, 3, "second burst");
+  NS_TEST_EXPECT_MSG_EQ (after.received, 3, "second burst answered");
+  NS_TEST_EXPECT_MSG_EQ (after.reordered, 0, "in order");
+  NS_TEST_EXPECT_MSG_EQ (after.maxDisplacement, 0, "in place");
+}
+
+class EchoStatsTestSuite : public TestSuite
+{
+public:
+  EchoStatsTestSuite ()
+    : TestSuite ("echo-stats", UNIT)
+  {
+    AddTestCase (new EchoStatsTestCase ());
+    AddTestCase (new EchoStatsRestartTestCase ());
+  }
+} g_echoStatsTestSuite;
@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <fstream>
+#include <sstream>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "ns3/schedule-source.h"
+
+using namespace ns3;
+
+class ScheduleSourceTestCase : public TestCase
+{
+public:
+  ScheduleSourceTestCase ();
+  virtual void DoRun (void);
+private:
+  /// Run a schedule file, one line per event fired
+  std::string RunSchedule (std::string filename);
+  void Receive (const ScheduleEvent &event);
+  std::ostringstream m_fired;
+  Ptr<ScheduleSource> m_source;
+  /// Events read when the first one fired
+  uint64_t m_readAtFirst;
+};
+
+ScheduleSourceTestCase::ScheduleSourceTestCase ()
+  : TestCase ("Text and binary schedules fed through a bounded window")
+{
+}
+
+void
+ScheduleSourceTestCase::Receive (const ScheduleEvent &event)
+{
+  NS_TEST_EXPECT_MSG_EQ (event.time, Simulator::Now (), "fired on time");
+  if (m_fired.str ().empty ())
+    {
+      m_readAtFirst = m_source->GetEventsRead ();
+    }
+  m_fired << event.time.GetNanoSeconds () << " " << event.type;
+  for (uint32_t i = 0; i < event.args.size (); i++)
+    {
+      m_fired << " " << event.args[i];
+    }
+  m_fired << "\n";
+}
+
+std::string
+ScheduleSourceTestCase::RunSchedule (std::string filename)
+{
+  m_fired.str ("");
+  m_readAtFirst = 0;
+  m_source = CreateObject<ScheduleSource> ();
+  m_source->SetAttribute ("Lookahead", TimeValue (Seconds (1.0)));
+  m_source->SetAttribute ("MaxPending", UintegerValue (2));
+  NS_TEST_EXPECT_MSG_EQ (m_source->Open (filename), true, "opened " << filename);
+  m_source->SetEventCallback (MakeCallback (&ScheduleSourceTestCase::Receive, this));
+  m_source->Start ();
+  // Two events in the window and the one after them
+  NS_TEST_EXPECT_MSG_EQ (m_source->GetEventsRead (), 3, "read ahead lazily");
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (m_source->GetPeakPending (), 2, "bounded window");
+  NS_TEST_EXPECT_MSG_EQ (m_source->GetEventsRead (), 7, "whole schedule read");
+  Simulator::Destroy ();
+  m_source->Dispose ();
+  m_source = 0;
+  return m_fired.str ();
+}
+
+void
+ScheduleSourceTestCase::DoRun (void)
+{
+  std::string text = CreateTempDirFilename ("schedule.txt");
+  std::ofstream out (text.c_str ());
+  out << "0.5 q 3 6 2\n"
+      << "1.0 q 4 9\n"
+      << "1.0 f 1=2 3=4\n"
+      << "\n"
+      << "2.5 q 1 5 1500.0\n"
+      << "7 q 2 7\n"
+      << "7.25 f 10=12\n"
+      << "9.125 q 1 300 5000000000\n";
+  out.close ();
+  std::string expected =
+    "500000000 q 3 6 2\n"
+    "1000000000 q 4 9\n"
+    "1000000000 f 1 2 3 4\n"
+    "2500000000 q 1 5 1500\n"
+    "7000000000 q 2 7\n"
+    "7250000000 f 10 12\n"
+    "9125000000 q 1 300 5000000000\n";
+
+  NS_TEST_EXPECT_MSG_EQ (RunSchedule (text), expected, "text schedule");
+  NS_TEST_EXPECT_MSG_EQ (m_readAtFirst, 3, "the rest is read as the simulation runs");
+
+  std::string binary = CreateTempDirFilename ("schedule.bin");
+  NS_TEST_ASSERT_MSG_EQ (ScheduleSource::WriteBinary (text, binary), true, "converted");
+  NS_TEST_EXPECT_MSG_EQ (RunSchedule (binary), expected, "binary schedule");
+}
+
+class ScheduleSourceTestSuite : public TestSuite
+{
+public:
+  ScheduleSourceTestSuite ()
+    : TestSuite ("schedule-source", UNIT)
+  {
+    AddTestCase (new ScheduleSourceTestCase ());
+  }
+} g_scheduleSourceTestSuite;
@@ -71,5 +71,11 @@ Ipv4GlobalRoutingHelper::RecomputeRoutingTables (void)
   GlobalRouteManager::InitializeRoutes ();
 }
 
+void 
+Ipv4GlobalRoutingHelper::RecomputeRoutingTables (Ptr<NetDevice> device)
+{
+  GlobalRouteManager::UpdateRoutesForLink (device);
+}
+
 
 } // namespace ns3
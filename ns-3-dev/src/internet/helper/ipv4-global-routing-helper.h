@@ -21,6 +21,7 @@
 #define IPV4_GLOBAL_ROUTING_HELPER_H
 
 #include "ns3/node-container.h"
+#include "ns3/net-device.h"
 #include "ns3/ipv4-routing-helper.h"
 
 namespace ns3 {
@@ -83,6 +84,19 @@ public:
    *
    */
   static void RecomputeRoutingTables (void);
+  /**
+   * \brief Update the routes after the point-to-point link of a device
+   * went down, without recomputing every routing table.
+   *
+   * SPF is only rerun from the nodes whose shortest paths used the link and
+   * only the routing entries that changed are rewritten.  The number of
+   * such nodes and entries is available from
+   * GlobalRouteManager::GetUpdatedRoots () and
+   * GlobalRouteManager::GetUpdatedEntries ().
+   *
+   * \param device Either end of the link
+   */
+  static void RecomputeRoutingTables (Ptr<NetDevice> device);
 private:
   /**
    * \internal
@@ -0,0 +1,142 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/assert.h"
+#include "ddc-message-header.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (DdcMessageHeader);
+
+DdcMessageHeader::DdcMessageHeader ()
+  : m_sender (0)
+{
+}
+
+void
+DdcMessageHeader::SetSender (uint32_t node)
+{
+  m_sender = node;
+}
+
+uint32_t
+DdcMessageHeader::GetSender (void) const
+{
+  return m_sender;
+}
+
+void
+DdcMessageHeader::AddEntry (uint8_t type, Ipv4Address destination, uint32_t value)
+{
+  NS_ASSERT_MSG (m_entries.size () < 0xffff, "Too many entries in one DDC message");
+  Entry entry;
+  entry.m_type = type;
+  entry.m_destination = destination;
+  entry.m_value = value;
+  m_entries.push_back (entry);
+}
+
+uint32_t
+DdcMessageHeader::GetNEntries (void) const
+{
+  return m_entries.size ();
+}
+
+const DdcMessageHeader::Entry &
+DdcMessageHeader::GetEntry (uint32_t i) const
+{
+  NS_ASSERT (i < m_entries.size ());
+  return m_entries[i];
+}
+
+uint32_t
+DdcMessageHeader::GetFixedSize (void)
+{
+  return 6;
+}
+
+uint32_t
+DdcMessageHeader::GetEntrySize (void)
+{
+  return 9;
+}
+
+TypeId
+DdcMessageHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DdcMessageHeader")
+    .SetParent<Header> ()
+    .AddConstructor<DdcMessageHeader> ()
+  ;
+  return tid;
+}
+TypeId
+DdcMessageHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+DdcMessageHeader::Print (std::ostream &os) const
+{
+  os << "sender=" << m_sender << " entries=" << m_entries.size ();
+  for (std::vector<Entry>::const_iterator i = m_entries.begin (); i != m_entries.end (); i++)
+    {
+      os << " (" << (uint32_t)i->m_type << " " << i->m_destination << " " << i->m_value << ")";
+    }
+}
+
+uint32_t
+DdcMessageHeader::GetSerializedSize (void) const
+{
+  return GetFixedSize () + m_entries.size () * GetEntrySize ();
+}
+
+void
+DdcMessageHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteHtonU32 (m_sender);
+  i.WriteHtonU16 (m_entries.size ());
+  for (std::vector<Entry>::const_iterator it = m_entries.begin (); it != m_entries.end (); it++)
+    {
+      i.WriteU8 (it->m_type);
+      i.WriteHtonU32 (it->m_destination.Get ());
+      i.WriteHtonU32 (it->m_value);
+    }
+}
+
+uint32_t
+DdcMessageHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  m_sender = i.ReadNtohU32 ();
+  uint16_t entries = i.ReadNtohU16 ();
+  m_entries.clear ();
+  m_entries.reserve (entries);
+  for (uint16_t n = 0; n < entries; n++)
+    {
+      Entry entry;
+      entry.m_type = i.ReadU8 ();
+      entry.m_destination = Ipv4Address (i.ReadNtohU32 ());
+      entry.m_value = i.ReadNtohU32 ();
+      m_entries.push_back (entry);
+    }
+  return GetSerializedSize ();
+}
+
+} // namespace ns3
@@ -0,0 +1,86 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef DDC_MESSAGE_HEADER_H
+#define DDC_MESSAGE_HEADER_H
+
+#include <vector>
+#include "ns3/header.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * @apanda
+ * \brief DDC control message exchanged between neighbouring routers.
+ *
+ * One message carries the AEO lock traffic, vnode updates and heartbeats of
+ * many destinations.  Entries are handled in the order they were added, so
+ * for instance a vnode update sent before an unlock is seen first.
+ *
+ * Wire format: uint32 sender node ID, uint16 number of entries, then per
+ * entry a uint8 type, the destination address and a uint32 value (the vnode
+ * of a Vnode entry, the sequence number of a Heartbeat entry, 0 otherwise).
+ */
+class DdcMessageHeader : public Header
+{
+public:
+  enum Type {
+    LockRequest = 1,
+    LockGrant = 2,
+    LockDeny = 3,
+    Unlock = 4,
+    Vnode = 5,
+    Heartbeat = 6
+  };
+
+  struct Entry
+  {
+    uint8_t m_type;
+    Ipv4Address m_destination;
+    uint32_t m_value;
+  };
+
+  DdcMessageHeader ();
+
+  void SetSender (uint32_t node);
+  uint32_t GetSender (void) const;
+
+  void AddEntry (uint8_t type, Ipv4Address destination, uint32_t value);
+  uint32_t GetNEntries (void) const;
+  const Entry &GetEntry (uint32_t i) const;
+
+  /// Bytes of a message without entries
+  static uint32_t GetFixedSize (void);
+  /// Bytes each entry adds
+  static uint32_t GetEntrySize (void);
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint32_t m_sender;
+  std::vector<Entry> m_entries;
+};
+
+} // namespace ns3
+
+#endif /* DDC_MESSAGE_HEADER_H */
@@ -0,0 +1,110 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <stdint.h>
+#include "flow-hash-tag.h"
+
+namespace ns3 {
+
+FlowHashTag::FlowHashTag ()
+  : m_hash (0)
+{
+}
+
+FlowHashTag::FlowHashTag (uint32_t hash)
+  : m_hash (hash)
+{
+}
+
+void
+FlowHashTag::SetHash (uint32_t hash)
+{
+  m_hash = hash;
+}
+
+uint32_t
+FlowHashTag::GetHash (void) const
+{
+  return m_hash;
+}
+
+TypeId
+FlowHashTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FlowHashTag")
+    .SetParent<Tag> ()
+    .AddConstructor<FlowHashTag> ()
+  ;
+  return tid;
+}
+TypeId
+FlowHashTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+FlowHashTag::Hash (Ptr<const Packet> p, const Ipv4Header &header)
+{
+  uint32_t ports = 0;
+  uint8_t protocol = header.GetProtocol ();
+  if ((protocol == 6 || protocol == 17) && header.IsLastFragment ()
+      && header.GetFragmentOffset () == 0 && p->GetSize () >= 4)
+    {
+      uint8_t buf[4];
+      p->CopyData (buf, 4);
+      ports = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+    }
+  uint32_t hash = Mix (header.GetSource ().Get ());
+  hash = Mix (hash ^ header.GetDestination ().Get ());
+  hash = Mix (hash ^ protocol);
+  return Mix (hash ^ ports);
+}
+
+uint32_t
+FlowHashTag::Mix (uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+uint32_t
+FlowHashTag::GetSerializedSize (void) const
+{
+  return sizeof (uint32_t);
+}
+void
+FlowHashTag::Serialize (TagBuffer i) const
+{
+  i.WriteU32 (m_hash);
+}
+void
+FlowHashTag::Deserialize (TagBuffer i)
+{
+  m_hash = i.ReadU32 ();
+}
+void
+FlowHashTag::Print (std::ostream &os) const
+{
+  os << "FlowHash=" << m_hash;
+}
+
+} // namespace ns3
@@ -0,0 +1,67 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef FLOW_HASH_TAG_H
+#define FLOW_HASH_TAG_H
+
+#include "ns3/tag.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4-header.h"
+
+namespace ns3 {
+
+/**
+ * @apanda
+ * \brief Hash of the 5-tuple of a packet, computed by the first router that
+ * needs it so later hops do not parse the transport header again.
+ *
+ * The hash is not seeded, each router mixes in its own seed when picking
+ * among equal cost routes.  Ipv4L3Protocol::Send tags the packets a node
+ * originates, once their addresses and transport header are known.
+ */
+class FlowHashTag : public Tag
+{
+public:
+  FlowHashTag ();
+  FlowHashTag (uint32_t hash);
+
+  void SetHash (uint32_t hash);
+  uint32_t GetHash (void) const;
+
+  /**
+   * Unseeded hash of the addresses, protocol and ports of p, which starts
+   * with its transport header.  Ports are left out of fragments, so every
+   * fragment of a packet and every packet of a flow agree.
+   */
+  static uint32_t Hash (Ptr<const Packet> p, const Ipv4Header &header);
+  /// Finalizer of MurmurHash3, spreads every input bit over the result
+  static uint32_t Mix (uint32_t h);
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint32_t m_hash;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_HASH_TAG_H */
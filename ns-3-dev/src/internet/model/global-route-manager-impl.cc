@@ -26,27 +26,53 @@
 #include <vector>
 #include <queue>
 #include <algorithm>
+#include <iterator>
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <functional>
 #include <utility>
+#include <unistd.h>
+#include "ns3/core-config.h"
 #include "ns3/assert.h"
 #include "ns3/fatal-error.h"
 #include "ns3/log.h"
+#include "ns3/global-value.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
 #include "ns3/node-list.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/ipv4-list-routing.h"
 #include "ns3/mpi-interface.h"
+#include "ns3/ipv4-routing-table-entry.h"
 #include "global-router-interface.h"
 #include "global-route-manager-impl.h"
 #include "candidate-queue.h"
 #include "ipv4-global-routing.h"
+#ifdef HAVE_PTHREAD_H
+#include "ns3/system-thread.h"
+#include "ns3/system-mutex.h"
+#endif /* HAVE_PTHREAD_H */
 
 NS_LOG_COMPONENT_DEFINE ("GlobalRouteManager");
 
 namespace ns3 {
 
+// @apanda
+static GlobalValue g_spfThreads ("GlobalRoutingSpfThreads",
+                                 "Number of threads computing the SPF trees of InitializeRoutes (), "
+                                 "0 for one per online processor",
+                                 UintegerValue (0),
+                                 MakeUintegerChecker<uint32_t> ());
+
+// @apanda
+static GlobalValue g_ddcPerNode ("GlobalRoutingDdcPerNode",
+                                 "Keep one DDC state per destination node, shared by all of its addresses, "
+                                 "instead of one per address",
+                                 BooleanValue (false),
+                                 MakeBooleanChecker ());
+
 std::ostream& 
 operator<< (std::ostream& os, const SPFVertex::NodeExit_t& exit)
 {
@@ -467,6 +493,22 @@ GlobalRouteManagerLSDB::Insert (Ipv4Address addr, GlobalRoutingLSA* lsa)
     }
 }
 
+GlobalRouteManagerLSDB*
+GlobalRouteManagerLSDB::Copy () const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  GlobalRouteManagerLSDB *lsdb = new GlobalRouteManagerLSDB ();
+  for (LSDBMap_t::const_iterator i = m_database.begin (); i != m_database.end (); i++)
+    {
+      lsdb->m_database.insert (LSDBPair_t (i->first, new GlobalRoutingLSA (*i->second)));
+    }
+  for (uint32_t j = 0; j < m_extdatabase.size (); j++)
+    {
+      lsdb->m_extdatabase.push_back (new GlobalRoutingLSA (*m_extdatabase[j]));
+    }
+  return lsdb;
+}
+
 GlobalRoutingLSA*
 GlobalRouteManagerLSDB::GetExtLSA (uint32_t index) const
 {
@@ -528,9 +570,18 @@ GlobalRouteManagerLSDB::GetLSAByLinkData (Ipv4Address addr) const
 //
 // ---------------------------------------------------------------------------
 
+const uint16_t GlobalRouteManagerImpl::DISTANCE_UNREACHABLE;
+const uint32_t GlobalRouteManagerImpl::DISTANCE_MAGIC;
+
 GlobalRouteManagerImpl::GlobalRouteManagerImpl () 
   :
-    m_spfroot (0)
+    m_spfroot (0),
+    m_result (0),
+    m_job (0),
+    m_distanceNodes (0),
+    m_ddcPerNode (false),
+    m_updatedRoots (0),
+    m_updatedEntries (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
   m_lsdb = new GlobalRouteManagerLSDB ();
@@ -607,7 +658,11 @@ GlobalRouteManagerImpl::BuildGlobalRoutingDatabase ()
 //
 // Walk the list of nodes looking for the GlobalRouter Interface.  Nodes with
 // global router interfaces are, not too surprisingly, our routers.
+// @apanda Remember each of them by router ID so the SPF install paths do not
+// have to walk the node list again for every vertex.
 //
+  m_routers.clear ();
+  m_routerIndex.clear ();
   NodeList::Iterator listEnd = NodeList::End ();
   for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
     {
@@ -630,6 +685,20 @@ GlobalRouteManagerImpl::BuildGlobalRoutingDatabase ()
 // found.
 //
       Ptr<Ipv4GlobalRouting> grouting = rtr->GetRoutingProtocol ();
+      RouterEntry entry;
+      entry.m_node = node;
+      entry.m_router = rtr;
+      entry.m_routing = grouting;
+      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+      for (uint32_t k = 0; ipv4 && k < ipv4->GetNInterfaces (); k++)
+        {
+          for (uint32_t l = 0; l < ipv4->GetNAddresses (k); l++)
+            {
+              entry.m_addresses.push_back (std::make_pair (ipv4->GetAddress (k, l).GetLocal (), k));
+            }
+        }
+      m_routerIndex[rtr->GetRouterId ()] = m_routers.size ();
+      m_routers.push_back (entry);
       uint32_t numLSAs = rtr->DiscoverLSAs ();
       NS_LOG_LOGIC ("Found " << numLSAs << " LSAs");
 
@@ -692,7 +761,62 @@ GlobalRouteManagerImpl::InitializeRoutes ()
 //
   NS_LOG_INFO ("About to start SPF calculation");
   NodeList::Iterator listEnd = NodeList::End ();
-  std::map<Ipv4Address, Ptr<Node> > nodeMap;
+  std::vector<Ipv4Address> roots;
+  ResetDistances ();
+  BooleanValue perNode;
+  g_ddcPerNode.GetValue (perNode);
+  m_ddcPerNode = perNode.Get ();
+  // All addresses of a node share the DDC state of its first one
+  Ptr<Ipv4DestinationAliases> aliases = 0;
+  if (m_ddcPerNode)
+    {
+      aliases = Create<Ipv4DestinationAliases> ();
+      for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+        {
+          Ptr<Ipv4> ipv4 = (*i)->GetObject<Ipv4> ();
+          if (ipv4 == 0)
+            {
+              continue;
+            }
+          Ipv4Address first;
+          bool found = false;
+          for (uint32_t iface = 1; iface < ipv4->GetNInterfaces (); iface++)
+            {
+              for (uint32_t addr = 0; addr < ipv4->GetNAddresses (iface); addr++)
+                {
+                  Ipv4Address local = ipv4->GetAddress (iface, addr).GetLocal ();
+                  if (!found)
+                    {
+                      first = local;
+                      found = true;
+                    }
+                  aliases->Add (local, first);
+                }
+            }
+        }
+    }
+  // Every router ends up with state for every DDC destination
+  uint32_t ddcDestinations = 0;
+  std::vector<Ipv4Address> addresses;
+  m_addressNodes.clear ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Ipv4> ipv4 = (*i)->GetObject<Ipv4> ();
+      GetDdcDestinations (ipv4, addresses);
+      ddcDestinations += addresses.size ();
+      for (uint32_t iface = 1; ipv4 != 0 && iface < ipv4->GetNInterfaces (); iface++)
+        {
+          for (uint32_t addr = 0; addr < ipv4->GetNAddresses (iface); addr++)
+            {
+              m_addressNodes[ipv4->GetAddress (iface, addr).GetLocal ()] = (*i)->GetId ();
+            }
+        }
+    }
+  for (std::vector<RouterEntry>::iterator it = m_routers.begin (); it != m_routers.end (); it++)
+    {
+      it->m_routing->SetDestinationAliases (aliases);
+      it->m_routing->ReserveDestinations (ddcDestinations);
+    }
   for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
     {
       Ptr<Node> node = *i;
@@ -716,14 +840,21 @@ GlobalRouteManagerImpl::InitializeRoutes ()
       if (rtr && rtr->GetNumLSAs () )
         {
           m_reversalMap.insert(AEOMap::value_type(rtr->GetRouterId(), std::list<Ptr<Ipv4GlobalRouting> >())); 
-          m_distance.insert(Distances::value_type(node->GetId(), std::vector<uint32_t>(NodeList::GetNNodes(), 0)));
-          SPFCalculate (rtr->GetRouterId ());
-          nodeMap.insert(std::map<Ipv4Address, Ptr<Node> >::value_type(rtr->GetRouterId(), node));
+          roots.push_back (rtr->GetRouterId ());
           NS_LOG_LOGIC("=== INSERT ROOT ===");
           NS_LOG_LOGIC("While adding, router ID " << rtr->GetRouterId());
           
         }
     }
+  UintegerValue threads;
+  g_spfThreads.GetValue (threads);
+  uint32_t nThreads = threads.Get ();
+  if (nThreads == 0)
+    {
+      long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+      nThreads = cpus > 0 ? cpus : 1;
+    }
+  SPFCalculateAll (roots, nThreads);
   NS_LOG_LOGIC("Final tally");
   for (AEOMap::iterator it = m_reversalMap.begin(); it != m_reversalMap.end(); it++) {
     NS_LOG_LOGIC(it->first <<" -> " << (uint32_t)it->second.size());
@@ -736,18 +867,17 @@ GlobalRouteManagerImpl::InitializeRoutes ()
   }
   NS_LOG_LOGIC("===== NODE MAP ====");
   NS_LOG_LOGIC("=== DISTANCES ===");
-  for (Distances::iterator it = m_distance.begin(); it != m_distance.end(); it++) {
+  for (uint32_t i = 0; i < m_distanceNodes; i++) {
     std::stringstream line;
-    line << it->first << ": ";
-    for (std::vector<uint32_t>::iterator it2 = it->second.begin(); it2 != it->second.end(); it2++) {
-      line << *it2 << " ";
+    line << i << ": ";
+    for (uint32_t j = 0; j < m_distanceNodes; j++) {
+      line << GetDistance(i, j) << " ";
     }
     NS_LOG_LOGIC(line.str());
   }
   NS_LOG_LOGIC("=== DISTANCES ===");
-  for (std::map<Ipv4Address, Ptr<Node> >::iterator it = nodeMap.begin(); it != nodeMap.end(); it++) {
-    Ptr<Node> node = it->second;
-    NS_LOG_LOGIC(node->GetId() << "  " << it->first);
+  for (std::vector<RouterEntry>::iterator it = m_routers.begin(); it != m_routers.end(); it++) {
+    NS_LOG_LOGIC(it->m_node->GetId() << "  " << it->m_router->GetRouterId());
   }
   NS_LOG_LOGIC("===== NODE MAP ====");
   listEnd = NodeList::End ();
@@ -787,19 +917,16 @@ GlobalRouteManagerImpl::InitializeRoutes ()
               uint32_t currIface = ipv4->GetInterfaceForAddress(l->GetLinkData());
               interfaceMap.insert(std::map<uint32_t, Ipv4Address>::value_type(currIface,
                                                         l->GetLinkId()));
-              Ptr<Node> nextHop = nodeMap[l->GetLinkId()];
+              const RouterEntry *nextHop = FindRouter(l->GetLinkId());
+              NS_ASSERT_MSG(nextHop != 0, "Could not find neighbor " << l->GetLinkId());
               // Record translation between node ID and interace
-              inverseInterfaceMap.insert(std::map<uint32_t, uint32_t>::value_type(nextHop->GetId(), currIface));
+              inverseInterfaceMap.insert(std::map<uint32_t, uint32_t>::value_type(nextHop->m_node->GetId(), currIface));
             }
           }
           // Add one for the current node
           inverseInterfaceMap.insert(std::map<uint32_t, uint32_t>::value_type(node->GetId(), 0));
-          for (uint32_t iface = 1; iface < ipv4->GetNInterfaces(); iface++) {
-            for (uint32_t addr = 0; addr < ipv4->GetNAddresses(iface); addr++) {
-              NS_LOG_LOGIC("InitialHeartbeat for " << ipv4->GetAddress(iface, addr) << " for node " << node->GetId());
-              Simulator::ScheduleNow(&Ipv4GlobalRouting::SendInitialHeartbeat, gr, ipv4->GetAddress(iface, addr).GetLocal());
-            }
-          }
+          ScheduleHeartbeats(node, gr);
+          std::vector<Ipv4Address> destinations;
 
           for (NodeList::Iterator i2 = NodeList::Begin(); i2 != listEnd; i2++) {
             Ptr<Node> dest = *i2;
@@ -810,12 +937,12 @@ GlobalRouteManagerImpl::InitializeRoutes ()
                         std::greater<std::vector<IntPair>::value_type> > InterfaceQueue;
             InterfaceQueue intQueue;
             // Add the current node in
-            intQueue.push(std::pair<uint32_t, uint32_t>(m_distance[node->GetId()][dest->GetId()], node->GetId()));
+            intQueue.push(std::pair<uint32_t, uint32_t>(GetDistance(node->GetId(), dest->GetId()), node->GetId()));
             for (std::map<uint32_t, Ipv4Address>::iterator it = interfaceMap.begin();
                 it != interfaceMap.end(); it++) {
-                Ptr<Node> nextHop = nodeMap[it->second];
+                Ptr<Node> nextHop = FindRouter(it->second)->m_node;
                 // Add IDs for every subsequent interface
-                intQueue.push(std::pair<uint32_t, uint32_t>(m_distance[nextHop->GetId()][dest->GetId()], nextHop->GetId()));
+                intQueue.push(std::pair<uint32_t, uint32_t>(GetDistance(nextHop->GetId(), dest->GetId()), nextHop->GetId()));
             }
             std::stringstream outline;
             std::list<uint32_t> interfaces;
@@ -830,11 +957,17 @@ GlobalRouteManagerImpl::InitializeRoutes ()
             
             NS_LOG_LOGIC ( node->GetId() << " (dest = " << dest-> GetId() << ") " << outline.str());
 
-            for (uint32_t iface = 1; iface < destIpv4->GetNInterfaces(); iface++) {
-              for (uint32_t addr = 0; addr < destIpv4->GetNAddresses(iface); addr++) {
-                gr->SetReversalOrder(destIpv4->GetAddress (iface, addr).GetLocal (), interfaces);
-                for (uint32_t oiface = 1; oiface < ipv4->GetNInterfaces(); oiface++) {
-                  gr->SetInterfacePriority(destIpv4->GetAddress(iface, addr).GetLocal(), oiface, ifaceDistances[oiface]);
+            GetDdcDestinations(destIpv4, destinations);
+            for (std::vector<Ipv4Address>::iterator it = destinations.begin(); it != destinations.end(); it++) {
+              gr->SetReversalOrder(*it, interfaces);
+              for (uint32_t oiface = 1; oiface < ipv4->GetNInterfaces(); oiface++) {
+                if (gr->GetDistanceRanking()) {
+                  // The distance ranks the links, and follows link failures
+                  gr->SetInterfacePriority(*it, oiface, 0);
+                  gr->SetInterfaceDistance(*it, oiface, ifaceDistances[oiface]);
+                }
+                else {
+                  gr->SetInterfacePriority(*it, oiface, ifaceDistances[oiface]);
                 }
               }
             }
@@ -845,6 +978,233 @@ GlobalRouteManagerImpl::InitializeRoutes ()
   NS_LOG_INFO ("Finished SPF calculation");
 }
 
+//
+// @apanda Incremental counterpart of DeleteGlobalRoutes (),
+// BuildGlobalRoutingDatabase () and InitializeRoutes () for a single
+// point-to-point link going down.  The LSDB is rebuilt, which is cheap, but
+// SPF is only rerun from roots whose shortest-path DAG contained the link,
+// judged by the distances the previous SPF left in m_distance.  The routes
+// of such a root are collected instead of installed and handed to
+// Ipv4GlobalRouting::UpdateRoutes (), which only rewrites the entries that
+// changed.  Every other root keeps its tree, so all that
+// changes there are the destinations the two ends stopped advertising.
+//
+// A link coming up, a metric change, parallel links or anything that is not
+// a point-to-point link between two routers reruns SPF from every root, still
+// rewriting only the changed entries.  DDC state (reversal order, interface
+// priorities) is left as InitializeRoutes () set it up.
+//
+void
+GlobalRouteManagerImpl::UpdateRoutesForLink (Ptr<NetDevice> device)
+{
+  NS_LOG_FUNCTION (device);
+  m_updatedRoots = 0;
+  m_updatedEntries = 0;
+
+  Ptr<Node> local = device->GetNode ();
+  Ptr<Node> remote = 0;
+  Ptr<Channel> channel = device->GetChannel ();
+  if (channel && channel->GetNDevices () == 2)
+    {
+      remote = channel->GetDevice (channel->GetDevice (0) == device ? 1 : 0)->GetNode ();
+    }
+  Ptr<GlobalRouter> localRouter = local->GetObject<GlobalRouter> ();
+  Ptr<GlobalRouter> remoteRouter = remote ? remote->GetObject<GlobalRouter> () : 0;
+  bool incremental = device->IsPointToPoint () && localRouter && remoteRouter;
+
+  GlobalRouteManagerLSDB *oldLsdb = m_lsdb;
+  m_lsdb = new GlobalRouteManagerLSDB ();
+  BuildGlobalRoutingDatabase ();
+
+  LinkDestinations oldHosts, oldNetworks, newHosts, newNetworks;
+  std::vector<uint16_t> oldLocal, oldRemote, newLocal, newRemote;
+  if (incremental)
+    {
+      Ipv4Address localId = localRouter->GetRouterId ();
+      Ipv4Address remoteId = remoteRouter->GetRouterId ();
+      incremental = 
+        ExamineLSA (oldLsdb->GetLSA (localId), remoteId, oldHosts, oldNetworks, oldLocal) &&
+        ExamineLSA (oldLsdb->GetLSA (remoteId), localId, oldHosts, oldNetworks, oldRemote) &&
+        ExamineLSA (m_lsdb->GetLSA (localId), remoteId, newHosts, newNetworks, newLocal) &&
+        ExamineLSA (m_lsdb->GetLSA (remoteId), localId, newHosts, newNetworks, newRemote);
+    }
+  delete oldLsdb;
+
+  // SPF only follows a link that both of its ends advertise
+  bool wasUp = !oldLocal.empty () && !oldRemote.empty ();
+  bool isUp = !newLocal.empty () && !newRemote.empty ();
+  if (oldLocal.size () > 1 || oldRemote.size () > 1 || (isUp && (!wasUp || oldLocal != newLocal || oldRemote != newRemote)) ||
+      !std::includes (oldHosts.begin (), oldHosts.end (), newHosts.begin (), newHosts.end ()) ||
+      !std::includes (oldNetworks.begin (), oldNetworks.end (), newNetworks.begin (), newNetworks.end ()))
+    {
+      incremental = false;
+    }
+  LinkDestinations goneHosts, goneNetworks;
+  std::set_difference (oldHosts.begin (), oldHosts.end (), newHosts.begin (), newHosts.end (),
+                       std::inserter (goneHosts, goneHosts.begin ()));
+  std::set_difference (oldNetworks.begin (), oldNetworks.end (), newNetworks.begin (), newNetworks.end (),
+                       std::inserter (goneNetworks, goneNetworks.begin ()));
+
+  uint32_t a = local->GetId ();
+  uint32_t b = remote ? remote->GetId () : 0;
+  if (m_distanceNodes != NodeList::GetNNodes ())
+    {
+      // Nodes were added since InitializeRoutes (), so the distances cannot
+      // tell which roots are affected
+      ResetDistances ();
+      incremental = false;
+    }
+  std::vector<bool> changed (m_distanceNodes, false);
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Node> node = *i;
+      Ptr<GlobalRouter> rtr = node->GetObject<GlobalRouter> ();
+      if (node->GetSystemId () != MpiInterface::GetSystemId () || !rtr || !rtr->GetNumLSAs ())
+        {
+          continue;
+        }
+      Ptr<Ipv4GlobalRouting> gr = rtr->GetRoutingProtocol ();
+      uint32_t root = node->GetId ();
+
+      bool affected = !incremental;
+      if (!affected && wasUp && !isUp)
+        {
+          uint16_t distA = GetDistance (root, a);
+          uint16_t distB = GetDistance (root, b);
+          affected = distA != DISTANCE_UNREACHABLE && distB != DISTANCE_UNREACHABLE &&
+            (distA + oldLocal[0] == distB || distB + oldRemote[0] == distA);
+        }
+
+      if (affected)
+        {
+          SPFResult result;
+          SPFCalculate (rtr->GetRouterId (), result);
+          StoreDistances (root, result);
+          changed[root] = true;
+          m_updatedEntries += gr->UpdateRoutes (result.m_hostRoutes, result.m_networkRoutes,
+                                                result.m_externalRoutes);
+          m_updatedRoots++;
+          continue;
+        }
+      for (LinkDestinations::iterator j = goneHosts.begin (); j != goneHosts.end (); j++)
+        {
+          m_updatedEntries += gr->RemoveHostRoutesTo (j->first);
+        }
+      for (LinkDestinations::iterator j = goneNetworks.begin (); j != goneNetworks.end (); j++)
+        {
+          m_updatedEntries += gr->RemoveNetworkRoutesTo (j->first, Ipv4Mask (j->second));
+        }
+    }
+  UpdateInterfaceDistances (changed);
+  NS_LOG_INFO ("Link update reran SPF from " << m_updatedRoots << " roots and rewrote " << 
+               m_updatedEntries << " routing entries");
+}
+
+//
+// @apanda The distance from the neighbour m behind an interface to a
+// destination node d can only have changed if the row of m or of d did.
+//
+void
+GlobalRouteManagerImpl::UpdateInterfaceDistances (const std::vector<bool> &changed)
+{
+  if (std::find (changed.begin (), changed.end (), true) == changed.end ())
+    {
+      return;
+    }
+  std::vector<std::pair<Ipv4Address, uint32_t> > destinations;
+  std::vector<Ipv4Address> addresses;
+  for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); i++)
+    {
+      GetDdcDestinations ((*i)->GetObject<Ipv4> (), addresses);
+      for (uint32_t j = 0; j < addresses.size (); j++)
+        {
+          destinations.push_back (std::make_pair (addresses[j], (*i)->GetId ()));
+        }
+    }
+  for (std::vector<RouterEntry>::iterator r = m_routers.begin (); r != m_routers.end (); r++)
+    {
+      if (!r->m_routing->GetDistanceRanking ())
+        {
+          continue;
+        }
+      Ptr<Ipv4> ipv4 = r->m_node->GetObject<Ipv4> ();
+      for (uint32_t iface = 1; iface < ipv4->GetNInterfaces (); iface++)
+        {
+          Ptr<Channel> channel = ipv4->GetNetDevice (iface)->GetChannel ();
+          if (channel == 0 || channel->GetNDevices () != 2)
+            {
+              continue;
+            }
+          Ptr<NetDevice> device = ipv4->GetNetDevice (iface);
+          uint32_t neighbor = channel->GetDevice (channel->GetDevice (0) == device ? 1 : 0)->GetNode ()->GetId ();
+          for (uint32_t d = 0; d < destinations.size (); d++)
+            {
+              uint32_t dest = destinations[d].second;
+              if (neighbor < changed.size () && dest < changed.size () && (changed[neighbor] || changed[dest]))
+                {
+                  r->m_routing->SetInterfaceDistance (destinations[d].first, iface, GetDistance (neighbor, dest));
+                }
+            }
+        }
+    }
+}
+
+uint32_t
+GlobalRouteManagerImpl::GetUpdatedRoots (void) const
+{
+  return m_updatedRoots;
+}
+
+uint32_t
+GlobalRouteManagerImpl::GetUpdatedEntries (void) const
+{
+  return m_updatedEntries;
+}
+
+//
+// @apanda Collect the host and stub destinations an LSA advertises, and the
+// metrics of its point-to-point records towards a neighbor.  Returns false
+// for LSAs UpdateRoutesForLink () cannot follow incrementally.
+//
+bool
+GlobalRouteManagerImpl::ExamineLSA (GlobalRoutingLSA *lsa, Ipv4Address neighbor,
+                                    LinkDestinations &hosts, LinkDestinations &networks,
+                                    std::vector<uint16_t> &metrics)
+{
+  if (lsa == 0)
+    {
+      return true;
+    }
+  if (lsa->GetLSType () != GlobalRoutingLSA::RouterLSA)
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < lsa->GetNLinkRecords (); i++)
+    {
+      GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (i);
+      switch (l->GetLinkType ())
+        {
+        case GlobalRoutingLinkRecord::PointToPoint:
+          hosts.insert (std::make_pair (l->GetLinkData (), Ipv4Mask::GetOnes ().Get ()));
+          if (l->GetLinkId () == neighbor)
+            {
+              metrics.push_back (l->GetMetric ());
+            }
+          break;
+        case GlobalRoutingLinkRecord::StubNetwork:
+          {
+            Ipv4Mask mask (l->GetLinkData ().Get ());
+            networks.insert (std::make_pair (l->GetLinkId ().CombineMask (mask), mask.Get ()));
+          }
+          break;
+        default:
+          return false;
+        }
+    }
+  return true;
+}
+
 //
 // This method is derived from quagga ospf_spf_next ().  See RFC2328 Section 
 // 16.1 (2) for further details.
@@ -1363,7 +1723,9 @@ void
 GlobalRouteManagerImpl::DebugSPFCalculate (Ipv4Address root)
 {
   NS_LOG_FUNCTION (root);
-  SPFCalculate (root);
+  SPFResult result;
+  SPFCalculate (root, result);
+  InstallRoutes (root, result);
 }
 
 //
@@ -1455,11 +1817,12 @@ GlobalRouteManagerImpl::CheckForStubNode (Ipv4Address root)
 
 // quagga ospf_spf_calculate
 void
-GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
+GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root, SPFResult &result)
 {
   NS_LOG_FUNCTION (this << root);
 
   SPFVertex *v;
+  m_result = &result;
 //
 // Initialize the Link State Database.
 //
@@ -1620,6 +1983,7 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 //
   delete m_spfroot;
   m_spfroot = 0;
+  m_result = 0;
 }
 
 void
@@ -1678,105 +2042,58 @@ GlobalRouteManagerImpl::SPFAddASExternal (GlobalRoutingLSA *extlsa, SPFVertex *v
 
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex.
+// This is the one we're going to write the routing information to.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  const RouterEntry *root = FindRouter (routerId);
+  if (root == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
+      NS_LOG_LOGIC ("SPFAddASExternal():Can't find root node " << routerId);
+      return;
+    }
+  NS_LOG_LOGIC ("Setting routes for node " << root->m_node->GetId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = extlsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImpl::SPFAddASExternal (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = extlsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
 
 //
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
+// Here's why we did all of that work.  We're going to add a network route
+// to the external prefix advertised in <extlsa>, using the exit directions
+// precalculated on the advertising router's vertex <v>.
 //
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddASExternalRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add external network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  // walk through all next-hop-IPs and out-going-interfaces for reaching
+  // the stub network gateway 'v' from the root node
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      if (outIf >= 0)
+        {
+          m_result->m_externalRoutes.push_back (
+            Ipv4RoutingTableEntry::CreateNetworkRouteTo (tempip, tempmask, nextHop, outIf));
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                        " add external network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
+        }
+      else
+        {
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative");
+        }
+    }
 }
 
 
@@ -1847,60 +2164,28 @@ GlobalRouteManagerImpl::SPFIntraAddStub (GlobalRoutingLinkRecord *l, SPFVertex*
 
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex.
+// This is the one we're going to write the routing information to.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  const RouterEntry *root = FindRouter (routerId);
+  if (root == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
+      NS_LOG_LOGIC ("SPFIntraAddStub():Can't find root node " << routerId);
+      return;
+    }
+  NS_LOG_LOGIC ("Setting routes for node " << root->m_node->GetId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask (l->GetLinkData ().Get ());
-          Ipv4Address tempip = l->GetLinkId ();
-          tempip = tempip.CombineMask (tempmask);
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImpl::SPFIntraAddStub (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask (l->GetLinkData ().Get ());
+  Ipv4Address tempip = l->GetLinkId ();
+  tempip = tempip.CombineMask (tempmask);
 //
 // Here's why we did all of that work.  We're going to add a host route to the
 // host address found in the m_linkData field of the point-to-point link
@@ -1914,40 +2199,30 @@ GlobalRouteManagerImpl::SPFIntraAddStub (GlobalRoutingLinkRecord *l, SPFVertex*
 // Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
 // which the packets should be send for forwarding.
 //
-
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  // walk through all next-hop-IPs and out-going-interfaces for reaching
+  // the stub network gateway 'v' from the root node
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      if (outIf >= 0)
+        {
+          m_result->m_networkRoutes.push_back (
+            Ipv4RoutingTableEntry::CreateNetworkRouteTo (tempip, tempmask, nextHop, outIf));
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                        " add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
+        }
+      else
+        {
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative");
+        }
+    }
 }
 
 //
@@ -1971,61 +2246,44 @@ GlobalRouteManagerImpl::FindOutgoingInterfaceId (Ipv4Address a, Ipv4Mask amask)
 //
   Ipv4Address routerId = m_spfroot->GetVertexId ();
 //
-// Walk the list of nodes in the system looking for the one corresponding to
-// the node at the root of the SPF tree.  This is the node for which we are
-// building the routing table.
+// Look up the node at the root of the SPF tree.  This is the node for which
+// we are building the routing table.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  const RouterEntry *root = FindRouter (routerId);
+  if (root == 0)
     {
-      Ptr<Node> node = *i;
-
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-//
-// If the node doesn't have a GlobalRouter interface it can't be the one
-// we're interested in.
-//
-      if (rtr == 0)
-        {
-          continue;
-        }
-
-      if (rtr->GetRouterId () == routerId)
-        {
 //
-// This is the node we're building the routing table for.  We're going to need
-// the Ipv4 interface to look for the ipv4 interface index.  Since this node
-// is participating in routing IP version 4 packets, it certainly must have 
-// an Ipv4 interface.
+// Couldn't find it.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::FindOutgoingInterfaceId (): "
-                         "GetObject for <Ipv4> interface failed");
+      NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
+      return -1;
+    }
 //
-// Look through the interfaces on this node for one that has the IP address
-// we're looking for.  If we find one, return the corresponding interface
-// index, or -1 if not found.
+// This is the node we're building the routing table for.  Look through the
+// addresses of its Ipv4 interfaces, as recorded when the database was built,
+// for one in the prefix we're looking for.  This is what
+// Ipv4::GetInterfaceForPrefix () does, without touching the node, so it is
+// safe from the SPF worker threads.  If we find one, return the
+// corresponding interface index, or -1 if not found.
 //
-          int32_t interface = ipv4->GetInterfaceForPrefix (a, amask);
+  int32_t interface = -1;
+  for (uint32_t i = 0; i < root->m_addresses.size (); i++)
+    {
+      if (root->m_addresses[i].first.CombineMask (amask) == a.CombineMask (amask))
+        {
+          interface = root->m_addresses[i].second;
+          break;
+        }
+    }
 
 #if 0
-          if (interface < 0)
-            {
-              NS_FATAL_ERROR ("GlobalRouteManagerImpl::FindOutgoingInterfaceId(): "
-                              "Expected an interface associated with address a:" << a);
-            }
-#endif 
-          return interface;
-        }
+  if (interface < 0)
+    {
+      NS_FATAL_ERROR ("GlobalRouteManagerImpl::FindOutgoingInterfaceId(): "
+                      "Expected an interface associated with address a:" << a);
     }
-//
-// Couldn't find it.
-//
-  NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
-  return -1;
+#endif 
+  return interface;
 }
 
 //
@@ -2062,85 +2320,33 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 // @apanda Find destination node, so we can get a nice distance map here
-  Ptr<Node> dest = 0;
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++) 
-    {
-      dest = *i;
-      Ptr<GlobalRouter> rtr =
-        dest->GetObject<GlobalRouter> ();
-        if (rtr == 0)
-          {
-            continue;
-          }
-
-        if (rtr->GetRouterId () == v->GetVertexId ()) 
-          {
-            break;
-          }
-        else
-          {
-            dest = 0;
-          }
-    }
-    NS_ASSERT_MSG(dest != 0, "Could not find destination");
-  
+  const RouterEntry *dest = FindRouter (v->GetVertexId ());
+  NS_ASSERT_MSG (dest != 0, "Could not find destination");
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex.
+// This is the one we're going to write the routing information to.
 //
-  i = NodeList::Begin (); 
-  listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  const RouterEntry *root = FindRouter (routerId);
+  if (root == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "GetObject for <Ipv4> interface failed");
+      NS_LOG_LOGIC ("SPFIntraAddRouter():Can't find root node " << routerId);
+      return;
+    }
+  NS_LOG_LOGIC ("Setting routes for node " << root->m_node->GetId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
+                 "Expected valid LSA in SPFVertex* v");
 
-          uint32_t nLinkRecords = lsa->GetNLinkRecords ();
+  uint32_t nLinkRecords = lsa->GetNLinkRecords ();
+  // @apanda Every router vertex gets a distance, whatever its links are
+  m_result->m_distances.push_back (std::make_pair (dest->m_node->GetId (), v->GetDistanceFromRoot ()));
 //
 // Iterate through the link records on the vertex to which we're going to add
 // routes.  To make sure we're being clear, we're going to add routing table
@@ -2149,18 +2355,18 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // the local side of the point-to-point links found on the node described by
 // the vertex <v>.
 //
-          NS_LOG_LOGIC (" Node " << node->GetId () <<
-                        " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
-          for (uint32_t j = 0; j < nLinkRecords; ++j)
-            {
+  NS_LOG_LOGIC (" Node " << root->m_node->GetId () <<
+                " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
+  for (uint32_t j = 0; j < nLinkRecords; ++j)
+    {
 //
 // We are only concerned about point-to-point links
 //
-              GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
-              if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
-                {
-                  continue;
-                }
+      GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
+        {
+          continue;
+        }
 //
 // Here's why we did all of that work.  We're going to add a host route to the
 // host address found in the m_linkData field of the point-to-point link
@@ -2174,48 +2380,34 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
 // which the packets should be send for forwarding.
 //
-              Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-              if (router == 0)
-                {
-                  continue;
-                }
-              Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-              NS_ASSERT (gr);
-              // walk through all available exit directions due to ECMP,
-              // and add host route for each of the exit direction toward
-              // the vertex 'v'
-              for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-                {
-                  SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-                  Ipv4Address nextHop = exit.first;
-                  int32_t outIf = exit.second;
-                  if (outIf >= 0)
-                    {
-                      gr->AddHostRouteTo (lr->GetLinkData (), nextHop,
-                                          outIf);
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " adding host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " and outgoing interface " << outIf);
-                    }
-                  else
-                    {
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " NOT able to add host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " since outgoing interface id is negative " << outIf);
-                    }
-                } // for all routes from the root the vertex 'v'
-                m_reversalMap[lr->GetLinkData ()].push_back(gr);
-                m_distance[node->GetId()][dest->GetId()] = v->GetDistanceFromRoot();
-                //gr->PrimitiveAEO (lr->GetLinkData ());
-                // Record this order and then call stuff in order
+      // walk through all available exit directions due to ECMP,
+      // and add host route for each of the exit direction toward
+      // the vertex 'v'
+      for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+        {
+          SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+          Ipv4Address nextHop = exit.first;
+          int32_t outIf = exit.second;
+          if (outIf >= 0)
+            {
+              m_result->m_hostRoutes.push_back (
+                Ipv4RoutingTableEntry::CreateHostRouteTo (lr->GetLinkData (), nextHop, outIf));
+              NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                            " adding host route to " << lr->GetLinkData () <<
+                            " using next hop " << nextHop <<
+                            " and outgoing interface " << outIf);
             }
-//
-// Done adding the routes for the selected node.
-//
-          return;
-        }
+          else
+            {
+              NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                            " NOT able to add host route to " << lr->GetLinkData () <<
+                            " using next hop " << nextHop <<
+                            " since outgoing interface id is negative " << outIf);
+            }
+        } // for all routes from the root the vertex 'v'
+        m_result->m_reversals.push_back (lr->GetLinkData ());
+        //gr->PrimitiveAEO (lr->GetLinkData ());
+        // Record this order and then call stuff in order
     }
 }
 void
@@ -2236,95 +2428,55 @@ GlobalRouteManagerImpl::SPFIntraAddTransit (SPFVertex* v)
 
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex.
+// This is the one we're going to write the routing information to.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  const RouterEntry *root = FindRouter (routerId);
+  if (root == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "GetObject for <Ipv4> interface failed");
+      NS_LOG_LOGIC ("SPFIntraAddTransit():Can't find root node " << routerId);
+      return;
+    }
+  NS_LOG_LOGIC ("setting routes for node " << root->m_node->GetId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = lsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all available exit directions due to ECMP,
-          // and add host route for each of the exit direction toward
-          // the vertex 'v'
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = lsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+  // walk through all available exit directions due to ECMP,
+  // and add host route for each of the exit direction toward
+  // the vertex 'v'
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
 
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative " << outIf);
-                }
-            }
+      if (outIf >= 0)
+        {
+          m_result->m_networkRoutes.push_back (
+            Ipv4RoutingTableEntry::CreateNetworkRouteTo (tempip, tempmask, nextHop, outIf));
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                        " add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
         }
-    } 
+      else
+        {
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << root->m_node->GetId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative " << outIf);
+        }
+    }
 }
 
 // Derived from quagga ospf_vertex_add_parents ()
@@ -2350,21 +2502,321 @@ GlobalRouteManagerImpl::SPFVertexAddParent (SPFVertex* v)
     }
 }
 
+//
+// @apanda Install what SPFCalculate () found for a root: its routes, its
+// place in the reversal lists and its row of the distance map.
+//
 void
-GlobalRouteManagerImpl::SendHeartbeats()
+GlobalRouteManagerImpl::InstallRoutes (Ipv4Address root, const SPFResult &result)
 {
-  for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); i++)
+  NS_LOG_FUNCTION (root);
+  const RouterEntry *entry = FindRouter (root);
+  if (entry == 0)
     {
-      Ptr<Node> node = *i;
-      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
-      Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-      Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-      for (uint32_t iface = 1; iface < ipv4->GetNInterfaces(); iface++) {
-        for (uint32_t addr = 0; addr < ipv4->GetNAddresses(iface); addr++) {
-          NS_LOG_LOGIC("InitialHeartbeat for " << ipv4->GetAddress(iface, addr) << " for node " << node->GetId());
-          Simulator::ScheduleNow(&Ipv4GlobalRouting::SendInitialHeartbeat, gr, ipv4->GetAddress(iface, addr).GetLocal());
+      NS_LOG_LOGIC ("InstallRoutes():Can't find root node " << root);
+      return;
+    }
+  Ptr<Ipv4GlobalRouting> gr = entry->m_routing;
+  NS_ASSERT (gr);
+  for (uint32_t i = 0; i < result.m_hostRoutes.size (); i++)
+    {
+      const Ipv4RoutingTableEntry &route = result.m_hostRoutes[i];
+      gr->AddHostRouteTo (route.GetDest (), route.GetGateway (), route.GetInterface ());
+    }
+  for (uint32_t i = 0; i < result.m_networkRoutes.size (); i++)
+    {
+      const Ipv4RoutingTableEntry &route = result.m_networkRoutes[i];
+      gr->AddNetworkRouteTo (route.GetDestNetwork (), route.GetDestNetworkMask (),
+                             route.GetGateway (), route.GetInterface ());
+    }
+  for (uint32_t i = 0; i < result.m_externalRoutes.size (); i++)
+    {
+      const Ipv4RoutingTableEntry &route = result.m_externalRoutes[i];
+      gr->AddASExternalRouteTo (route.GetDestNetwork (), route.GetDestNetworkMask (),
+                                route.GetGateway (), route.GetInterface ());
+    }
+  for (uint32_t i = 0; i < result.m_reversals.size (); i++)
+    {
+      m_reversalMap[result.m_reversals[i]].push_back (gr);
+    }
+  StoreDistances (entry->m_node->GetId (), result);
+}
+
+//
+// @apanda Size the distance matrix for the nodes of the simulation, with
+// every node unreachable from every other.
+//
+void
+GlobalRouteManagerImpl::ResetDistances (void)
+{
+  m_distanceNodes = NodeList::GetNNodes ();
+  m_distance.assign (m_distanceNodes * m_distanceNodes, DISTANCE_UNREACHABLE);
+  for (uint32_t i = 0; i < m_distanceNodes; i++)
+    {
+      m_distance[i * m_distanceNodes + i] = 0;
+    }
+}
+
+//
+// @apanda Replace the row of <node> in the distance matrix with the
+// distances SPFCalculate () found from it.
+//
+void
+GlobalRouteManagerImpl::StoreDistances (uint32_t node, const SPFResult &result)
+{
+  NS_ASSERT_MSG (node < m_distanceNodes, "No distance matrix row for node " << node);
+  std::vector<uint16_t>::iterator row = m_distance.begin () + node * m_distanceNodes;
+  std::fill (row, row + m_distanceNodes, DISTANCE_UNREACHABLE);
+  row[node] = 0;
+  for (uint32_t i = 0; i < result.m_distances.size (); i++)
+    {
+      uint32_t distance = result.m_distances[i].second;
+      NS_ASSERT (result.m_distances[i].first < m_distanceNodes);
+      row[result.m_distances[i].first] = distance < DISTANCE_UNREACHABLE ? distance : DISTANCE_UNREACHABLE - 1;
+    }
+}
+
+const std::vector<uint16_t> &
+GlobalRouteManagerImpl::GetDistanceMatrix (void) const
+{
+  return m_distance;
+}
+
+uint32_t
+GlobalRouteManagerImpl::GetNDistanceNodes (void) const
+{
+  return m_distanceNodes;
+}
+
+uint16_t
+GlobalRouteManagerImpl::GetDistance (uint32_t from, uint32_t to) const
+{
+  if (from >= m_distanceNodes || to >= m_distanceNodes)
+    {
+      return DISTANCE_UNREACHABLE;
+    }
+  return m_distance[from * m_distanceNodes + to];
+}
+
+bool
+GlobalRouteManagerImpl::FindAddressNode (Ipv4Address address, uint32_t &node) const
+{
+  std::map<Ipv4Address, uint32_t>::const_iterator it = m_addressNodes.find (address);
+  if (it == m_addressNodes.end ())
+    {
+      return false;
+    }
+  node = it->second;
+  return true;
+}
+
+bool
+GlobalRouteManagerImpl::WriteDistanceMatrix (std::string filename) const
+{
+  NS_LOG_FUNCTION (filename);
+  std::ofstream out (filename.c_str (), std::ios::out | std::ios::binary);
+  uint32_t header[2] = { DISTANCE_MAGIC, m_distanceNodes };
+  out.write (reinterpret_cast<const char *> (header), sizeof (header));
+  if (!m_distance.empty ())
+    {
+      out.write (reinterpret_cast<const char *> (&m_distance[0]), m_distance.size () * sizeof (uint16_t));
+    }
+  out.close ();
+  if (out.fail ())
+    {
+      NS_LOG_WARN ("Could not write the distance matrix to " << filename);
+      return false;
+    }
+  return true;
+}
+
+//
+// @apanda Roots of InitializeRoutes () that the worker threads share.  They
+// take the next root of the current batch under m_lock, so a slow root does
+// not hold up the others, and leave its result at its position in the batch.
+//
+struct GlobalRouteManagerImpl::SPFJob
+{
+#ifdef HAVE_PTHREAD_H
+  SystemMutex m_lock;
+#endif /* HAVE_PTHREAD_H */
+  const std::vector<Ipv4Address> *m_roots;
+  std::vector<SPFResult> m_results;
+  uint32_t m_first;
+  uint32_t m_next;
+  uint32_t m_end;
+};
+
+//
+// @apanda Compute the SPF trees of all roots, on up to <threads> threads.
+// Each SPF tree only reads the LSDB, apart from the status flags of its
+// LSAs, so every worker gets a copy of the LSDB of its own and nothing else
+// is shared but the read-only router index.  The workers never copy a Ptr
+// (the reference counts are not atomic); the routes they find are installed
+// on this thread, batch by batch and in root order, so the routing tables,
+// m_reversalMap and m_distance come out exactly as with a single thread.
+//
+void
+GlobalRouteManagerImpl::SPFCalculateAll (const std::vector<Ipv4Address> &roots, uint32_t threads)
+{
+  NS_LOG_FUNCTION (roots.size () << threads);
+  threads = std::min<uint32_t> (threads, roots.size ());
+#ifdef HAVE_PTHREAD_H
+  // Log output of concurrent SPF trees would be interleaved
+  if (threads > 1 && g_log.IsNoneEnabled ())
+    {
+      SPFJob job;
+      job.m_roots = &roots;
+      std::vector<GlobalRouteManagerImpl *> workers;
+      for (uint32_t t = 0; t < threads; t++)
+        {
+          GlobalRouteManagerImpl *worker = new GlobalRouteManagerImpl ();
+          delete worker->m_lsdb;
+          worker->m_lsdb = m_lsdb->Copy ();
+          worker->m_routers = m_routers;
+          worker->m_routerIndex = m_routerIndex;
+          worker->m_job = &job;
+          workers.push_back (worker);
+        }
+      // Bounds the memory held by results that are not installed yet
+      const uint32_t batch = threads * 16;
+      for (uint32_t first = 0; first < roots.size (); first += batch)
+        {
+          job.m_first = first;
+          job.m_next = first;
+          job.m_end = std::min<uint32_t> (first + batch, roots.size ());
+          job.m_results.clear ();
+          job.m_results.resize (job.m_end - first);
+          std::vector<Ptr<SystemThread> > running;
+          for (uint32_t t = 0; t < threads; t++)
+            {
+              Ptr<SystemThread> thread = 
+                Create<SystemThread> (MakeCallback (&GlobalRouteManagerImpl::RunSPFWorker, workers[t]));
+              thread->Start ();
+              running.push_back (thread);
+            }
+          for (uint32_t t = 0; t < threads; t++)
+            {
+              running[t]->Join ();
+            }
+          for (uint32_t i = first; i < job.m_end; i++)
+            {
+              InstallRoutes (roots[i], job.m_results[i - first]);
+            }
+        }
+      for (uint32_t t = 0; t < threads; t++)
+        {
+          delete workers[t];
         }
+      return;
+    }
+#endif /* HAVE_PTHREAD_H */
+  for (uint32_t i = 0; i < roots.size (); i++)
+    {
+      SPFResult result;
+      SPFCalculate (roots[i], result);
+      InstallRoutes (roots[i], result);
+    }
+}
+
+//
+// @apanda Body of an SPF worker thread, see SPFCalculateAll ()
+//
+void
+GlobalRouteManagerImpl::RunSPFWorker (void)
+{
+#ifdef HAVE_PTHREAD_H
+  for (;;)
+    {
+      uint32_t i;
+      {
+        CriticalSection cs (m_job->m_lock);
+        if (m_job->m_next == m_job->m_end)
+          {
+            return;
+          }
+        i = m_job->m_next++;
       }
+      SPFCalculate ((*m_job->m_roots)[i], m_job->m_results[i - m_job->m_first]);
+    }
+#endif /* HAVE_PTHREAD_H */
+}
+
+const GlobalRouteManagerImpl::RouterEntry *
+GlobalRouteManagerImpl::FindRouter (Ipv4Address routerId) const
+{
+  RouterIndex::const_iterator it = m_routerIndex.find (routerId);
+  if (it == m_routerIndex.end ())
+    {
+      return 0;
+    }
+  return &m_routers[it->second];
+}
+
+void
+GlobalRouteManagerImpl::SendHeartbeats()
+{
+  NS_ASSERT_MSG (!m_routers.empty (), "SendHeartbeats () called before the routing database was built");
+  for (std::vector<RouterEntry>::iterator i = m_routers.begin (); i != m_routers.end (); i++)
+    {
+      ScheduleHeartbeats(i->m_node, i->m_routing);
+    }
+}
+
+void
+GlobalRouteManagerImpl::SaveRoutingState ()
+{
+  NS_ASSERT_MSG (!m_routers.empty (), "SaveRoutingState () called before the routing database was built");
+  for (std::vector<RouterEntry>::iterator i = m_routers.begin (); i != m_routers.end (); i++)
+    {
+      i->m_routing->SaveState ();
+    }
+}
+
+void
+GlobalRouteManagerImpl::RestoreRoutingState ()
+{
+  for (std::vector<RouterEntry>::iterator i = m_routers.begin (); i != m_routers.end (); i++)
+    {
+      i->m_routing->RestoreState ();
+    }
+}
+
+void
+GlobalRouteManagerImpl::ScheduleHeartbeats (Ptr<Node> node, Ptr<Ipv4GlobalRouting> gr) const
+{
+  std::vector<Ipv4Address> destinations;
+  GetDdcDestinations(node->GetObject<Ipv4>(), destinations);
+  Simulator::ScheduleNow(&Ipv4GlobalRouting::BeginHeartbeatRound, gr);
+  if (gr->GetBatchHeartbeats()) {
+    NS_LOG_LOGIC("InitialHeartbeat for " << destinations.size() << " destinations for node " << node->GetId());
+    Simulator::ScheduleNow(&Ipv4GlobalRouting::SendInitialHeartbeats, gr, destinations);
+    return;
+  }
+  for (std::vector<Ipv4Address>::iterator it = destinations.begin(); it != destinations.end(); it++) {
+    NS_LOG_LOGIC("InitialHeartbeat for " << *it << " for node " << node->GetId());
+    Simulator::ScheduleNow(&Ipv4GlobalRouting::SendInitialHeartbeat, gr, *it);
+  }
+}
+
+void
+GlobalRouteManagerImpl::GetDdcDestinations (Ptr<Ipv4> ipv4, std::vector<Ipv4Address> &destinations) const
+{
+  destinations.clear ();
+  if (ipv4 == 0)
+    {
+      return;
+    }
+  for (uint32_t iface = 1; iface < ipv4->GetNInterfaces (); iface++)
+    {
+      for (uint32_t addr = 0; addr < ipv4->GetNAddresses (iface); addr++)
+        {
+          destinations.push_back (ipv4->GetAddress (iface, addr).GetLocal ());
+          if (m_ddcPerNode)
+            {
+              return;
+            }
+        }
     }
 }
 } // namespace ns3
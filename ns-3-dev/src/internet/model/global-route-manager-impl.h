@@ -26,10 +26,13 @@
 #include <list>
 #include <queue>
 #include <map>
+#include <set>
 #include <vector>
+#include <string>
 #include "ns3/object.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/sgi-hashmap.h"
 #include "global-router-interface.h"
 
 namespace ns3 {
@@ -38,6 +41,7 @@ const uint32_t SPF_INFINITY = 0xffffffff;
 
 class CandidateQueue;
 class Ipv4GlobalRouting;
+class Ipv4;
 
 /**
  * @brief Vertex used in shortest path first (SPF) computations. See RFC 2328,
@@ -665,6 +669,15 @@ public:
   GlobalRoutingLSA* GetExtLSA (uint32_t index) const;
   uint32_t GetNumExtLSAs () const;
 
+/**
+ * @brief Deep copy of the database, so that an SPF computation can mark the
+ * status flags of its own LSAs while others run on the original.
+ * @internal
+ *
+ * @returns A new database the caller is responsible for deleting.
+ */
+  GlobalRouteManagerLSDB* Copy () const;
+
 
 private:
   typedef std::map<Ipv4Address, GlobalRoutingLSA*> LSDBMap_t;
@@ -739,9 +752,91 @@ public:
  */
   void DebugSPFCalculate (Ipv4Address root);
 
+/**
+ * @brief Update the routes after the point-to-point link of a device went
+ * down or came back up.  SPF is rerun only from the roots whose shortest
+ * paths used the link, and only the routing entries that changed are
+ * removed or added.
+ * @internal
+ */
+  virtual void UpdateRoutesForLink (Ptr<NetDevice> device);
+
+/**
+ * @brief Number of roots the last UpdateRoutesForLink () reran SPF from
+ * @internal
+ */
+  uint32_t GetUpdatedRoots (void) const;
+
+/**
+ * @brief Number of routing entries the last UpdateRoutesForLink () removed
+ * or added
+ * @internal
+ */
+  uint32_t GetUpdatedEntries (void) const;
+
+/**
+ * @brief Cost of the shortest paths between all pairs of nodes, as computed
+ * by the last InitializeRoutes () and kept up to date by
+ * UpdateRoutesForLink ()
+ * @internal
+ *
+ * The matrix is stored row major: the cost from node i to node j is at
+ * index i * GetNDistanceNodes () + j, where i and j are node IDs.  Costs
+ * that do not fit are saturated to DISTANCE_UNREACHABLE - 1.  Pairs without
+ * a path, and rows of nodes that are not routers of this system, hold
+ * DISTANCE_UNREACHABLE; the diagonal is 0.
+ */
+  const std::vector<uint16_t> &GetDistanceMatrix (void) const;
+
+/**
+ * @brief Number of rows and columns of GetDistanceMatrix ()
+ * @internal
+ */
+  uint32_t GetNDistanceNodes (void) const;
+
+/**
+ * @brief Cost of the shortest path from node <from> to node <to>, or
+ * DISTANCE_UNREACHABLE
+ * @internal
+ */
+  uint16_t GetDistance (uint32_t from, uint32_t to) const;
+
+/**
+ * @brief Find the ID of the node an interface address belongs to
+ * @internal
+ * @returns false for addresses of no node
+ */
+  bool FindAddressNode (Ipv4Address address, uint32_t &node) const;
+
+/**
+ * @brief Write GetDistanceMatrix () to a binary file
+ * @internal
+ *
+ * The file holds the uint32_t DISTANCE_MAGIC, the uint32_t number of nodes
+ * N, and then the N * N uint16_t costs in row major order, all in host byte
+ * order.  With numpy it can be read back as
+ * numpy.fromfile (name, numpy.uint16)[4:].reshape (N, N).
+ *
+ * @returns false if the file could not be written
+ */
+  bool WriteDistanceMatrix (std::string filename) const;
+
+  static const uint16_t DISTANCE_UNREACHABLE = 0xffff;
+  static const uint32_t DISTANCE_MAGIC = 0x54534944; // "DIST"
+
   // @apanda
   void SendHeartbeats ();
 
+/**
+ * @brief SaveState () of the routing protocol of every router
+ */
+  void SaveRoutingState ();
+
+/**
+ * @brief RestoreState () of the routing protocol of every router
+ */
+  void RestoreRoutingState ();
+
 private:
 /**
  * @brief GlobalRouteManagerImpl copy construction is disallowed.
@@ -760,7 +855,27 @@ private:
   SPFVertex* m_spfroot;
   GlobalRouteManagerLSDB* m_lsdb;
   bool CheckForStubNode (Ipv4Address root);
-  void SPFCalculate (Ipv4Address root);
+  // @apanda Everything one SPF computation installs for its root.  The SPF
+  // install paths only fill this in and InstallRoutes () applies it, so that
+  // roots can be computed on worker threads and installed in root order.
+  struct SPFResult
+  {
+    std::vector<Ipv4RoutingTableEntry> m_hostRoutes;
+    std::vector<Ipv4RoutingTableEntry> m_networkRoutes;
+    std::vector<Ipv4RoutingTableEntry> m_externalRoutes;
+    // Host addresses whose reversal list the root joins, in order
+    std::vector<Ipv4Address> m_reversals;
+    // (destination node ID, distance) pairs for the root's m_distance row
+    std::vector<std::pair<uint32_t, uint32_t> > m_distances;
+  };
+  void SPFCalculate (Ipv4Address root, SPFResult &result);
+  void InstallRoutes (Ipv4Address root, const SPFResult &result);
+  // @apanda Parallel SPF over all roots, see InitializeRoutes ()
+  struct SPFJob;
+  void SPFCalculateAll (const std::vector<Ipv4Address> &roots, uint32_t threads);
+  void RunSPFWorker (void);
+  SPFResult *m_result;
+  SPFJob *m_job;
   void SPFProcessStubs (SPFVertex* v);
   void ProcessASExternals (SPFVertex* v, GlobalRoutingLSA* extlsa);
   void SPFNext (SPFVertex*, CandidateQueue&);
@@ -778,8 +893,49 @@ private:
   // @apanda
   typedef std::map<Ipv4Address, std::list<Ptr<Ipv4GlobalRouting> > > AEOMap;
   AEOMap m_reversalMap;
-  typedef std::map<uint32_t, std::vector<uint32_t> > Distances;
-  Distances m_distance;
+  // @apanda Dense matrix behind GetDistanceMatrix ()
+  std::vector<uint16_t> m_distance;
+  uint32_t m_distanceNodes;
+  void ResetDistances (void);
+  void StoreDistances (uint32_t node, const SPFResult &result);
+  // @apanda Node of every interface address, see FindAddressNode ()
+  std::map<Ipv4Address, uint32_t> m_addressNodes;
+  // @apanda Hand the distances of the nodes whose row changed to the
+  // routers with the DistanceRanking attribute
+  void UpdateInterfaceDistances (const std::vector<bool> &changed);
+  // @apanda Set from GlobalRoutingDdcPerNode by InitializeRoutes ()
+  bool m_ddcPerNode;
+  // @apanda Addresses of a node DDC keeps state for, only the first one
+  // with m_ddcPerNode
+  void GetDdcDestinations (Ptr<Ipv4> ipv4, std::vector<Ipv4Address> &destinations) const;
+  // @apanda Start a round of heartbeats on node, in one event per
+  // destination or, with the BatchHeartbeats attribute, one for all of them
+  void ScheduleHeartbeats (Ptr<Node> node, Ptr<Ipv4GlobalRouting> gr) const;
+
+  // @apanda Destinations of an LSA, as (address, mask) pairs
+  typedef std::set<std::pair<Ipv4Address, uint32_t> > LinkDestinations;
+  bool ExamineLSA (GlobalRoutingLSA *lsa, Ipv4Address neighbor,
+                   LinkDestinations &hosts, LinkDestinations &networks,
+                   std::vector<uint16_t> &metrics);
+  uint32_t m_updatedRoots;
+  uint32_t m_updatedEntries;
+
+  // @apanda Node, GlobalRouter and routing protocol that go with a router ID
+  struct RouterEntry
+  {
+    Ptr<Node> m_node;
+    Ptr<GlobalRouter> m_router;
+    Ptr<Ipv4GlobalRouting> m_routing;
+    // Local address and interface index of every Ipv4 address, in the order
+    // Ipv4::GetInterfaceForPrefix () walks them
+    std::vector<std::pair<Ipv4Address, int32_t> > m_addresses;
+  };
+  // @apanda Every router in NodeList order, filled in while building the
+  // LSDB, and the position of each router ID in it
+  typedef sgi::hash_map<Ipv4Address, uint32_t, Ipv4AddressHash> RouterIndex;
+  std::vector<RouterEntry> m_routers;
+  RouterIndex m_routerIndex;
+  const RouterEntry *FindRouter (Ipv4Address routerId) const;
 
 };
 
@@ -53,6 +53,62 @@ GlobalRouteManager::InitializeRoutes (void)
   InitializeRoutes ();
 }
 
+void
+GlobalRouteManager::UpdateRoutesForLink (Ptr<NetDevice> device)
+{
+  SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+  UpdateRoutesForLink (device);
+}
+
+uint32_t
+GlobalRouteManager::GetUpdatedRoots (void)
+{
+  return SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+         GetUpdatedRoots ();
+}
+
+uint32_t
+GlobalRouteManager::GetUpdatedEntries (void)
+{
+  return SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+         GetUpdatedEntries ();
+}
+
+uint16_t
+GlobalRouteManager::GetDistance (uint32_t from, uint32_t to)
+{
+  return SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+         GetDistance (from, to);
+}
+
+bool
+GlobalRouteManager::FindAddressNode (Ipv4Address address, uint32_t &node)
+{
+  return SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+         FindAddressNode (address, node);
+}
+
+bool
+GlobalRouteManager::WriteDistanceMatrix (std::string filename)
+{
+  return SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+         WriteDistanceMatrix (filename);
+}
+
+void
+GlobalRouteManager::SaveRoutingState (void)
+{
+  SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+  SaveRoutingState ();
+}
+
+void
+GlobalRouteManager::RestoreRoutingState (void)
+{
+  SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+  RestoreRoutingState ();
+}
+
 uint32_t
 GlobalRouteManager::AllocateRouterId (void)
 {
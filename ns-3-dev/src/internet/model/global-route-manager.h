@@ -22,10 +22,16 @@
 #ifndef GLOBAL_ROUTE_MANAGER_H
 #define GLOBAL_ROUTE_MANAGER_H
 
+#include <stdint.h>
+#include <string>
 #include "ns3/deprecated.h"
+#include "ns3/ptr.h"
+#include "ns3/ipv4-address.h"
 
 namespace ns3 {
 
+class NetDevice;
+
 /**
  * @brief A global global router
  *
@@ -67,6 +73,59 @@ public:
  */
   static void InitializeRoutes ();
 
+/**
+ * @brief Update the routes after the point-to-point link of a device went
+ * down, rerunning SPF only from the roots whose shortest paths used it and
+ * rewriting only the routing entries that changed
+ * @internal
+ */
+  static void UpdateRoutesForLink (Ptr<NetDevice> device);
+
+/**
+ * @brief Number of roots the last UpdateRoutesForLink () reran SPF from
+ */
+  static uint32_t GetUpdatedRoots ();
+
+/**
+ * @brief Number of routing entries the last UpdateRoutesForLink () removed
+ * or added
+ */
+  static uint32_t GetUpdatedEntries ();
+
+/**
+ * @brief Cost of the shortest path from node <from> to node <to> found by
+ * the last route computation, or 0xffff if there is none
+ */
+  static uint16_t GetDistance (uint32_t from, uint32_t to);
+
+/**
+ * @brief Find the ID of the node an interface address belongs to, as of the
+ * last InitializeRoutes ()
+ * @returns false for addresses of no node
+ */
+  static bool FindAddressNode (Ipv4Address address, uint32_t &node);
+
+/**
+ * @brief Write the all-pairs distance matrix of the last route computation
+ * to a binary file
+ * @see GlobalRouteManagerImpl::WriteDistanceMatrix
+ * @returns false if the file could not be written
+ */
+  static bool WriteDistanceMatrix (std::string filename);
+
+/**
+ * @brief Keep the DDC state of every router, for RestoreRoutingState ()
+ * @see Ipv4GlobalRouting::SaveState
+ */
+  static void SaveRoutingState ();
+
+/**
+ * @brief Put every router back in the DDC state SaveRoutingState () kept,
+ * so one converged network can run several scenarios
+ * @see Ipv4GlobalRouting::RestoreState
+ */
+  static void RestoreRoutingState ();
+
 private:
 /**
  * @brief Global Route Manager copy construction is disallowed.  There's no 
@@ -17,6 +17,9 @@
 //
 
 #include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include "ns3/names.h"
@@ -28,8 +31,13 @@
 #include "ns3/ipv4-route.h"
 #include "ns3/ipv4-routing-table-entry.h"
 #include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/priority-tag.h"
 #include "ipv4-global-routing.h"
+#include "flow-hash-tag.h"
 #include "global-route-manager.h"
+#include "ipv4-l3-protocol.h"
 
 NS_LOG_COMPONENT_DEFINE ("Ipv4GlobalRouting");
 
@@ -37,6 +45,67 @@ namespace ns3 {
 
 NS_OBJECT_ENSURE_REGISTERED (Ipv4GlobalRouting);
 
+// @apanda Helpers for the rank-ordered interface bitmasks
+static inline uint32_t
+LinkSetWords (uint32_t links)
+{
+  return (links + 63) / 64;
+}
+
+static inline void
+LinkSetAdd (uint64_t *set, uint32_t rank)
+{
+  set[rank / 64] |= ((uint64_t)1) << (rank % 64);
+}
+
+static inline void
+LinkSetRemove (uint64_t *set, uint32_t rank)
+{
+  set[rank / 64] &= ~(((uint64_t)1) << (rank % 64));
+}
+
+static inline bool
+LinkSetContains (const uint64_t *set, uint32_t rank)
+{
+  return (set[rank / 64] >> (rank % 64)) & 0x1;
+}
+
+static inline bool
+LinkSetEmpty (const uint64_t *set, uint32_t words)
+{
+  for (uint32_t w = 0; w < words; w++) {
+    if (set[w] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// @apanda
+void
+Ipv4DestinationAliases::Add (Ipv4Address alias, Ipv4Address dest)
+{
+  if (alias != dest)
+    {
+      m_aliases[alias] = dest;
+    }
+}
+
+// @apanda
+Ipv4Address
+Ipv4DestinationAliases::Resolve (Ipv4Address addr) const
+{
+  AliasMap::const_iterator it = m_aliases.find (addr);
+  return it == m_aliases.end () ? addr : it->second;
+}
+
+// @apanda
+uint32_t
+Ipv4DestinationAliases::GetN (void) const
+{
+  return m_aliases.size ();
+}
+
 TypeId 
 Ipv4GlobalRouting::GetTypeId (void)
 { 
@@ -47,11 +116,26 @@ Ipv4GlobalRouting::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&Ipv4GlobalRouting::m_randomEcmpRouting),
                    MakeBooleanChecker ())
+    .AddAttribute ("FlowEcmpRouting",
+                   "Set to true if packets are routed among ECMP by a hash of their 5-tuple, keeping each flow on one route; takes precedence over RandomEcmpRouting",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_flowEcmpRouting),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FlowHashSeed",
+                   "Seed mixed into the flow hash by this node; give nodes different seeds to avoid hash polarization",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4GlobalRouting::m_flowHashSeed),
+                   MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("RespondToInterfaceEvents",
                    "Set to true if you want to dynamically recompute the global routes upon Interface notification events (up/down, or add/remove address)",
                    BooleanValue (false),
                    MakeBooleanAccessor (&Ipv4GlobalRouting::m_respondToInterfaceEvents),
                    MakeBooleanChecker ())
+    .AddAttribute ("IncrementalRouteUpdates",
+                   "When responding to a point-to-point link going down, rerun SPF only from the roots whose shortest paths used it and rewrite only the routing entries that changed",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_incrementalRouteUpdates),
+                   MakeBooleanChecker ())
     .AddAttribute ("ReverseOutputToInputDelay",
                    "Delay reversing output to input",
                    TimeValue (MicroSeconds (0)),
@@ -67,15 +151,95 @@ Ipv4GlobalRouting::GetTypeId (void)
                    BooleanValue (true),
                    MakeBooleanAccessor (&Ipv4GlobalRouting::m_allowReversal),
                    MakeBooleanChecker ())
+    .AddAttribute ("DdcMessages",
+                   "Run AEO locking, vnode updates and heartbeats as DDC messages over the links instead of calling into the neighbours",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_ddcMessages),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DdcMessageBatchDelay",
+                   "How long DDC message entries for a neighbour are collected before they are sent together",
+                   TimeValue (MicroSeconds (0)),
+                   MakeTimeAccessor (&Ipv4GlobalRouting::m_ddcBatchDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("DdcMessagePriority",
+                   "PriorityTag priority of DDC messages; probes flagged as control get the lowest one",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4GlobalRouting::m_ddcPriority),
+                   MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("BatchHeartbeats",
+                   "Start the heartbeats of all destinations of a node in one event, and deliver the unlocks "
+                   "and heartbeats for a neighbour in one event instead of one per destination",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_batchHeartbeats),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Vnodes",
+                   "Number of virtual nodes each destination cycles through; with more than two an AEO can "
+                   "start while neighbours still hold locks on an older vnode",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&Ipv4GlobalRouting::m_vnodes),
+                   MakeUintegerChecker<uint8_t> (2, MAX_VNODES))
+    .AddAttribute ("DdcMemoryUsage",
+                   "Bytes of DDC state this node holds",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4GlobalRouting::GetDdcMemoryUsage),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("DistanceRanking",
+                   "Rank the links of a destination by the distance of the neighbour behind them when their "
+                   "priorities are equal, following the route manager as links go down",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_distanceRanking),
+                   MakeBooleanChecker ())
+    .AddAttribute ("RecordStretch",
+                   "Keep the stretch of every unicast packet delivered to this node, see the Stretch trace source",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_recordStretch),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("DdcMessageTx",
+                     "A DDC message was sent: output interface, entries, bytes",
+                     MakeTraceSourceAccessor (&Ipv4GlobalRouting::m_ddcMessageTrace))
+    .AddTraceSource ("AeoDeferred",
+                     "An AEO that had to wait for locks went through: destination, time it waited",
+                     MakeTraceSourceAccessor (&Ipv4GlobalRouting::m_aeoDeferredTrace))
+    .AddTraceSource ("Stretch",
+                     "A unicast packet was delivered: source, hops taken, hops of the shortest path",
+                     MakeTraceSourceAccessor (&Ipv4GlobalRouting::m_stretchTrace))
+    .AddTraceSource ("NextHopBytes",
+                     "A packet was forwarded: output interface, bytes of the packet, bytes so far through that interface",
+                     MakeTraceSourceAccessor (&Ipv4GlobalRouting::m_nextHopBytesTrace))
   ;
   return tid;
 }
 
 Ipv4GlobalRouting::Ipv4GlobalRouting () 
   : m_randomEcmpRouting (false),
-    m_respondToInterfaceEvents (false)
+    m_flowEcmpRouting (false),
+    m_flowHashSeed (0),
+    m_respondToInterfaceEvents (false),
+    m_incrementalRouteUpdates (false),
+    m_ddcMessages (false),
+    m_ddcPriority (0),
+    m_nodeId (0),
+    m_heartbeatRound (0),
+    m_batchHeartbeats (false),
+    m_ddcMessagesSent (0),
+    m_ddcMessageBytesSent (0),
+    m_vnodes (2),
+    m_aeosDeferred (0),
+    m_reversalOrder (0),
+    m_reversalsSuppressed (0),
+    m_distanceRanking (false),
+    m_recordStretch (false),
+    m_initialTtl (0),
+    m_stretchPackets (0),
+    m_stretchSum (0),
+    m_stretchMax (0),
+    m_stateSaved (false)
 {
   NS_LOG_FUNCTION_NOARGS ();
+  for (int i = 0; i < MAX_VNODES; i++) {
+    m_toReverseEpoch[i] = 0;
+  }
 }
 
 Ipv4GlobalRouting::~Ipv4GlobalRouting ()
@@ -92,9 +256,10 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface);
   m_hostRoutes.push_back (route);
-  InitializeDestination(dest);
-  m_vnodeState[0].m_directions[dest][interface] = Out;
-  m_vnodeState[0].m_outputs[dest].push(PriorityInterface(m_priorities[dest][interface], interface));
+  IndexHostRoute (route);
+  DestinationState &state = GetDestination(dest);
+  state.m_links[interface].SetDirection(0, Out);
+  LinkSetAdd(GetLinkSet(state, 0, OutputLinks), state.m_links[interface].m_rank);
 }
 
 void 
@@ -105,9 +270,10 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, interface);
   m_hostRoutes.push_back (route);
-  InitializeDestination(dest);
-  m_vnodeState[0].m_directions[dest][interface] = Out;
-  m_vnodeState[0].m_outputs[dest].push(PriorityInterface(m_priorities[dest][interface], interface));
+  IndexHostRoute (route);
+  DestinationState &state = GetDestination(dest);
+  state.m_links[interface].SetDirection(0, Out);
+  LinkSetAdd(GetLinkSet(state, 0, OutputLinks), state.m_links[interface].m_rank);
 }
 
 void 
@@ -123,10 +289,11 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_networkRoutes.push_back (route);
+  IndexPrefixRoute (m_networkRouteIndex, route);
   if (networkMask == Ipv4Mask(0xffffffff)) {
-    InitializeDestination(network);
-    m_vnodeState[0].m_directions[network][interface] = Out;
-    m_vnodeState[0].m_outputs[network].push(PriorityInterface(m_priorities[network][interface], interface));
+    DestinationState &state = GetDestination(network);
+    state.m_links[interface].SetDirection(0, Out);
+    LinkSetAdd(GetLinkSet(state, 0, OutputLinks), state.m_links[interface].m_rank);
   }
 }
 
@@ -141,10 +308,11 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         networkMask,
                                                         interface);
   m_networkRoutes.push_back (route);
+  IndexPrefixRoute (m_networkRouteIndex, route);
   if (networkMask == Ipv4Mask(0xffffffff)) {
-    InitializeDestination(network);
-    m_vnodeState[0].m_directions[network][interface] = Out;
-    m_vnodeState[0].m_outputs[network].push(PriorityInterface(m_priorities[network][interface], interface));
+    DestinationState &state = GetDestination(network);
+    state.m_links[interface].SetDirection(0, Out);
+    LinkSetAdd(GetLinkSet(state, 0, OutputLinks), state.m_links[interface].m_rank);
   }
 }
 
@@ -161,6 +329,7 @@ Ipv4GlobalRouting::AddASExternalRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_ASexternalRoutes.push_back (route);
+  IndexPrefixRoute (m_externalRouteIndex, route);
 }
 
 uint32_t 
@@ -238,6 +407,7 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
           if (tmp  == index)
             {
               //NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_hostRoutes.size ());
+              UnindexHostRoute (*i);
               delete *i;
               m_hostRoutes.erase (i);
               //NS_LOG_LOGIC ("Done removing host route " << index << "; host route remaining size = " << m_hostRoutes.size ());
@@ -255,6 +425,7 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
       if (tmp == index)
         {
           //NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_networkRoutes.size ());
+          UnindexPrefixRoute (m_networkRouteIndex, *j);
           delete *j;
           m_networkRoutes.erase (j);
           //NS_LOG_LOGIC ("Done removing network route " << index << "; network route remaining size = " << m_networkRoutes.size ());
@@ -271,6 +442,7 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
       if (tmp == index)
         {
           //NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_ASexternalRoutes.size ());
+          UnindexPrefixRoute (m_externalRouteIndex, *k);
           delete *k;
           m_ASexternalRoutes.erase (k);
           //NS_LOG_LOGIC ("Done removing network route " << index << "; network route remaining size = " << m_networkRoutes.size ());
@@ -281,6 +453,55 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
   NS_ASSERT (false);
 }
 
+uint32_t
+Ipv4GlobalRouting::UpdateRoutes (const std::vector<Ipv4RoutingTableEntry> &hostRoutes,
+                                 const std::vector<Ipv4RoutingTableEntry> &networkRoutes,
+                                 const std::vector<Ipv4RoutingTableEntry> &externalRoutes)
+{
+  NS_LOG_FUNCTION (this << hostRoutes.size () << networkRoutes.size () << externalRoutes.size ());
+  uint32_t touched = 0;
+  touched += UpdateRouteList (HostRoute, hostRoutes);
+  touched += UpdateRouteList (NetworkRoute, networkRoutes);
+  touched += UpdateRouteList (ExternalRoute, externalRoutes);
+  return touched;
+}
+
+uint32_t
+Ipv4GlobalRouting::RemoveHostRoutesTo (Ipv4Address dest)
+{
+  NS_LOG_FUNCTION (this << dest);
+  HostRouteIndex::iterator it = m_hostRouteIndex.find (dest);
+  if (it == m_hostRouteIndex.end ())
+    {
+      return 0;
+    }
+  std::set<const Ipv4RoutingTableEntry *> routes;
+  for (NextHopGroup::iterator j = it->second.begin (); j != it->second.end (); j++)
+    {
+      routes.insert (j->m_entry);
+    }
+  DeleteRoutes (HostRoute, routes);
+  return routes.size ();
+}
+
+uint32_t
+Ipv4GlobalRouting::RemoveNetworkRoutesTo (Ipv4Address network, Ipv4Mask networkMask)
+{
+  NS_LOG_FUNCTION (this << network << networkMask);
+  PrefixIndex::iterator it = m_networkRouteIndex.m_groups.find (GetPrefixKey (network, networkMask));
+  if (it == m_networkRouteIndex.m_groups.end ())
+    {
+      return 0;
+    }
+  std::set<const Ipv4RoutingTableEntry *> routes;
+  for (NextHopGroup::iterator j = it->second.begin (); j != it->second.end (); j++)
+    {
+      routes.insert (j->m_entry);
+    }
+  DeleteRoutes (NetworkRoute, routes);
+  return routes.size ();
+}
+
 void
 Ipv4GlobalRouting::DoDispose (void)
 {
@@ -303,6 +524,31 @@ Ipv4GlobalRouting::DoDispose (void)
     {
       delete (*l);
     }
+  m_destinationIndex.clear ();
+  m_destinations.clear ();
+  m_aliases = 0;
+  m_pendingAeos.clear ();
+  m_reversalEvent.Cancel ();
+  m_reversals[ToOutput].clear ();
+  m_reversals[ToInput].clear ();
+  m_queuedReversals.clear ();
+  for (std::vector<EventId>::iterator i = m_ddcFlush.begin (); i != m_ddcFlush.end (); i++)
+    {
+      i->Cancel ();
+    }
+  m_ddcFlush.clear ();
+  m_ddcOutgoing.clear ();
+  for (std::vector<EventId>::iterator i = m_notificationEvents.begin (); i != m_notificationEvents.end (); i++)
+    {
+      i->Cancel ();
+    }
+  m_notificationEvents.clear ();
+  m_notifications.clear ();
+  m_linkRoutes.clear ();
+  m_localRoutes.clear ();
+  m_hostRouteIndex.clear ();
+  m_networkRouteIndex = PrefixTable ();
+  m_externalRouteIndex = PrefixTable ();
 
   Ipv4RoutingProtocol::DoDispose ();
 }
@@ -379,7 +625,8 @@ Ipv4GlobalRouting::DataplaneRouteOutput (
   // See if this is a unicast packet we have a route for.
   //
   NS_LOG_LOGIC ("Unicast destination- looking up");
-  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination (), oif);
+  uint32_t flowHash = m_flowEcmpRouting ? TagFlowHash (p, header) : 0;
+  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination (), oif, flowHash);
   if (rtentry)
     {
       sockerr = Socket::ERROR_NOTERROR;
@@ -446,6 +693,7 @@ Ipv4GlobalRouting::DataplaneRouteInput (
                 {
                   NS_LOG_LOGIC ("For me (destination " << addr << " match) on another interface " << header.GetDestination ());
                 }
+              RecordStretch (header);
               lcb (p, header, iif);
               return true;
             }
@@ -467,10 +715,12 @@ Ipv4GlobalRouting::DataplaneRouteInput (
     }
   // Next, try to find a route
   NS_LOG_LOGIC ("Unicast destination- looking up global route");
-  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination ());
+  uint32_t flowHash = m_flowEcmpRouting ? GetFlowHash (p, header) : 0;
+  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination (), 0, flowHash);
   if (rtentry != 0)
     {
       NS_LOG_LOGIC ("Found unicast destination- calling unicast callback");
+      NotifyNextHop (rtentry, p, header);
       ucb (rtentry, p, header);
       return true;
     }
@@ -516,14 +766,7 @@ Ipv4GlobalRouting::ControlplaneRouteOutput (
           Ipv4Address addr = iaddr.GetLocal ();
           if (addr.IsEqual (header.GetDestination ()))
             {
-              Ptr<Ipv4Route> route;
-              route = Create<Ipv4Route>();
-              route->SetDestination(header.GetDestination());
-              route->SetGateway(header.GetDestination());
-              Ptr<NetDevice> netdev = m_ipv4->GetNetDevice(0);
-              route->SetOutputDevice(netdev);
-              route->SetSource (m_ipv4->GetAddress (0, 0).GetLocal ());
-              return route;
+              return GetLocalRoute (j, i);
             }
         }
     }
@@ -531,7 +774,8 @@ Ipv4GlobalRouting::ControlplaneRouteOutput (
   // See if this is a unicast packet we have a route for.
   //
   Ptr<Ipv4Route> rtentry;
-  header.SetVnode(m_localVnode[header.GetDestination()]);
+  DestinationState *state = FindDestination(header.GetDestination());
+  header.SetVnode(state ? state->m_localVnode : 0);
   StandardReceive(header.GetDestination(), header, rtentry, sockerr, 0);
   NS_LOG_LOGIC ("Unicast destination- looking up");
   return rtentry;
@@ -591,6 +835,7 @@ Ipv4GlobalRouting::ControlplaneRouteInput (
                 {
                   NS_LOG_LOGIC ("For me (destination " << addr << " match) on another interface " << header.GetDestination ());
                 }
+              RecordStretch (header);
               lcb (p, header, iif);
               return true;
             }
@@ -616,20 +861,28 @@ Ipv4GlobalRouting::ControlplaneRouteInput (
   Socket::SocketErrno error;
   Ptr<Ipv4Route> route = 0;
   NS_LOG_LOGIC ("Received for vnode = " << (uint32_t)vnode);
-  if (m_vnodeState[vnode].m_directions[destination][iif] == In) {
+  DestinationState *state = FindDestination(destination);
+  if (state == 0) {
+    NS_LOG_LOGIC ("No DDC state for " << destination);
+    ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+    return false;
+  }
+  const LinkState &in = state->m_links[iif];
+  if (in.GetDirection(vnode) == In) {
     // This assertion is now approved
-    if (m_vnodeState[vnode].m_remoteSeq[destination][iif] != header.GetSeq ()) {
+    if (in.GetRemoteSeq(vnode) != header.GetSeq ()) {
       NS_LOG_WARN("DDC - remoteSeq is not the same as header.GetSeq () " << vnode << 
                     " " << 
                     destination << 
                     " " << iif 
                     << " " << header.GetSeq()
-                    << " expected " << m_vnodeState[vnode].m_remoteSeq[destination][iif]);
+                    << " expected " << (uint32_t)in.GetRemoteSeq(vnode));
     }
-    NS_ASSERT(m_vnodeState[vnode].m_remoteSeq[destination][iif] == header.GetSeq());
+    NS_ASSERT(in.GetRemoteSeq(vnode) == header.GetSeq());
     NS_LOG_LOGIC ("Received along an input port");
     StandardReceive(destination, header, route, error, iif);
     if (route != 0) {
+      NotifyNextHop(route, p, header);
       ucb(route, p, header);
       return true;
     }
@@ -639,13 +892,14 @@ Ipv4GlobalRouting::ControlplaneRouteInput (
     }
   }
   else {
-    if (m_vnodeState[vnode].m_directions[destination][iif] == Out) {
+    if (in.GetDirection(vnode) == Out) {
       NS_LOG_LOGIC ("Received on output port");
-      if (header.GetSeq() == m_vnodeState[vnode].m_remoteSeq[destination][iif]) {
+      if (header.GetSeq() == in.GetRemoteSeq(vnode)) {
         // Send packet back (maybe)
-        NS_LOG_LOGIC ("Bouncing back, header seq = "<<header.GetSeq() << " Remote = " << (uint32_t)(m_vnodeState[vnode].m_remoteSeq[destination][iif])
-                      << " local = " << (uint32_t)(m_vnodeState[vnode].m_localSeq[destination][iif]));
-        CreateRoutingEntry(vnode, iif, destination, header, route);
+        NS_LOG_LOGIC ("Bouncing back, header seq = "<<header.GetSeq() << " Remote = " << (uint32_t)in.GetRemoteSeq(vnode)
+                      << " local = " << (uint32_t)in.GetLocalSeq(vnode));
+        CreateRoutingEntry(vnode, iif, *state, header, route);
+        NotifyNextHop(route, p, header);
         ucb(route, p, header);
         return true;
       }
@@ -655,13 +909,14 @@ Ipv4GlobalRouting::ControlplaneRouteInput (
         // ReverseOutputToInput(vnode, destination, iif);
         NS_LOG_LOGIC("Reversing output to input eventually");
         if (!m_reverseOutputToInputDelay.IsZero()) {
-          Simulator::Schedule(m_reverseOutputToInputDelay, &Ipv4GlobalRouting::ReverseOutputToInput, this, vnode, destination, iif);
+          QueueReversal(ToInput, vnode, state->m_address, iif);
         }
         else {
           ReverseOutputToInput(vnode, destination, iif);
         }
         StandardReceive(destination, header, route, error, iif);
         if (route != 0) {
+          NotifyNextHop(route, p, header);
           ucb(route, p, header);
           return true;
         }
@@ -675,8 +930,8 @@ Ipv4GlobalRouting::ControlplaneRouteInput (
     else {
       ecb (p, header, Socket::ERROR_NOROUTETOHOST);
       return false;
-      //m_vnodeState[vnode].m_directions[destination][iif] = In;
-      //m_vnodeState[vnode].m_remoteSeq[destination][iif] = header.GetSeq();
+      //in.SetDirection(vnode, In);
+      //in.SetRemoteSeq(vnode, header.GetSeq());
       //NS_LOG_LOGIC ("Received on an uncategorized port " << iif << " for destination " << destination << " setting
               //remote seq to " << header.GetSeq() << " for VNODE " << vnode);
       //StandardReceive(destination, header, route, error, iif);
@@ -746,463 +1001,1175 @@ Ipv4GlobalRouting::RouteInput (
 }
 
 Ptr<Ipv4Route>
-Ipv4GlobalRouting::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
+Ipv4GlobalRouting::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif, uint32_t flowHash)
 {
   NS_LOG_FUNCTION_NOARGS ();
   NS_LOG_LOGIC ("Looking for route for destination " << dest);
-  Ptr<Ipv4Route> rtentry = 0;
-  // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4RoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
+  bool ecmp = m_randomEcmpRouting || m_flowEcmpRouting;
+  NextHop *nextHop = 0;
+  HostRouteIndex::iterator host = m_hostRouteIndex.find (dest);
+  if (host != m_hostRouteIndex.end ())
+    {
+      nextHop = SelectNextHop (host->second, oif, ecmp, flowHash);
+    }
+  if (nextHop == 0) // if no host route is found
+    {
+      nextHop = LookupPrefix (m_networkRouteIndex, dest, oif, ecmp, flowHash);
+    }
+  if (nextHop == 0)  // consider external if no host/network found
+    {
+      nextHop = LookupPrefix (m_externalRouteIndex, dest, oif, false, 0);
+    }
+  if (nextHop == 0)
+    {
+      return 0;
+    }
+  return GetEntryRoute (*nextHop);
+}
 
-  NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
-  for (HostRoutesCI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i++) 
+// @apanda
+Ipv4GlobalRouting::NextHop *
+Ipv4GlobalRouting::LookupPrefix (PrefixTable &table, Ipv4Address dest, Ptr<NetDevice> oif, bool ecmp, uint32_t flowHash)
+{
+  uint64_t lengths = table.m_lengths;
+  while (lengths != 0)
     {
-      NS_ASSERT ((*i)->IsHost ());
-      if ((*i)->GetDest ().IsEqual (dest)) 
+      uint32_t length = 63 - __builtin_clzll (lengths);
+      lengths &= ~(1ULL << length);
+      uint32_t network = length == 0 ? 0 : dest.Get () & (0xffffffffU << (32 - length));
+      PrefixIndex::iterator it = table.m_groups.find ((static_cast<uint64_t> (network) << 6) | length);
+      if (it != table.m_groups.end ())
         {
-          if (oif != 0)
+          NextHop *nextHop = SelectNextHop (it->second, oif, ecmp, flowHash);
+          if (nextHop != 0)
             {
-              if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
+              return nextHop;
             }
-          allRoutes.push_back (*i);
-          NS_LOG_LOGIC (allRoutes.size () << "Found global host route" << *i); 
         }
     }
-  if (allRoutes.size () == 0) // if no host route is found
+  return 0;
+}
+
+// @apanda
+Ipv4GlobalRouting::NextHop *
+Ipv4GlobalRouting::SelectNextHop (NextHopGroup &group, Ptr<NetDevice> oif, bool ecmp, uint32_t flowHash)
+{
+  uint32_t candidates = group.size ();
+  if (oif != 0)
     {
-      NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end (); 
-           j++) 
+      candidates = 0;
+      for (NextHopGroup::const_iterator it = group.begin (); it != group.end (); it++)
         {
-          Ipv4Mask mask = (*j)->GetDestNetworkMask ();
-          Ipv4Address entry = (*j)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry)) 
+          if (oif == m_ipv4->GetNetDevice (it->m_entry->GetInterface ()))
             {
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*j)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*j);
-              NS_LOG_LOGIC (allRoutes.size () << "Found global network route" << *j);
+              candidates++;
             }
         }
     }
-  if (allRoutes.size () == 0)  // consider external if no host/network found
+  if (candidates == 0)
     {
-      for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
-           k != m_ASexternalRoutes.end ();
-           k++)
-        {
-          Ipv4Mask mask = (*k)->GetDestNetworkMask ();
-          Ipv4Address entry = (*k)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry))
-            {
-              NS_LOG_LOGIC ("Found external route" << *k);
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*k)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*k);
-              break;
-            }
-        }
+      NS_LOG_LOGIC ("No route on requested interface");
+      return 0;
+    }
+  // pick up one of the routes by flow hash or uniformly at random
+  // if ECMP routing is enabled, or always select the first route
+  // consistently if ECMP routing is disabled
+  uint32_t selectIndex = 0;
+  if (ecmp && m_flowEcmpRouting)
+    {
+      selectIndex = flowHash % candidates;
+    }
+  else if (ecmp)
+    {
+      selectIndex = m_rand.GetInteger (0, candidates - 1);
     }
-  if (allRoutes.size () > 0 ) // if route(s) is found
+  for (NextHopGroup::iterator it = group.begin (); it != group.end (); it++)
     {
-      // pick up one of the routes uniformly at random if random
-      // ECMP routing is enabled, or always select the first route
-      // consistently if random ECMP routing is disabled
-      uint32_t selectIndex;
-      if (m_randomEcmpRouting)
+      if (oif != 0 && oif != m_ipv4->GetNetDevice (it->m_entry->GetInterface ()))
         {
-          selectIndex = m_rand.GetInteger (0, allRoutes.size ()-1);
+          continue;
         }
-      else 
+      if (selectIndex == 0)
         {
-          selectIndex = 0;
+          NS_LOG_LOGIC ("Found global route " << it->m_entry);
+          return &*it;
         }
-      Ipv4RoutingTableEntry* route = allRoutes.at (selectIndex); 
-      // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
-      rtentry->SetDestination (route->GetDest ());
-      // XXX handle multi-address case
-      rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
-      rtentry->SetGateway (route->GetGateway ());
-      uint32_t interfaceIdx = route->GetInterface ();
-      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
-      return rtentry;
-    }
-  else 
-    {
-      return 0;
+      selectIndex--;
     }
+  NS_ASSERT (false);
+  return 0;
 }
 
-void 
-Ipv4GlobalRouting::NotifyInterfaceUp (uint32_t i)
+// @apanda
+uint32_t
+Ipv4GlobalRouting::GetFlowHash (Ptr<const Packet> p, const Ipv4Header &header)
 {
-  //NS_LOG_FUNCTION (this << i);
-  if (Simulator::Now ().GetSeconds() > 0) {
-    for (InterfacePriorities::iterator it = m_priorities.begin();
-         it != m_priorities.end();
-         it++) {
-        Ipv4Address dest = (*it).first;
-        uint32_t vnode = m_localVnode[dest];
-        m_vnodeState[vnode].m_directions[dest][i] = Unknown;
-        m_vnodeState[vnode].m_localSeq[dest][i] = 0;
-        m_vnodeState[vnode].m_remoteSeq[dest][i] = 0;
-        NS_LOG_LOGIC ("Interface Up " << i << " for destination " << dest << " setting remote seq to " << 0 << " for VNODE " << vnode);
-        m_ttl[dest][i] = 0;
-        m_vnodeState[vnode].m_inputs[dest].push_back(i);
-        m_vnodeState[vnode].m_to_reverse[dest].push_back(i);
+  FlowHashTag tag;
+  if (!p->PeekPacketTag (tag))
+    {
+      // A packet from a node that did not tag it
+      tag.SetHash (FlowHashTag::Hash (p, header));
+      p->AddPacketTag (tag);
     }
-  }
-  //if (Simulator::Now ().GetSeconds () > 0)  // avoid startup events
-    //{
-      //std::cerr << "Recomputing routes now\n";
-      //GlobalRouteManager::DeleteGlobalRoutes ();
-      //GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      //GlobalRouteManager::InitializeRoutes ();
-    //}
+  return FlowHashTag::Mix (tag.GetHash () ^ m_flowHashSeed);
 }
 
-void 
-Ipv4GlobalRouting::NotifyInterfaceDown (uint32_t i)
+// @apanda
+uint32_t
+Ipv4GlobalRouting::TagFlowHash (Ptr<Packet> p, const Ipv4Header &header)
 {
-  NS_LOG_FUNCTION (this << i);
-  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
+  if (p == 0 || header.GetSource () == Ipv4Address::GetAny ())
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      // A socket asking for the source address of a packet that has no
+      // transport header yet; Ipv4L3Protocol::Send looks the route up
+      // again with the complete header
+      return FlowHashTag::Mix (header.GetDestination ().Get () ^ m_flowHashSeed);
     }
+  // Any tag on an originated packet belongs to an earlier hop, such as the
+  // request an echo reply carries back
+  FlowHashTag tag;
+  p->RemovePacketTag (tag);
+  tag.SetHash (FlowHashTag::Hash (p, header));
+  p->AddPacketTag (tag);
+  return FlowHashTag::Mix (tag.GetHash () ^ m_flowHashSeed);
 }
 
-void 
-Ipv4GlobalRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+// @apanda
+void
+Ipv4GlobalRouting::NotifyNextHop (Ptr<Ipv4Route> route, Ptr<const Packet> p, const Ipv4Header &header)
 {
-  //NS_LOG_FUNCTION (this << interface << address);
-  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
+  int32_t interface = m_ipv4->GetInterfaceForDevice (route->GetOutputDevice ());
+  NS_ASSERT (interface >= 0);
+  if (m_nextHopBytes.size () <= static_cast<uint32_t> (interface))
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      m_nextHopBytes.resize (m_ipv4->GetNInterfaces (), 0);
     }
+  uint32_t bytes = p->GetSize () + header.GetSerializedSize ();
+  m_nextHopBytes[interface] += bytes;
+  m_nextHopBytesTrace (interface, bytes, m_nextHopBytes[interface]);
 }
 
-void 
-Ipv4GlobalRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+// @apanda
+uint64_t
+Ipv4GlobalRouting::GetNextHopBytes (uint32_t interface) const
 {
-  //NS_LOG_FUNCTION (this << interface << address);
-  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
-    {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
-    }
+  return interface < m_nextHopBytes.size () ? m_nextHopBytes[interface] : 0;
 }
 
-void 
-Ipv4GlobalRouting::SetIpv4 (Ptr<Ipv4> ipv4)
+// @apanda
+void
+Ipv4GlobalRouting::SetDestinationAliases (Ptr<const Ipv4DestinationAliases> aliases)
 {
-  //NS_LOG_FUNCTION (this << ipv4);
-  NS_ASSERT (m_ipv4 == 0 && ipv4 != 0);
-  m_ipv4 = ipv4;
+  m_aliases = aliases;
 }
 
 // @apanda
-bool
-Ipv4GlobalRouting::PrimitiveAEO (Ipv4Address dest)
+uint32_t
+Ipv4GlobalRouting::GetNDestinations (void) const
 {
-  //NS_LOG_FUNCTION (this << dest);
-  m_aeoRequested[dest] = true;
-  bool success = LocalLock(dest);
-  //NS_LOG_LOGIC("Acquiring lock " << success);
-  // NS_ASSERT_MSG(success, "Could not acquire lock");
-  if (success) {
-    m_aeoRequested[dest] = false;
-    uint8_t newVnode = (m_localVnode[dest] + 1) % 2;
-    ClearVnode(newVnode, dest);
-    for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); i++) {
-      if (m_vnodeState[newVnode].m_directions[dest][i] != Out) { 
-        if (m_vnodeState[newVnode].m_directions[dest][i] != Dead) {  
-          m_vnodeState[newVnode].m_outputs[dest].push(PriorityInterface(m_priorities[dest][i], i));
-          m_vnodeState[newVnode].m_directions[dest][i] = Out;
-          m_vnodeState[newVnode].m_localSeq[dest][i] = 0;
-          m_vnodeState[newVnode].m_remoteSeq[dest][i] = 0;
-          NS_LOG_LOGIC ("Primitive AEO " << i << " for destination " << dest << " setting remote seq to " << 0 << " for VNODE " << newVnode);
-          // Reset TTL during AEO operation, this makes sense since AEO is
-          // primarily a control plane primitive, and is called in order, and
-          // sets true directions
-          m_ttl[dest][i] = 0;
-          LocalSetRemoteVnode(dest,  i, newVnode);
-        }
-      }
-    }
-    m_localVnode[dest] = newVnode;
-    LocalUnlock(dest);
-    return true;
-  }
-  return false;
+  return m_destinations.size ();
 }
 
 // @apanda
 void
-Ipv4GlobalRouting::SetInterfacePriority (
-    Ipv4Address dest,
-    uint32_t interface,
-    uint32_t priority) {
-  //NS_LOG_LOGIC (this << "setting interface " << interface << " priority to " << priority);
-  m_priorities[dest][interface] = priority;
-  m_vnodeState[0].m_prioritized_links[dest].push(PriorityInterface(priority, interface));
+Ipv4GlobalRouting::ReserveDestinations (uint32_t n)
+{
+  m_destinations.reserve (n);
+  m_destinationIndex.resize (n);
 }
 
 // @apanda
-bool
-Ipv4GlobalRouting::FindOutputPort (uint8_t vnode, Ipv4Address addr, uint32_t &link, uint32_t iif)
+uint64_t
+Ipv4GlobalRouting::GetDdcMemoryUsage (void) const
 {
-  //NS_LOG_FUNCTION (this << addr);
-  if (m_vnodeState[vnode].m_outputs[addr].empty()) {
-      NS_LOG_LOGIC("Outputs empty");
-      return false;
-  }
-  do {
-    PriorityInterface interface = m_vnodeState[vnode].m_outputs[addr].top();
-    link = interface.second;
-    if (link == iif && m_vnodeState[vnode].m_outputs[addr].size() > 1) {
-      m_vnodeState[vnode].m_outputs[addr].pop();
-      const PriorityInterface iface2 = m_vnodeState[vnode].m_outputs[addr].top();
-      m_vnodeState[vnode].m_outputs[addr].push(interface);
-      interface = iface2;
-    }
-    if (m_vnodeState[vnode].m_directions[addr][link] == Out && m_ipv4->GetNetDevice(link)->IsLinkUp()) {
-      NS_LOG_LOGIC("Returning output link " << link << "(priority = " << interface.first << ")");
-      return true;
+  uint64_t bytes = m_destinations.capacity () * sizeof (DestinationState);
+  for (std::vector<DestinationState>::const_iterator it = m_destinations.begin (); it != m_destinations.end (); it++)
+    {
+      bytes += it->m_reverseBefore.capacity () * sizeof (uint32_t);
+      bytes += it->m_reverseAfter.capacity () * sizeof (uint32_t);
+      bytes += it->m_links.capacity () * sizeof (LinkState);
+      bytes += it->m_linkAtRank.capacity () * sizeof (uint16_t);
+      bytes += it->m_linkSets.capacity () * sizeof (uint64_t);
     }
-    else {
-      m_vnodeState[vnode].m_outputs[addr].pop();
+  // One pointer per bucket, and a node with a next pointer per entry
+  bytes += m_destinationIndex.bucket_count () * sizeof (void *);
+  bytes += m_destinationIndex.size () * (sizeof (DestinationIndex::value_type) + sizeof (void *));
+  return bytes;
+}
+
+// @apanda
+std::list<Ipv4RoutingTableEntry *> &
+Ipv4GlobalRouting::GetRouteList (RouteKind kind)
+{
+  switch (kind)
+    {
+    case HostRoute:
+      return m_hostRoutes;
+    case NetworkRoute:
+      return m_networkRoutes;
+    default:
+      return m_ASexternalRoutes;
     }
-  } while (!m_vnodeState[vnode].m_outputs[addr].empty());
-  NS_LOG_LOGIC("Found no output");
-  return false; 
 }
 
 // @apanda
-bool
-Ipv4GlobalRouting::FindHighPriorityLink(uint8_t vnode, Ipv4Address addr, uint32_t &link)
+uint32_t
+Ipv4GlobalRouting::UpdateRouteList (RouteKind kind, const std::vector<Ipv4RoutingTableEntry> &routes)
 {
-  //NS_LOG_FUNCTION (this << addr);
-  if (m_vnodeState[vnode].m_prioritized_links[addr].empty()) {
-      NS_LOG_LOGIC("No links of any sort");
-      return false;
-  }
-  do {
-    const PriorityInterface interface = m_vnodeState[vnode].m_prioritized_links[addr].top();
-    link = interface.second;
-    if (m_ipv4->GetNetDevice(link)->IsLinkUp()) {
-      NS_LOG_LOGIC("Returning output link " << link << "(priority = " << interface.first << ")");
-      return true;
+  // Next hops each destination prefix still lacks
+  typedef std::multiset<std::pair<Ipv4Address, uint32_t> > NextHops;
+  std::map<uint64_t, NextHops> missing;
+  for (std::vector<Ipv4RoutingTableEntry>::const_iterator i = routes.begin (); i != routes.end (); i++)
+    {
+      missing[GetPrefixKey (i->GetDestNetwork (), i->GetDestNetworkMask ())].insert (
+        std::make_pair (i->GetGateway (), i->GetInterface ()));
     }
-    else {
-      m_vnodeState[vnode].m_prioritized_links[addr].pop();
+
+  // Installed entries that are still wanted stay where they are, the rest goes
+  std::set<const Ipv4RoutingTableEntry *> stale;
+  std::list<Ipv4RoutingTableEntry *> &list = GetRouteList (kind);
+  for (HostRoutesCI i = list.begin (); i != list.end (); i++)
+    {
+      std::map<uint64_t, NextHops>::iterator group =
+        missing.find (GetPrefixKey ((*i)->GetDestNetwork (), (*i)->GetDestNetworkMask ()));
+      NextHops::iterator nextHop;
+      if (group != missing.end () &&
+          (nextHop = group->second.find (std::make_pair ((*i)->GetGateway (), (*i)->GetInterface ()))) != group->second.end ())
+        {
+          group->second.erase (nextHop);
+          continue;
+        }
+      stale.insert (*i);
     }
-  } while (!m_vnodeState[vnode].m_prioritized_links[addr].empty());
-  NS_LOG_LOGIC("Found no output");
-  return false; 
+  uint32_t touched = stale.size ();
+  DeleteRoutes (kind, stale);
+
+  for (std::vector<Ipv4RoutingTableEntry>::const_iterator i = routes.begin (); i != routes.end (); i++)
+    {
+      NextHops &group = missing[GetPrefixKey (i->GetDestNetwork (), i->GetDestNetworkMask ())];
+      NextHops::iterator nextHop = group.find (std::make_pair (i->GetGateway (), i->GetInterface ()));
+      if (nextHop != group.end ())
+        {
+          group.erase (nextHop);
+          AddRoute (kind, *i);
+          touched++;
+        }
+    }
+  return touched;
 }
 
 // @apanda
 void
-Ipv4GlobalRouting::InitializeDestination (Ipv4Address dest)
+Ipv4GlobalRouting::AddRoute (RouteKind kind, const Ipv4RoutingTableEntry &route)
 {
-  //NS_LOG_FUNCTION (this << dest);
-  //NS_LOG_LOGIC("Initializing stuff for dest = " << dest << " at node " << m_ipv4->GetNetDevice(0)->GetNode()->GetId());
-  //NS_LOG_LOGIC("Number of interfaces = " << m_ipv4->GetNInterfaces());
-  if (m_vnodeState[0].m_directions.find(dest) != m_vnodeState[0].m_directions.end()) {
-  }
-  else {
-    m_aeoRequested.insert(AeoRequests::value_type(dest, false));
-    m_locks.insert(LockStatus::value_type(dest, std::vector<bool>(m_ipv4->GetNInterfaces(), false)));
-    m_held.insert(LockHeld::value_type(dest, false));
-    m_lockCounts.insert(LockCounts::value_type(dest, 0));
-    m_localVnode.insert(VnodeNumbers::value_type(dest, 0));
-    m_remoteVnode.insert(RemoteVnodeNumbers::value_type(dest, std::vector<uint8_t>(m_ipv4->GetNInterfaces(), 0)));
-    m_priorities.insert(InterfacePriorities::value_type(dest, std::vector<uint32_t>(m_ipv4->GetNInterfaces(), 0)));  
-    m_ttl.insert(InterfacePriorities::value_type(dest, std::vector<uint32_t>(m_ipv4->GetNInterfaces(), 0)));  
-    m_heartbeatSequence.insert(CurrentSequence::value_type(dest, 0));
-    m_heartbeatState.insert(HeartbeatState::value_type(dest, std::vector<bool>(m_ipv4->GetNInterfaces(), false)));
-    for (int i = 0; i < 2; i++) {
-      m_vnodeState[i].m_directions.insert(InterfaceDirection::value_type(dest, std::vector<LinkDirection>(m_ipv4->GetNInterfaces(), Unknown)));
-      m_vnodeState[i].m_inputs.insert(DestinationListInterfaceQueues::value_type(dest, std::list<uint32_t>()));
-      m_vnodeState[i].m_outputs.insert(DestinationPriorityInterfaceQueues::value_type(dest, InterfaceQueue())); 
-      m_vnodeState[i].m_localSeq.insert(SequenceNumbers::value_type(dest, std::vector<uint8_t>(m_ipv4->GetNInterfaces(), 0)));
-      m_vnodeState[i].m_remoteSeq.insert(SequenceNumbers::value_type(dest, std::vector<uint8_t>(m_ipv4->GetNInterfaces(), 0)));
-      m_vnodeState[i].m_to_reverse.insert(DestinationListInterfaceQueues::value_type(dest, std::list<uint32_t>()));
-      m_vnodeState[i].m_prioritized_links.insert(DestinationPriorityInterfaceQueues::value_type(dest, InterfaceQueue())); 
+  switch (kind)
+    {
+    case HostRoute:
+      if (route.IsGateway ())
+        {
+          AddHostRouteTo (route.GetDest (), route.GetGateway (), route.GetInterface ());
+        }
+      else
+        {
+          AddHostRouteTo (route.GetDest (), route.GetInterface ());
+        }
+      break;
+    case NetworkRoute:
+      if (route.IsGateway ())
+        {
+          AddNetworkRouteTo (route.GetDestNetwork (), route.GetDestNetworkMask (),
+                             route.GetGateway (), route.GetInterface ());
+        }
+      else
+        {
+          AddNetworkRouteTo (route.GetDestNetwork (), route.GetDestNetworkMask (), route.GetInterface ());
+        }
+      break;
+    default:
+      AddASExternalRouteTo (route.GetDestNetwork (), route.GetDestNetworkMask (),
+                            route.GetGateway (), route.GetInterface ());
+      break;
     }
-  }
 }
 
 // @apanda
-void 
-Ipv4GlobalRouting::ReverseInputToOutput (uint8_t vnode, Ipv4Address addr, uint32_t link) 
+void
+Ipv4GlobalRouting::DeleteRoutes (RouteKind kind, const std::set<const Ipv4RoutingTableEntry *> &routes)
 {
-  if (m_vnodeState[vnode].m_directions[addr][link] != In) {
-    return;
-  }
-  //NS_LOG_FUNCTION (this << vnode << addr << link);
-  m_reversalCallback(link, addr);
-  m_ttl[addr][link]++;
-  m_vnodeState[vnode].m_directions[addr][link] = Out;
-  m_vnodeState[vnode].m_inputs[addr].remove(link);
-  m_vnodeState[vnode].m_outputs[addr].push(PriorityInterface(m_priorities[addr][link], link));
-  m_vnodeState[vnode].m_localSeq[addr][link] = ((m_vnodeState[vnode].m_localSeq[addr][link] + 1) & 0x1);
+  if (routes.empty ())
+    {
+      return;
+    }
+  std::list<Ipv4RoutingTableEntry *> &list = GetRouteList (kind);
+  for (HostRoutesI i = list.begin (); i != list.end (); )
+    {
+      if (routes.find (*i) == routes.end ())
+        {
+          i++;
+          continue;
+        }
+      if (kind == HostRoute)
+        {
+          UnindexHostRoute (*i);
+        }
+      else
+        {
+          UnindexPrefixRoute (kind == NetworkRoute ? m_networkRouteIndex : m_externalRouteIndex, *i);
+        }
+      delete *i;
+      i = list.erase (i);
+    }
 }
 
 // @apanda
-void 
-Ipv4GlobalRouting::ReverseOutputToInput (uint8_t vnode, Ipv4Address addr, uint32_t link) 
+uint64_t
+Ipv4GlobalRouting::GetPrefixKey (Ipv4Address network, Ipv4Mask mask)
 {
-  if (m_vnodeState[vnode].m_directions[addr][link] != Out) {
-    return;
-  }
-  NS_ASSERT(m_vnodeState[vnode].m_directions[addr][link] == Out);
-  NS_LOG_FUNCTION (this << vnode << addr << link);
-  m_reversalCallback(link, addr);
-  m_ttl[addr][link]++;
-  m_vnodeState[vnode].m_directions[addr][link] = In;
-  m_vnodeState[vnode].m_inputs[addr].push_front(link);
-  m_vnodeState[vnode].m_remoteSeq[addr][link] = ((m_vnodeState[vnode].m_remoteSeq[addr][link] + 1) & 0x1);
-  NS_LOG_LOGIC ("Reverse Out to In " << link << " for destination " << addr<< " setting remote seq to " << m_vnodeState[vnode].m_remoteSeq[addr][link] << " for VNODE " << vnode);
+  return (static_cast<uint64_t> (network.CombineMask (mask).Get ()) << 6) | mask.GetPrefixLength ();
 }
 
 // @apanda
 void
-Ipv4GlobalRouting::SendOnOutlink (uint8_t vnode, Ipv4Address addr, Ipv4Header& header, uint32_t link)
+Ipv4GlobalRouting::IndexHostRoute (Ipv4RoutingTableEntry *route)
 {
-  NS_LOG_FUNCTION (this << addr);
-  //NS_LOG_LOGIC("Setting sequence number to " << (uint32_t)m_vnodeState[vnode].m_localSeq[addr][link]);
-  header.SetSeq(m_vnodeState[vnode].m_localSeq[addr][link]);
-  //NS_LOG_LOGIC("Sequence number is " << header.GetSeq());
-  //NS_LOG_LOGIC("Setting vnode number to " << (uint32_t)m_remoteVnode[addr][link]);
-  header.SetVnode(m_remoteVnode[addr][link]);
+  NextHop nextHop;
+  nextHop.m_entry = route;
+  m_hostRouteIndex[route->GetDest ()].push_back (nextHop);
 }
 
 // @apanda
 void
-Ipv4GlobalRouting::CreateRoutingEntry (uint8_t vnode, uint32_t link, Ipv4Address addr, Ipv4Header& header, Ptr<Ipv4Route> &route)
-{
-  SendOnOutlink(vnode, addr, header, link);
-  route = Create<Ipv4Route>();
-  route->SetDestination(header.GetDestination());
-  route->SetGateway(header.GetDestination());
-  Ptr<NetDevice> netdev = m_ipv4->GetNetDevice(link);
-  route->SetOutputDevice(netdev);
-  route->SetSource (m_ipv4->GetAddress (link, 0).GetLocal ());
+Ipv4GlobalRouting::IndexPrefixRoute (PrefixTable &table, Ipv4RoutingTableEntry *route)
+{
+  Ipv4Mask mask = route->GetDestNetworkMask ();
+  uint64_t length = mask.GetPrefixLength ();
+  uint64_t key = GetPrefixKey (route->GetDestNetwork (), mask);
+  NextHop nextHop;
+  nextHop.m_entry = route;
+  NextHopGroup &group = table.m_groups[key];
+  if (group.empty ())
+    {
+      table.m_groupsOfLength[length]++;
+      table.m_lengths |= 1ULL << length;
+    }
+  group.push_back (nextHop);
 }
 
 // @apanda
 void
-Ipv4GlobalRouting::StandardReceive (Ipv4Address addr, Ipv4Header& header, 
-                                Ptr<Ipv4Route> &route, Socket::SocketErrno &error, uint32_t iif)
+Ipv4GlobalRouting::UnindexHostRoute (Ipv4RoutingTableEntry *route)
 {
-  NS_LOG_FUNCTION (this << addr);
-  route = 0;
-  uint32_t link;
-  uint8_t vnode = header.GetVnode();
-  do {
-    if (FindOutputPort(vnode, addr, link, iif)) {
-      NS_LOG_LOGIC ("Choosing to use output port " << link);
-      CreateRoutingEntry(vnode, link, addr, header, route);
+  HostRouteIndex::iterator it = m_hostRouteIndex.find (route->GetDest ());
+  NS_ASSERT (it != m_hostRouteIndex.end ());
+  NextHopGroup &group = it->second;
+  for (NextHopGroup::iterator j = group.begin (); j != group.end (); j++)
+    {
+      if (j->m_entry == route)
+        {
+          group.erase (j);
+          break;
+        }
+    }
+  if (group.empty ())
+    {
+      m_hostRouteIndex.erase (it);
+    }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::UnindexPrefixRoute (PrefixTable &table, Ipv4RoutingTableEntry *route)
+{
+  Ipv4Mask mask = route->GetDestNetworkMask ();
+  uint64_t length = mask.GetPrefixLength ();
+  uint64_t key = GetPrefixKey (route->GetDestNetwork (), mask);
+  PrefixIndex::iterator it = table.m_groups.find (key);
+  NS_ASSERT (it != table.m_groups.end ());
+  NextHopGroup &group = it->second;
+  for (NextHopGroup::iterator j = group.begin (); j != group.end (); j++)
+    {
+      if (j->m_entry == route)
+        {
+          group.erase (j);
+          break;
+        }
+    }
+  if (!group.empty ())
+    {
       return;
     }
-    if (m_allowReversal) {
-      NS_LOG_LOGIC ("Reversing " << addr);
-      ScheduleReversals(vnode, addr);
-      
-      if (m_vnodeState[vnode].m_outputs[addr].empty()) {
-        NS_LOG_LOGIC ("Failed to find a link, so just using first high priority link " << addr);
-        if (FindHighPriorityLink(vnode, addr, link)) {
-          CreateRoutingEntry(vnode, link, addr, header, route);
-          return;
+  table.m_groups.erase (it);
+  // Keep the length bit only while another prefix of that length remains
+  if (--table.m_groupsOfLength[length] == 0)
+    {
+      table.m_lengths &= ~(1ULL << length);
+    }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::ClearEntryRoutes (void)
+{
+  for (HostRouteIndex::iterator it = m_hostRouteIndex.begin (); it != m_hostRouteIndex.end (); it++)
+    {
+      for (NextHopGroup::iterator j = it->second.begin (); j != it->second.end (); j++)
+        {
+          j->m_route = 0;
         }
-        else {
-          error = Socket::ERROR_NOROUTETOHOST;
-          NS_LOG_LOGIC("No path to " << addr);
-          return;
+    }
+  PrefixTable *tables[] = { &m_networkRouteIndex, &m_externalRouteIndex };
+  for (uint32_t t = 0; t < 2; t++)
+    {
+      for (PrefixIndex::iterator it = tables[t]->m_groups.begin (); it != tables[t]->m_groups.end (); it++)
+        {
+          for (NextHopGroup::iterator j = it->second.begin (); j != it->second.end (); j++)
+            {
+              j->m_route = 0;
+            }
         }
+    }
+}
+
+void 
+Ipv4GlobalRouting::NotifyInterfaceUp (uint32_t i)
+{
+  //NS_LOG_FUNCTION (this << i);
+  UpdateLinkState(i);
+  InvalidateRoutes(i);
+  if (Simulator::Now ().GetSeconds() > 0) {
+    for (std::vector<DestinationState>::iterator it = m_destinations.begin();
+         it != m_destinations.end();
+         it++) {
+        DestinationState &state = *it;
+        uint8_t vnode = state.m_localVnode;
+        LinkState &link = state.m_links[i];
+        link.SetDirection(vnode, Unknown);
+        link.SetLocalSeq(vnode, 0);
+        link.SetRemoteSeq(vnode, 0);
+        NS_LOG_LOGIC ("Interface Up " << i << " for destination " << state.m_address << " setting remote seq to " << 0 << " for VNODE " << (uint32_t)vnode);
+        link.m_ttl = 0;
+        LinkSetRemove(GetLinkSet(state, vnode, OutputLinks), link.m_rank);
+        LinkSetAdd(GetLinkSet(state, vnode, InputLinks), link.m_rank);
+        LinkSetAdd(GetToReverse(state, vnode), link.m_rank);
+    }
+  }
+  //if (Simulator::Now ().GetSeconds () > 0)  // avoid startup events
+    //{
+      //std::cerr << "Recomputing routes now\n";
+      //GlobalRouteManager::DeleteGlobalRoutes ();
+      //GlobalRouteManager::BuildGlobalRoutingDatabase ();
+      //GlobalRouteManager::InitializeRoutes ();
+    //}
+}
+
+void 
+Ipv4GlobalRouting::NotifyInterfaceDown (uint32_t i)
+{
+  NS_LOG_FUNCTION (this << i);
+  UpdateLinkState(i);
+  InvalidateRoutes(i);
+  if (m_ddcMessages)
+    {
+      ReleaseDdcLink (i);
+    }
+  if (m_respondToInterfaceEvents && m_incrementalRouteUpdates && Simulator::Now ().GetSeconds () > 0)
+    {
+      GlobalRouteManager::UpdateRoutesForLink (m_ipv4->GetNetDevice (i));
+    }
+  else if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
+    {
+      GlobalRouteManager::DeleteGlobalRoutes ();
+      GlobalRouteManager::BuildGlobalRoutingDatabase ();
+      GlobalRouteManager::InitializeRoutes ();
+    }
+}
+
+void 
+Ipv4GlobalRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+{
+  //NS_LOG_FUNCTION (this << interface << address);
+  InvalidateRoutes (interface);
+  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
+    {
+      GlobalRouteManager::DeleteGlobalRoutes ();
+      GlobalRouteManager::BuildGlobalRoutingDatabase ();
+      GlobalRouteManager::InitializeRoutes ();
+    }
+}
+
+void 
+Ipv4GlobalRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+{
+  //NS_LOG_FUNCTION (this << interface << address);
+  InvalidateRoutes (interface);
+  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
+    {
+      GlobalRouteManager::DeleteGlobalRoutes ();
+      GlobalRouteManager::BuildGlobalRoutingDatabase ();
+      GlobalRouteManager::InitializeRoutes ();
+    }
+}
+
+void 
+Ipv4GlobalRouting::SetIpv4 (Ptr<Ipv4> ipv4)
+{
+  //NS_LOG_FUNCTION (this << ipv4);
+  NS_ASSERT (m_ipv4 == 0 && ipv4 != 0);
+  m_ipv4 = ipv4;
+  for (uint32_t i = 0; i < m_ipv4->GetNInterfaces(); i++) {
+    UpdateLinkState(i);
+  }
+  Ptr<Node> node = m_ipv4->GetObject<Node> ();
+  if (node != 0)
+    {
+      m_nodeId = node->GetId ();
+      node->RegisterProtocolHandler (MakeCallback (&Ipv4GlobalRouting::ReceiveDdc, this),
+                                     DDC_PROTOCOL, 0);
+    }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::UpdateLinkState (uint32_t interface)
+{
+  uint32_t words = LinkSetWords(interface + 1);
+  if (m_linkUp.size() < words) {
+    m_linkUp.resize(words, 0);
+  }
+  if (m_ipv4->GetNetDevice(interface)->IsLinkUp()) {
+    LinkSetAdd(&m_linkUp[0], interface);
+  }
+  else {
+    LinkSetRemove(&m_linkUp[0], interface);
+  }
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::IsLinkUp (uint32_t interface) const
+{
+  return interface / 64 < m_linkUp.size() && LinkSetContains(&m_linkUp[0], interface);
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::PrimitiveAEO (Ipv4Address dest)
+{
+  //NS_LOG_FUNCTION (this << dest);
+  DestinationState &state = GetDestination(dest);
+  state.m_aeoRequested = true;
+  if (m_ddcMessages) {
+    // FinishAEO () runs once the neighbours granted the lock
+    RequestLocks(dest);
+    return false;
+  }
+  bool success = LocalLock(dest);
+  //NS_LOG_LOGIC("Acquiring lock " << success);
+  // NS_ASSERT_MSG(success, "Could not acquire lock");
+  if (success) {
+    FinishAEO(dest);
+    return true;
+  }
+  NoteAeoDeferred(state);
+  return false;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::FinishAEO (Ipv4Address dest)
+{
+  DestinationState &state = GetDestination(dest);
+  state.m_aeoRequested = false;
+  if (state.m_aeoDeferred) {
+    Time waited = Simulator::Now() - state.m_aeoDeferredAt;
+    state.m_aeoDeferred = false;
+    m_aeoDeferralTime += waited;
+    m_aeoDeferredTrace(state.m_address, waited);
+  }
+  uint8_t newVnode = (state.m_localVnode + 1) % m_vnodes;
+  ClearVnode(newVnode, dest);
+  uint64_t *outputs = GetLinkSet(state, newVnode, OutputLinks);
+  for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); i++) {
+    LinkState &link = state.m_links[i];
+    if (link.GetDirection(newVnode) != Out) {
+      if (link.GetDirection(newVnode) != Dead) {
+        LinkSetAdd(outputs, link.m_rank);
+        link.SetDirection(newVnode, Out);
+        link.SetLocalSeq(newVnode, 0);
+        link.SetRemoteSeq(newVnode, 0);
+        NS_LOG_LOGIC ("Primitive AEO " << i << " for destination " << dest << " setting remote seq to " << 0 << " for VNODE " << (uint32_t)newVnode);
+        // Reset TTL during AEO operation, this makes sense since AEO is
+        // primarily a control plane primitive, and is called in order, and
+        // sets true directions
+        link.m_ttl = 0;
+        LocalSetRemoteVnode(dest,  i, newVnode);
       }
     }
-    else {
-      error = Socket::ERROR_NOROUTETOHOST;
-      return;
+  }
+  state.m_localVnode = newVnode;
+  LocalUnlock(dest);
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::SetInterfacePriority (
+    Ipv4Address dest,
+    uint32_t interface,
+    uint32_t priority) {
+  //NS_LOG_LOGIC (this << "setting interface " << interface << " priority to " << priority);
+  DestinationState &state = GetDestination(dest);
+  LinkState &link = state.m_links[interface];
+  LinkSetAdd(GetLinkSet(state, 0, PrioritizedLinks), link.m_rank);
+  if (link.m_priority != priority) {
+    link.m_priority = priority;
+    state.m_rankStale = true;
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::SetInterfaceDistance (Ipv4Address dest, uint32_t interface, uint16_t distance)
+{
+  if (!m_distanceRanking) {
+    return;
+  }
+  DestinationState &state = GetDestination(dest);
+  if (state.m_linkDistances.empty()) {
+    state.m_linkDistances.assign(state.m_links.size(), 0);
+  }
+  if (state.m_linkDistances[interface] != distance) {
+    state.m_linkDistances[interface] = distance;
+    state.m_rankStale = true;
+  }
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::GetDistanceRanking (void) const
+{
+  return m_distanceRanking;
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::FindOutputPort (uint8_t vnode, DestinationState &state, uint32_t &link, uint32_t iif)
+{
+  //NS_LOG_FUNCTION (this << state.m_address);
+  // iif is deliberately not skipped: the old heap based lookup meant to, but
+  // always fell back to iif, and existing experiments depend on that.
+  if (state.m_rankStale) {
+    RankLinks(state);
+  }
+  const uint64_t *outputs = GetLinkSet(state, vnode, OutputLinks);
+  uint32_t words = LinkSetWords(state.m_links.size());
+  for (uint32_t w = 0; w < words; w++) {
+    uint64_t alive = outputs[w];
+    while (alive != 0) {
+      uint32_t rank = w * 64 + __builtin_ctzll(alive);
+      link = state.m_linkAtRank[rank];
+      NS_ASSERT(state.m_links[link].GetDirection(vnode) == Out);
+      if (IsLinkUp(link)) {
+        NS_LOG_LOGIC("Returning output link " << link << "(priority = " << state.m_links[link].m_priority << ")");
+        return true;
+      }
+      // Dead outputs stay in the set, they are used again once the link
+      // comes back
+      alive &= alive - 1;
+    }
+  }
+  NS_LOG_LOGIC("Found no output");
+  return false;
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::FindHighPriorityLink(uint8_t vnode, DestinationState &state, uint32_t &link)
+{
+  //NS_LOG_FUNCTION (this << state.m_address);
+  if (state.m_rankStale) {
+    RankLinks(state);
+  }
+  const uint64_t *links = GetLinkSet(state, vnode, PrioritizedLinks);
+  uint32_t words = LinkSetWords(state.m_links.size());
+  for (uint32_t w = 0; w < words; w++) {
+    for (uint64_t candidates = links[w]; candidates != 0; candidates &= candidates - 1) {
+      link = state.m_linkAtRank[w * 64 + __builtin_ctzll(candidates)];
+      if (IsLinkUp(link)) {
+        NS_LOG_LOGIC("Returning output link " << link << "(priority = " << state.m_links[link].m_priority << ")");
+        return true;
+      }
+    }
+  }
+  NS_LOG_LOGIC("Found no output");
+  return false;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::InitializeDestination (Ipv4Address dest)
+{
+  //NS_LOG_FUNCTION (this << dest);
+  //NS_LOG_LOGIC("Initializing stuff for dest = " << dest << " at node " << m_ipv4->GetNetDevice(0)->GetNode()->GetId());
+  //NS_LOG_LOGIC("Number of interfaces = " << m_ipv4->GetNInterfaces());
+  if (m_aliases != 0) {
+    dest = m_aliases->Resolve(dest);
+  }
+  if (m_destinationIndex.find(dest) != m_destinationIndex.end()) {
+    return;
+  }
+  LinkState link;
+  link.m_priority = 0;
+  link.m_ttl = 0;
+  link.m_directions = 0;
+  link.m_seq = 0;
+  link.m_remoteVnode = 0;
+  link.m_lockedVnode = NotLocked;
+  link.m_heartbeat = false;
+  link.m_rank = 0;
+
+  // Built in place, copying a filled in state would allocate every vector
+  // twice
+  m_destinationIndex.insert(DestinationIndex::value_type(dest, m_destinations.size()));
+  m_destinations.push_back(DestinationState());
+  DestinationState &state = m_destinations.back();
+  state.m_address = dest;
+  state.m_localVnode = 0;
+  state.m_aeoRequested = false;
+  state.m_aeoDeferred = false;
+  state.m_held = false;
+  state.m_reversalOrderSet = false;
+  state.m_lockCount = 0;
+  state.m_heartbeatSequence = 0;
+  state.m_links.assign(m_ipv4->GetNInterfaces(), link);
+  state.m_linkAtRank.resize(state.m_links.size());
+  // All priorities start out equal, so interfaces rank in index order
+  for (uint32_t i = 0; i < state.m_links.size(); i++) {
+    state.m_links[i].m_rank = i;
+    state.m_linkAtRank[i] = i;
+  }
+  state.m_rankStale = false;
+  state.m_linkSets.assign(m_vnodes * LinkSetCount * LinkSetWords(state.m_links.size()), 0);
+  for (int i = 0; i < m_vnodes; i++) {
+    state.m_toReverseEpoch[i] = m_toReverseEpoch[i];
+  }
+}
+
+// @apanda
+Ipv4GlobalRouting::DestinationState *
+Ipv4GlobalRouting::FindDestination (Ipv4Address addr)
+{
+  if (m_aliases != 0) {
+    addr = m_aliases->Resolve(addr);
+  }
+  DestinationIndex::iterator it = m_destinationIndex.find(addr);
+  if (it == m_destinationIndex.end()) {
+    return 0;
+  }
+  return &m_destinations[it->second];
+}
+
+// @apanda
+Ipv4GlobalRouting::DestinationState &
+Ipv4GlobalRouting::GetDestination (Ipv4Address addr)
+{
+  if (m_aliases != 0) {
+    addr = m_aliases->Resolve(addr);
+  }
+  DestinationIndex::iterator it = m_destinationIndex.find(addr);
+  if (it != m_destinationIndex.end()) {
+    return m_destinations[it->second];
+  }
+  InitializeDestination(addr);
+  return m_destinations.back();
+}
+
+// @apanda
+uint64_t *
+Ipv4GlobalRouting::GetLinkSet (DestinationState &state, uint8_t vnode, LinkSet set)
+{
+  uint32_t words = LinkSetWords(state.m_links.size());
+  return &state.m_linkSets[(vnode * LinkSetCount + set) * words];
+}
+
+// @apanda
+uint64_t *
+Ipv4GlobalRouting::GetToReverse (DestinationState &state, uint8_t vnode)
+{
+  uint64_t *toReverse = GetLinkSet(state, vnode, ToReverseLinks);
+  if (state.m_toReverseEpoch[vnode] != m_toReverseEpoch[vnode]) {
+    std::fill(toReverse, toReverse + LinkSetWords(state.m_links.size()), 0);
+    state.m_toReverseEpoch[vnode] = m_toReverseEpoch[vnode];
+  }
+  return toReverse;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::RankLinks (DestinationState &state)
+{
+  uint32_t links = state.m_links.size();
+  uint32_t words = LinkSetWords(links);
+  std::vector<PriorityInterface> order;
+  order.reserve(links);
+  for (uint32_t i = 0; i < links; i++) {
+    uint64_t key = (uint64_t)state.m_links[i].m_priority << 16;
+    if (!state.m_linkDistances.empty()) {
+      key |= state.m_linkDistances[i];
+    }
+    order.push_back(PriorityInterface(key, i));
+  }
+  std::sort(order.begin(), order.end());
+  for (uint32_t rank = 0; rank < links; rank++) {
+    state.m_links[order[rank].second].m_rank = rank;
+  }
+  // Old ranks are still in m_linkAtRank, use them to translate every set
+  std::vector<uint64_t> sets(state.m_linkSets.size(), 0);
+  for (uint32_t set = 0; set < m_vnodes * LinkSetCount; set++) {
+    const uint64_t *from = &state.m_linkSets[set * words];
+    uint64_t *to = &sets[set * words];
+    for (uint32_t rank = 0; rank < links; rank++) {
+      if (LinkSetContains(from, rank)) {
+        LinkSetAdd(to, state.m_links[state.m_linkAtRank[rank]].m_rank);
+      }
+    }
+  }
+  // Copy in place, callers may hold pointers into m_linkSets
+  std::copy(sets.begin(), sets.end(), state.m_linkSets.begin());
+  for (uint32_t rank = 0; rank < links; rank++) {
+    state.m_linkAtRank[rank] = order[rank].second;
+  }
+  state.m_rankStale = false;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::ReverseInputToOutput (uint8_t vnode, Ipv4Address addr, uint32_t link)
+{
+  DestinationState &state = GetDestination(addr);
+  LinkState &linkState = state.m_links[link];
+  if (linkState.GetDirection(vnode) != In) {
+    return;
+  }
+  //NS_LOG_FUNCTION (this << vnode << addr << link);
+  m_reversalCallback(link, addr);
+  linkState.m_ttl++;
+  linkState.SetDirection(vnode, Out);
+  LinkSetRemove(GetLinkSet(state, vnode, InputLinks), linkState.m_rank);
+  LinkSetAdd(GetLinkSet(state, vnode, OutputLinks), linkState.m_rank);
+  linkState.SetLocalSeq(vnode, linkState.GetLocalSeq(vnode) + 1);
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::ReverseOutputToInput (uint8_t vnode, Ipv4Address addr, uint32_t link)
+{
+  DestinationState &state = GetDestination(addr);
+  LinkState &linkState = state.m_links[link];
+  if (linkState.GetDirection(vnode) != Out) {
+    return;
+  }
+  NS_ASSERT(linkState.GetDirection(vnode) == Out);
+  NS_LOG_FUNCTION (this << vnode << addr << link);
+  m_reversalCallback(link, addr);
+  linkState.m_ttl++;
+  linkState.SetDirection(vnode, In);
+  LinkSetRemove(GetLinkSet(state, vnode, OutputLinks), linkState.m_rank);
+  LinkSetAdd(GetLinkSet(state, vnode, InputLinks), linkState.m_rank);
+  linkState.SetRemoteSeq(vnode, linkState.GetRemoteSeq(vnode) + 1);
+  NS_LOG_LOGIC ("Reverse Out to In " << link << " for destination " << addr<< " setting remote seq to " << (uint32_t)linkState.GetRemoteSeq(vnode) << " for VNODE " << (uint32_t)vnode);
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::QueueReversal (ReversalKind kind, uint8_t vnode, Ipv4Address addr, uint32_t link)
+{
+  uint64_t key = ((uint64_t)addr.Get() << 32) | (link << 3) | (vnode << 1) | kind;
+  if (!m_queuedReversals.insert(std::make_pair(key, true)).second) {
+    m_reversalsSuppressed++;
+    return;
+  }
+  QueuedReversal reversal;
+  reversal.m_due = Simulator::Now() + (kind == ToOutput ? m_reverseInputToOutputDelay : m_reverseOutputToInputDelay);
+  reversal.m_order = m_reversalOrder++;
+  reversal.m_destination = addr;
+  reversal.m_link = link;
+  reversal.m_vnode = vnode;
+  std::deque<QueuedReversal> &queue = m_reversals[kind];
+  if (queue.empty() || queue.back().m_due <= reversal.m_due) {
+    queue.push_back(reversal);
+  }
+  else {
+    // Only if the delay was shortened while reversals were waiting
+    std::deque<QueuedReversal>::iterator it = queue.end();
+    while (it != queue.begin() && (it - 1)->m_due > reversal.m_due) {
+      it--;
     }
-  } while (!m_vnodeState[vnode].m_inputs[addr].empty() || !m_vnodeState[vnode].m_outputs[addr].empty());
+    queue.insert(it, reversal);
+  }
+  if (!m_reversalEvent.IsRunning() || reversal.m_due < TimeStep(m_reversalEvent.GetTs())) {
+    m_reversalEvent.Cancel();
+    m_reversalEvent = Simulator::Schedule(reversal.m_due - Simulator::Now(), &Ipv4GlobalRouting::RunReversals, this);
+  }
 }
 
 // @apanda
 void
-Ipv4GlobalRouting::ScheduleReversals (uint8_t vnode, Ipv4Address addr)
-{
-  //NS_LOG_FUNCTION (this << addr);
-  if (m_vnodeState[vnode].m_to_reverse[addr].empty()) {
-    m_vnodeState[vnode].m_to_reverse[addr].insert(m_vnodeState[vnode].m_to_reverse[addr].begin(), 
-                        m_vnodeState[vnode].m_inputs[addr].begin(), 
-                        m_vnodeState[vnode].m_inputs[addr].end()); 
-  }
-  
-  for (std::list<uint32_t>::iterator it = m_vnodeState[vnode].m_to_reverse[addr].begin();
-      it != m_vnodeState[vnode].m_to_reverse[addr].end();
-      it++) {
-    // ReverseInputToOutput(vnode, addr, *it)
-    NS_LOG_LOGIC("Scheduling reversal from input to output");
-    if (!m_reverseInputToOutputDelay.IsZero()) {
-      Simulator::Schedule(m_reverseInputToOutputDelay, &Ipv4GlobalRouting::ReverseInputToOutput, this, vnode, addr, *it);
+Ipv4GlobalRouting::RunReversals (void)
+{
+  Time now = Simulator::Now();
+  while (true) {
+    // Earliest front first, in the order they were queued on a tie
+    int kind = -1;
+    for (int k = ToOutput; k <= ToInput; k++) {
+      if (m_reversals[k].empty() || m_reversals[k].front().m_due > now) {
+        continue;
+      }
+      if (kind < 0 || m_reversals[k].front().m_due < m_reversals[kind].front().m_due ||
+          (m_reversals[k].front().m_due == m_reversals[kind].front().m_due &&
+           m_reversals[k].front().m_order < m_reversals[kind].front().m_order)) {
+        kind = k;
+      }
+    }
+    if (kind < 0) {
+      break;
+    }
+    QueuedReversal reversal = m_reversals[kind].front();
+    m_reversals[kind].pop_front();
+    m_queuedReversals.erase(((uint64_t)reversal.m_destination.Get() << 32) | (reversal.m_link << 3) |
+                            (reversal.m_vnode << 1) | kind);
+    if (kind == ToOutput) {
+      ReverseInputToOutput(reversal.m_vnode, reversal.m_destination, reversal.m_link);
     }
     else {
-      ReverseInputToOutput(vnode, addr, *it);
+      ReverseOutputToInput(reversal.m_vnode, reversal.m_destination, reversal.m_link);
+    }
+  }
+  for (int k = ToOutput; k <= ToInput; k++) {
+    if (!m_reversals[k].empty() &&
+        (!m_reversalEvent.IsRunning() || m_reversals[k].front().m_due < TimeStep(m_reversalEvent.GetTs()))) {
+      m_reversalEvent.Cancel();
+      m_reversalEvent = Simulator::Schedule(m_reversals[k].front().m_due - now, &Ipv4GlobalRouting::RunReversals, this);
+    }
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::SendOnOutlink (uint8_t vnode, DestinationState &state, Ipv4Header& header, uint32_t link)
+{
+  NS_LOG_FUNCTION (this << state.m_address);
+  const LinkState &linkState = state.m_links[link];
+  //NS_LOG_LOGIC("Setting sequence number to " << (uint32_t)linkState.GetLocalSeq(vnode));
+  header.SetSeq(linkState.GetLocalSeq(vnode));
+  //NS_LOG_LOGIC("Sequence number is " << header.GetSeq());
+  //NS_LOG_LOGIC("Setting vnode number to " << (uint32_t)linkState.m_remoteVnode);
+  header.SetVnode(linkState.m_remoteVnode);
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::CreateRoutingEntry (uint8_t vnode, uint32_t link, DestinationState &state, Ipv4Header& header, Ptr<Ipv4Route> &route)
+{
+  SendOnOutlink(vnode, state, header, link);
+  route = GetLinkRoute (link, header.GetDestination ());
+}
+
+// @apanda
+Ptr<Ipv4Route>
+Ipv4GlobalRouting::GetLinkRoute (uint32_t link, Ipv4Address dest)
+{
+  if (link < m_linkRoutes.size () && m_linkRoutes[link] != 0)
+    {
+      return m_linkRoutes[link];
+    }
+  Ptr<NetDevice> netdev = m_ipv4->GetNetDevice (link);
+  Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+  route->SetOutputDevice (netdev);
+  route->SetSource (m_ipv4->GetAddress (link, 0).GetLocal ());
+  // On a point to point link the next hop is the peer whatever the
+  // destination, so a single route serves every packet
+  Ptr<Channel> channel = netdev->GetChannel ();
+  if (channel != 0 && channel->GetNDevices () == 2)
+    {
+      Ptr<NetDevice> peer = channel->GetDevice (0);
+      if (peer == netdev)
+        {
+          peer = channel->GetDevice (1);
+        }
+      Ptr<Ipv4> peerIpv4 = peer->GetNode ()->GetObject<Ipv4> ();
+      int32_t peerInterface = peerIpv4 ? peerIpv4->GetInterfaceForDevice (peer) : -1;
+      if (peerInterface >= 0 && peerIpv4->GetNAddresses (peerInterface) > 0)
+        {
+          Ipv4Address gateway = peerIpv4->GetAddress (peerInterface, 0).GetLocal ();
+          route->SetDestination (gateway);
+          route->SetGateway (gateway);
+          if (m_linkRoutes.size () <= link)
+            {
+              m_linkRoutes.resize (m_ipv4->GetNInterfaces ());
+            }
+          m_linkRoutes[link] = route;
+          return route;
+        }
+    }
+  route->SetDestination (dest);
+  route->SetGateway (dest);
+  return route;
+}
+
+// @apanda
+Ptr<Ipv4Route>
+Ipv4GlobalRouting::GetLocalRoute (uint32_t interface, uint32_t addressIndex)
+{
+  if (addressIndex == 0 && interface < m_localRoutes.size () && m_localRoutes[interface] != 0)
+    {
+      return m_localRoutes[interface];
+    }
+  Ipv4Address local = m_ipv4->GetAddress (interface, addressIndex).GetLocal ();
+  Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+  route->SetDestination (local);
+  route->SetGateway (local);
+  route->SetOutputDevice (m_ipv4->GetNetDevice (0));
+  route->SetSource (m_ipv4->GetAddress (0, 0).GetLocal ());
+  if (addressIndex == 0)
+    {
+      if (m_localRoutes.size () <= interface)
+        {
+          m_localRoutes.resize (m_ipv4->GetNInterfaces ());
+        }
+      m_localRoutes[interface] = route;
+    }
+  return route;
+}
+
+// @apanda
+Ptr<Ipv4Route>
+Ipv4GlobalRouting::GetEntryRoute (NextHop &nextHop)
+{
+  if (nextHop.m_route != 0)
+    {
+      return nextHop.m_route;
+    }
+  const Ipv4RoutingTableEntry *entry = nextHop.m_entry;
+  // create a Ipv4Route object from the selected routing table entry
+  Ptr<Ipv4Route> rtentry = Create<Ipv4Route> ();
+  rtentry->SetDestination (entry->GetDest ());
+  // XXX handle multi-address case
+  rtentry->SetSource (m_ipv4->GetAddress (entry->GetInterface (), 0).GetLocal ());
+  rtentry->SetGateway (entry->GetGateway ());
+  rtentry->SetOutputDevice (m_ipv4->GetNetDevice (entry->GetInterface ()));
+  nextHop.m_route = rtentry;
+  return rtentry;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::InvalidateRoutes (uint32_t interface)
+{
+  if (interface < m_linkRoutes.size ())
+    {
+      m_linkRoutes[interface] = 0;
+    }
+  if (interface < m_localRoutes.size ())
+    {
+      m_localRoutes[interface] = 0;
+    }
+  // Entry routes take their source from the interface, and the loopback
+  // address is the source of every local route
+  ClearEntryRoutes ();
+  if (interface == 0)
+    {
+      m_localRoutes.clear ();
+    }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::StandardReceive (Ipv4Address addr, Ipv4Header& header,
+                                Ptr<Ipv4Route> &route, Socket::SocketErrno &error, uint32_t iif)
+{
+  NS_LOG_FUNCTION (this << addr);
+  route = 0;
+  uint32_t link;
+  uint8_t vnode = header.GetVnode();
+  DestinationState *state = FindDestination(addr);
+  if (state == 0) {
+    error = Socket::ERROR_NOROUTETOHOST;
+    NS_LOG_LOGIC("No path to " << addr);
+    return;
+  }
+  do {
+    if (FindOutputPort(vnode, *state, link, iif)) {
+      NS_LOG_LOGIC ("Choosing to use output port " << link);
+      CreateRoutingEntry(vnode, link, *state, header, route);
+      return;
+    }
+    if (!m_allowReversal) {
+      error = Socket::ERROR_NOROUTETOHOST;
+      return;
+    }
+    NS_LOG_LOGIC ("Reversing " << addr);
+    // New outputs may all be dead, in which case try the next round
+  } while (ScheduleReversals(vnode, *state));
+  NS_LOG_LOGIC ("Failed to find a link, so just using first high priority link " << addr);
+  if (FindHighPriorityLink(vnode, *state, link)) {
+    CreateRoutingEntry(vnode, link, *state, header, route);
+  }
+  else {
+    error = Socket::ERROR_NOROUTETOHOST;
+    NS_LOG_LOGIC("No path to " << addr);
+  }
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::ScheduleReversals (uint8_t vnode, DestinationState &state)
+{
+  //NS_LOG_FUNCTION (this << state.m_address);
+  uint32_t words = LinkSetWords(state.m_links.size());
+  const uint64_t *inputs = GetLinkSet(state, vnode, InputLinks);
+  uint64_t *toReverse = GetToReverse(state, vnode);
+  if (LinkSetEmpty(toReverse, words)) {
+    std::copy(inputs, inputs + words, toReverse);
+  }
+  bool reversed = false;
+
+  for (uint32_t w = 0; w < words; w++) {
+    for (uint64_t pending = toReverse[w]; pending != 0; pending &= pending - 1) {
+      uint32_t link = state.m_linkAtRank[w * 64 + __builtin_ctzll(pending)];
+      // ReverseInputToOutput(vnode, addr, link)
+      NS_LOG_LOGIC("Scheduling reversal from input to output");
+      if (!m_reverseInputToOutputDelay.IsZero()) {
+        QueueReversal(ToOutput, vnode, state.m_address, link);
+      }
+      else {
+        reversed |= (state.m_links[link].GetDirection(vnode) == In);
+        ReverseInputToOutput(vnode, state.m_address, link);
+      }
     }
   }
-  m_vnodeState[vnode].m_to_reverse.clear();
-  m_vnodeState[vnode].m_to_reverse[addr].insert(m_vnodeState[vnode].m_to_reverse[addr].begin(), m_vnodeState[vnode].m_inputs[addr].begin(), m_vnodeState[vnode].m_inputs[addr].end()); 
+  // Drop the pending reversals of every destination on this vnode
+  m_toReverseEpoch[vnode]++;
+  std::copy(inputs, inputs + words, toReverse);
+  state.m_toReverseEpoch[vnode] = m_toReverseEpoch[vnode];
+  return reversed;
 }
 
 // @apanda
 void
 Ipv4GlobalRouting::ClearVnode(uint8_t vnode, Ipv4Address dest)
 {
-  m_vnodeState[vnode].m_directions.erase(dest);
-  m_vnodeState[vnode].m_directions.insert(InterfaceDirection::value_type(dest, std::vector<LinkDirection>(m_ipv4->GetNInterfaces(), Unknown)));
-  m_vnodeState[vnode].m_inputs.erase(dest);
-  m_vnodeState[vnode].m_inputs.insert(DestinationListInterfaceQueues::value_type(dest, std::list<uint32_t>()));
-  m_vnodeState[vnode].m_outputs.erase(dest);
-  m_vnodeState[vnode].m_outputs.insert(DestinationPriorityInterfaceQueues::value_type(dest, InterfaceQueue())); 
-  m_vnodeState[vnode].m_localSeq.erase(dest);
-  m_vnodeState[vnode].m_localSeq.insert(SequenceNumbers::value_type(dest, std::vector<uint8_t>(m_ipv4->GetNInterfaces(), 0)));
-  m_vnodeState[vnode].m_remoteSeq.erase(dest);
-  m_vnodeState[vnode].m_remoteSeq.insert(SequenceNumbers::value_type(dest, std::vector<uint8_t>(m_ipv4->GetNInterfaces(), 0)));
-  m_vnodeState[vnode].m_to_reverse.erase(dest);
-  m_vnodeState[vnode].m_to_reverse.insert(DestinationListInterfaceQueues::value_type(dest, std::list<uint32_t>()));
-  m_vnodeState[vnode].m_prioritized_links.erase(dest);
-  m_vnodeState[vnode].m_prioritized_links.insert(DestinationPriorityInterfaceQueues::value_type(dest, InterfaceQueue())); 
+  DestinationState &state = GetDestination(dest);
+  for (std::vector<LinkState>::iterator it = state.m_links.begin(); it != state.m_links.end(); it++) {
+    it->SetDirection(vnode, Unknown);
+    it->SetLocalSeq(vnode, 0);
+    it->SetRemoteSeq(vnode, 0);
+  }
+  uint64_t *sets = GetLinkSet(state, vnode, OutputLinks);
+  std::fill(sets, sets + LinkSetCount * LinkSetWords(state.m_links.size()), 0);
+  state.m_toReverseEpoch[vnode] = m_toReverseEpoch[vnode];
+  uint64_t *prioritized = GetLinkSet(state, vnode, PrioritizedLinks);
   for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); i++) {
-    m_vnodeState[vnode].m_prioritized_links[dest].push(PriorityInterface(m_priorities[dest][i], i));  
+    LinkSetAdd(prioritized, state.m_links[i].m_rank);
   }
 }
 
@@ -1210,10 +2177,11 @@ Ipv4GlobalRouting::ClearVnode(uint8_t vnode, Ipv4Address dest)
 bool
 Ipv4GlobalRouting::SimpleLock (Ipv4Address addr, uint32_t link)
 {
-  if (!m_held[addr]) {
-    NS_ASSERT_MSG(!m_locks[addr][link], "Should not reaquire a lock");
-    m_locks[addr][link] = true;
-    m_lockCounts[addr] += 1;
+  DestinationState &state = GetDestination(addr);
+  if (!state.m_held) {
+    NS_ASSERT_MSG(!state.m_links[link].IsLocked(), "Should not reaquire a lock");
+    state.m_links[link].m_lockedVnode = state.m_localVnode;
+    state.m_lockCount += 1;
     return true;
   }
   return false;
@@ -1223,24 +2191,25 @@ Ipv4GlobalRouting::SimpleLock (Ipv4Address addr, uint32_t link)
 void
 Ipv4GlobalRouting::SimpleUnlock (Ipv4Address addr, uint32_t link)
 {
-  NS_ASSERT_MSG(!m_held[addr], "If someone else thinks they have it, I better not hold it");
-  NS_ASSERT_MSG(m_locks[addr][link], "Don't free something you don't hold");
-  m_locks[addr][link] = false;
-  m_lockCounts[addr] -= 1;
-  if (m_aeoRequested[addr] && m_lockCounts[addr] == 0) {
+  DestinationState &state = GetDestination(addr);
+  NS_ASSERT_MSG(!state.m_held, "If someone else thinks they have it, I better not hold it");
+  NS_ASSERT_MSG(state.m_links[link].IsLocked(), "Don't free something you don't hold");
+  state.m_links[link].m_lockedVnode = NotLocked;
+  state.m_lockCount -= 1;
+  if (state.m_aeoRequested && CanStartAeo(state)) {
     PrimitiveAEO(addr);
   }
 }
 
 // @apanda
-bool 
+bool
 Ipv4GlobalRouting::Lock (Ipv4Address addr, Ptr<NetDevice> link)
 {
   return SimpleLock(addr, m_ipv4->GetInterfaceForDevice(link));
 }
 
 // @apanda
-void 
+void
 Ipv4GlobalRouting::Unlock (Ipv4Address addr, Ptr<NetDevice> link)
 {
   return SimpleUnlock(addr, m_ipv4->GetInterfaceForDevice(link));
@@ -1250,9 +2219,10 @@ Ipv4GlobalRouting::Unlock (Ipv4Address addr, Ptr<NetDevice> link)
 void
 Ipv4GlobalRouting::UpdateHeartbeat (uint32_t seq, Ipv4Address addr)
 {
-  m_heartbeatSequence[addr] = seq;
+  DestinationState &state = GetDestination(addr);
+  state.m_heartbeatSequence = seq;
   for (uint32_t i = 0; i < m_ipv4->GetNInterfaces(); i++) {
-    m_heartbeatState[addr][i] = false; 
+    state.m_links[i].m_heartbeat = false;
   }
 }
 
@@ -1261,7 +2231,8 @@ void
 Ipv4GlobalRouting::CheckAndAEO (Ipv4Address addr, uint32_t iface)
 {
   //NS_LOG_FUNCTION (this << addr << iface);
-  if (m_heartbeatState[addr][0]) {
+  DestinationState &state = GetDestination(addr);
+  if (state.m_links[0].m_heartbeat) {
     NS_LOG_LOGIC("Already AEOd for this");
     // We have already AEOed, let's just get on with our life
     return;
@@ -1269,14 +2240,14 @@ Ipv4GlobalRouting::CheckAndAEO (Ipv4Address addr, uint32_t iface)
 
   bool seenPrevious = true;
   bool ifaceBefore = false;
-  for (std::vector<uint32_t>::iterator it = m_reverseBefore[addr].begin();
-       it != m_reverseBefore[addr].end(); it++) {
+  for (std::vector<uint32_t>::iterator it = state.m_reverseBefore.begin();
+       it != state.m_reverseBefore.end(); it++) {
     ifaceBefore |= (*it == iface);
-    seenPrevious &= (m_heartbeatState[addr][*it]);
+    seenPrevious &= HeardHeartbeat(state, *it);
   }
  NS_ASSERT_MSG(seenPrevious || ifaceBefore, "Cannot have someone later than us in the order hearbeating before us");
  if (seenPrevious) {
-   m_heartbeatState[addr][0] = true;
+   state.m_links[0].m_heartbeat = true;
    //NS_LOG_LOGIC("Actually reversing");
    PrimitiveAEO(addr);
  }
@@ -1287,15 +2258,18 @@ Ipv4GlobalRouting::CheckAndAEO (Ipv4Address addr, uint32_t iface)
 void
 Ipv4GlobalRouting::ReceiveHeartbeat (uint32_t seq, Ipv4Address addr, Ptr<NetDevice> link)
 {
-  Ptr<Channel> channel = link->GetChannel();
-  Ptr<NetDevice> other = (channel->GetDevice(0) == link ? channel->GetDevice(1) : channel->GetDevice(0));
-  NS_ASSERT(other != link);
-  Ptr<Node> otherNode = other->GetNode();
-  //NS_LOG_LOGIC("Receiving a heartbeat at " <<  m_ipv4->GetNetDevice(0)->GetNode()->GetId() << " from " << otherNode->GetId() << " for " << addr);
-  //NS_LOG_FUNCTION (this << seq << addr << link);
-  if (seq != m_heartbeatSequence[addr]) {
+  HandleHeartbeat(seq, addr, m_ipv4->GetInterfaceForDevice(link));
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::HandleHeartbeat (uint32_t seq, Ipv4Address addr, uint32_t iface)
+{
+  //NS_LOG_FUNCTION (this << seq << addr << iface);
+  DestinationState &state = GetDestination(addr);
+  if (seq != state.m_heartbeatSequence) {
     //NS_LOG_LOGIC("New heartbeat, maybe?");
-    if (seq > m_heartbeatSequence[addr]) {
+    if (seq > state.m_heartbeatSequence) {
       UpdateHeartbeat(seq, addr);
     }
     else {
@@ -1304,16 +2278,49 @@ Ipv4GlobalRouting::ReceiveHeartbeat (uint32_t seq, Ipv4Address addr, Ptr<NetDevi
       return;
     }
   }
-  m_heartbeatState[addr][m_ipv4->GetInterfaceForDevice(link)] = true;
-  CheckAndAEO(addr, m_ipv4->GetInterfaceForDevice(link));
+  state.m_links[iface].m_heartbeat = true;
+  CheckAndAEO(addr, iface);
 }
 
 // @apanda
-bool 
+bool
+Ipv4GlobalRouting::CanStartAeo (const DestinationState &state) const
+{
+  if (state.m_lockCount == 0) {
+    return true;
+  }
+  uint32_t pinned = 0;
+  for (uint32_t i = 1; i < state.m_links.size(); i++) {
+    if (state.m_links[i].IsLocked()) {
+      pinned |= 1 << state.m_links[i].m_lockedVnode;
+    }
+  }
+  uint8_t next = (state.m_localVnode + 1) % m_vnodes;
+  uint32_t count = 0;
+  for (uint8_t v = 0; v < m_vnodes; v++) {
+    count += (pinned >> v) & 1;
+  }
+  return !(pinned & (1 << next)) && count < (uint32_t)(m_vnodes - 1);
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::NoteAeoDeferred (DestinationState &state)
+{
+  if (!state.m_aeoDeferred) {
+    state.m_aeoDeferred = true;
+    state.m_aeoDeferredAt = Simulator::Now();
+    m_aeosDeferred++;
+  }
+}
+
+// @apanda
+bool
 Ipv4GlobalRouting::LocalLock (Ipv4Address addr)
 {
-  NS_ASSERT_MSG(!m_held[addr], "No recursive locks");
-  if (m_lockCounts[addr] == 0) {
+  DestinationState &state = GetDestination(addr);
+  NS_ASSERT_MSG(!state.m_held, "No recursive locks");
+  if (CanStartAeo(state)) {
     // The locking loop, we need to do this by sending data eventually
     for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); i++) {
       Ptr<NetDevice> device = m_ipv4->GetNetDevice(i);
@@ -1336,7 +2343,7 @@ Ipv4GlobalRouting::LocalLock (Ipv4Address addr)
         return false;
       }
     }
-    m_held[addr] = true;
+    state.m_held = true;
     return true;
   }
   return false;
@@ -1346,7 +2353,33 @@ Ipv4GlobalRouting::LocalLock (Ipv4Address addr)
 void
 Ipv4GlobalRouting::LocalUnlock (Ipv4Address addr)
 {
-  NS_ASSERT_MSG(m_held[addr], "Don't release unheld locks");
+  DestinationState &state = GetDestination(addr);
+  NS_ASSERT_MSG(state.m_held, "Don't release unheld locks");
+  if (m_ddcMessages) {
+    PendingAeos::iterator pending = m_pendingAeos.find(state.m_address);
+    NS_ASSERT(pending != m_pendingAeos.end());
+    for (uint32_t i = 1; i < pending->second.m_replies.size(); i++) {
+      if (pending->second.m_replies[i] == Granted) {
+        SendDdc(i, DdcMessageHeader::Unlock, state.m_address, 0);
+      }
+    }
+    m_pendingAeos.erase(pending);
+    state.m_held = false;
+    for (std::vector<uint32_t>::iterator it = state.m_reverseAfter.begin(); it != state.m_reverseAfter.end(); it++) {
+      SendDdc(*it, DdcMessageHeader::Heartbeat, state.m_address, state.m_heartbeatSequence);
+    }
+    return;
+  }
+  if (m_batchHeartbeats) {
+    for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); i++) {
+      Notify(i, false, addr, 0);
+    }
+    state.m_held = false;
+    for (std::vector<uint32_t>::iterator it = state.m_reverseAfter.begin(); it != state.m_reverseAfter.end(); it++) {
+      Notify(*it, true, addr, state.m_heartbeatSequence);
+    }
+    return;
+  }
   for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); i++) {
     Ptr<NetDevice> device = m_ipv4->GetNetDevice(i);
     Ptr<Channel> channel = device->GetChannel();
@@ -1356,8 +2389,8 @@ Ipv4GlobalRouting::LocalUnlock (Ipv4Address addr)
     Ptr<Ipv4GlobalRouting> rtr = otherNode->GetObject<GlobalRouter>()->GetRoutingProtocol();
     Simulator::ScheduleNow(&Ipv4GlobalRouting::Unlock, rtr, addr, other); //rtr->Unlock(addr, other);
   }
-  m_held[addr] = false;
-  for (std::vector<uint32_t>::iterator it = m_reverseAfter[addr].begin(); it != m_reverseAfter[addr].end(); it++) {
+  state.m_held = false;
+  for (std::vector<uint32_t>::iterator it = state.m_reverseAfter.begin(); it != state.m_reverseAfter.end(); it++) {
     Ptr<NetDevice> device = m_ipv4->GetNetDevice(*it);
     Ptr<Channel> channel = device->GetChannel();
     Ptr<NetDevice> other = (channel->GetDevice(0) == device ? channel->GetDevice(1) : channel->GetDevice(0));
@@ -1365,35 +2398,49 @@ Ipv4GlobalRouting::LocalUnlock (Ipv4Address addr)
     Ptr<Node> otherNode = other->GetNode();
     Ptr<Ipv4GlobalRouting> rtr = otherNode->GetObject<GlobalRouter>()->GetRoutingProtocol();
     //NS_LOG_LOGIC("Sending heartbeat for " << addr << " to " << otherNode->GetId() << " from " <<  m_ipv4->GetNetDevice(0)->GetNode()->GetId());
-    Simulator::ScheduleNow(&Ipv4GlobalRouting::ReceiveHeartbeat, rtr, m_heartbeatSequence[addr], addr, other); //rtr->ReceiveHeartbeat(addr, other);
+    Simulator::ScheduleNow(&Ipv4GlobalRouting::ReceiveHeartbeat, rtr, state.m_heartbeatSequence, addr, other); //rtr->ReceiveHeartbeat(addr, other);
   }
 }
 
 // @apanda
-void 
+void
 Ipv4GlobalRouting::SetRemoteVnode (Ipv4Address addr, uint32_t interface, uint8_t vnode)
 {
-  NS_ASSERT_MSG(m_locks[addr][interface], "Don't set remote vnode without holding lock");
-  m_remoteVnode[addr][interface] = vnode;
-  if (m_vnodeState[m_localVnode[addr]].m_directions[addr][interface] != In) {
-    m_vnodeState[m_localVnode[addr]].m_inputs[addr].push_front(interface);
-  }
-  m_vnodeState[m_localVnode[addr]].m_directions[addr][interface] = In;
-  m_vnodeState[m_localVnode[addr]].m_localSeq[addr][interface] = 0;
-  m_vnodeState[m_localVnode[addr]].m_remoteSeq[addr][interface] = 0;
+  DestinationState &state = GetDestination(addr);
+  LinkState &link = state.m_links[interface];
+  NS_ASSERT_MSG(link.IsLocked(), "Don't set remote vnode without holding lock");
+  // The vnode we were on when the lock was granted; with more than two
+  // vnodes we may have moved past it since
+  uint8_t localVnode = link.m_lockedVnode;
+  link.m_remoteVnode = vnode;
+  LinkSetRemove(GetLinkSet(state, localVnode, OutputLinks), link.m_rank);
+  LinkSetAdd(GetLinkSet(state, localVnode, InputLinks), link.m_rank);
+  link.SetDirection(localVnode, In);
+  link.SetLocalSeq(localVnode, 0);
+  link.SetRemoteSeq(localVnode, 0);
 }
 
 // @apanda
-void 
+void
 Ipv4GlobalRouting::SetRemoteVnode (Ipv4Address addr, Ptr<NetDevice> interface, uint8_t vnode)
 {
   SetRemoteVnode(addr, m_ipv4->GetInterfaceForDevice(interface), vnode);
 }
 
 // @apanda
-void 
+void
 Ipv4GlobalRouting::LocalSetRemoteVnode (Ipv4Address addr, uint32_t link, uint8_t vnode)
 {
+  if (m_ddcMessages) {
+    // Only neighbours that granted the lock expect the update
+    DestinationState &state = GetDestination(addr);
+    PendingAeos::iterator pending = m_pendingAeos.find(state.m_address);
+    NS_ASSERT(pending != m_pendingAeos.end());
+    if (link < pending->second.m_replies.size() && pending->second.m_replies[link] == Granted) {
+      SendDdc(link, DdcMessageHeader::Vnode, state.m_address, vnode);
+    }
+    return;
+  }
   Ptr<NetDevice> device = m_ipv4->GetNetDevice(link);
   Ptr<Channel> channel = device->GetChannel();
   Ptr<NetDevice> other = (channel->GetDevice(0) == device ? channel->GetDevice(1) : channel->GetDevice(0));
@@ -1404,33 +2451,27 @@ Ipv4GlobalRouting::LocalSetRemoteVnode (Ipv4Address addr, uint32_t link, uint8_t
 }
 
 // @apanda
-void 
-Ipv4GlobalRouting::SetReversalOrder (Ipv4Address addr, const std::list<uint32_t>& interfaces) 
+void
+Ipv4GlobalRouting::SetReversalOrder (Ipv4Address addr, const std::list<uint32_t>& interfaces)
 {
   //NS_LOG_FUNCTION(this << addr);
   //NS_LOG_LOGIC("SetReversalOrder " << addr << " node = " << m_ipv4->GetNetDevice(0)->GetNode()->GetId());
-  std::list<uint32_t>::const_iterator it;
-  for (it = interfaces.begin(); 
-       it != interfaces.end(); it++) {
-    //NS_LOG_LOGIC("Vector " << *it);
+  DestinationState &state = GetDestination(addr);
+  if (state.m_reversalOrderSet) {
+    // The first order computed for a destination sticks
+    return;
   }
-
-  for (it = interfaces.begin(); 
+  std::list<uint32_t>::const_iterator it;
+  for (it = interfaces.begin();
        it != interfaces.end() && (*it) != 0; it++) {
     //NS_LOG_LOGIC("Considering " << *it);
   }
   NS_ASSERT(it !=  interfaces.end());
-  m_reverseBefore.insert(LinkOrder::value_type(addr, std::vector<uint32_t>(interfaces.begin(), it)));
+  state.m_reverseBefore.assign(interfaces.begin(), it);
   NS_ASSERT(*it == 0);
   it++;
-  //NS_LOG_LOGIC("Now at iface = " << *it);
-  if (it != interfaces.end()) {
-    //NS_LOG_LOGIC("Interface = " << *it);
-  }
-  else {
-    //NS_LOG_LOGIC("Inteface end of the line");
-  }
-  m_reverseAfter.insert(LinkOrder::value_type(addr, std::vector<uint32_t>(it, interfaces.end())));
+  state.m_reverseAfter.assign(it, interfaces.end());
+  state.m_reversalOrderSet = true;
 }
 
 // @apanda
@@ -1439,21 +2480,496 @@ Ipv4GlobalRouting::SendInitialHeartbeat (Ipv4Address addr)
 {
   //NS_LOG_FUNCTION(this << addr);
   //NS_LOG_LOGIC("Initial heartbeat for address = " << addr << " from node = " << m_ipv4->GetNetDevice(0)->GetNode()->GetId());
-  for (std::vector<uint32_t>::iterator it = m_reverseBefore[addr].begin();
-       it != m_reverseBefore[addr].end(); it++) {
-    //NS_LOG_LOGIC("REVERSE BEFORE NOT EMPTY: " << *it);
-  }
-  NS_ASSERT(m_reverseBefore[addr].empty());
-  m_heartbeatSequence[addr]++;
-  m_heartbeatState[addr][0] = true;
+  DestinationState &state = GetDestination(addr);
+  NS_ASSERT(state.m_reverseBefore.empty());
+  state.m_heartbeatSequence++;
+  state.m_links[0].m_heartbeat = true;
   PrimitiveAEO(addr);
 }
 
 // @apanda
-void 
+void
+Ipv4GlobalRouting::SendInitialHeartbeats (std::vector<Ipv4Address> destinations)
+{
+  for (std::vector<Ipv4Address>::iterator it = destinations.begin(); it != destinations.end(); it++) {
+    SendInitialHeartbeat(*it);
+  }
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::GetBatchHeartbeats (void) const
+{
+  return m_batchHeartbeats;
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::IsOutputLink (Ipv4Address dest, uint32_t interface)
+{
+  DestinationState *state = FindDestination(dest);
+  if (state == 0 || interface >= state->m_links.size()) {
+    return false;
+  }
+  return state->m_links[interface].GetDirection(state->m_localVnode) == Out;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::Notify (uint32_t iface, bool heartbeat, Ipv4Address addr, uint32_t seq)
+{
+  if (m_notifications.size() <= iface) {
+    m_notifications.resize(m_ipv4->GetNInterfaces());
+    m_notificationEvents.resize(m_ipv4->GetNInterfaces());
+  }
+  Notification notification;
+  notification.m_destination = addr;
+  notification.m_sequence = seq;
+  notification.m_heartbeat = heartbeat;
+  m_notifications[iface].push_back(notification);
+  if (!m_notificationEvents[iface].IsRunning()) {
+    // Everything queued until the event runs goes along, in order, so an
+    // unlock still reaches the neighbour before the heartbeat that follows it
+    m_notificationEvents[iface] = Simulator::ScheduleNow(&Ipv4GlobalRouting::DeliverNotifications, this, iface);
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::DeliverNotifications (uint32_t iface)
+{
+  Notifications notifications;
+  notifications.swap(m_notifications[iface]);
+  Ptr<NetDevice> device = m_ipv4->GetNetDevice(iface);
+  Ptr<Channel> channel = device->GetChannel();
+  Ptr<NetDevice> other = (channel->GetDevice(0) == device ? channel->GetDevice(1) : channel->GetDevice(0));
+  NS_ASSERT(other != device);
+  Ptr<Node> otherNode = other->GetNode();
+  Ptr<Ipv4GlobalRouting> rtr = otherNode->GetObject<GlobalRouter>()->GetRoutingProtocol();
+  rtr->ReceiveNotifications(other, notifications);
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::ReceiveNotifications (Ptr<NetDevice> link, const Notifications &notifications)
+{
+  uint32_t iface = m_ipv4->GetInterfaceForDevice(link);
+  for (Notifications::const_iterator it = notifications.begin(); it != notifications.end(); it++) {
+    if (it->m_heartbeat) {
+      HandleHeartbeat(it->m_sequence, it->m_destination, iface);
+    }
+    else {
+      SimpleUnlock(it->m_destination, iface);
+    }
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::SendDdc (uint32_t interface, uint8_t type, Ipv4Address addr, uint32_t value)
+{
+  if (!IsLinkUp(interface)) {
+    return;
+  }
+  if (m_ddcOutgoing.size() <= interface) {
+    m_ddcOutgoing.resize(m_ipv4->GetNInterfaces());
+    m_ddcFlush.resize(m_ipv4->GetNInterfaces());
+  }
+  DdcMessageHeader::Entry entry;
+  entry.m_type = type;
+  entry.m_destination = addr;
+  entry.m_value = value;
+  m_ddcOutgoing[interface].push_back(entry);
+  if (!m_ddcFlush[interface].IsRunning()) {
+    m_ddcFlush[interface] = Simulator::Schedule(m_ddcBatchDelay, &Ipv4GlobalRouting::FlushDdc, this, interface);
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::FlushDdc (uint32_t interface)
+{
+  std::vector<DdcMessageHeader::Entry> entries;
+  entries.swap(m_ddcOutgoing[interface]);
+  Ptr<NetDevice> device = m_ipv4->GetNetDevice(interface);
+  uint32_t perMessage = (device->GetMtu() - DdcMessageHeader::GetFixedSize()) / DdcMessageHeader::GetEntrySize();
+  NS_ASSERT_MSG(perMessage > 0, "MTU too small for DDC messages");
+  perMessage = std::min<uint32_t>(perMessage, 0xffff);
+  for (uint32_t first = 0; first < entries.size(); first += perMessage) {
+    DdcMessageHeader header;
+    header.SetSender(m_nodeId);
+    uint32_t last = std::min<uint32_t>(first + perMessage, entries.size());
+    for (uint32_t i = first; i < last; i++) {
+      header.AddEntry(entries[i].m_type, entries[i].m_destination, entries[i].m_value);
+    }
+    Ptr<Packet> packet = Create<Packet>();
+    packet->AddHeader(header);
+    PriorityTag tag;
+    tag.SetPriority(m_ddcPriority);
+    packet->AddPacketTag(tag);
+    uint32_t bytes = packet->GetSize();
+    if (device->Send(packet, device->GetBroadcast(), DDC_PROTOCOL)) {
+      m_ddcMessagesSent++;
+      m_ddcMessageBytesSent += bytes;
+      m_ddcMessageTrace(interface, last - first, bytes);
+    }
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::ReceiveDdc (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol,
+                               const Address &from, const Address &to, NetDevice::PacketType packetType)
+{
+  int32_t iface = m_ipv4->GetInterfaceForDevice(device);
+  if (iface <= 0) {
+    return;
+  }
+  DdcMessageHeader header;
+  p->Copy()->RemoveHeader(header);
+  for (uint32_t i = 0; i < header.GetNEntries(); i++) {
+    const DdcMessageHeader::Entry &entry = header.GetEntry(i);
+    switch (entry.m_type) {
+      case DdcMessageHeader::LockRequest:
+        {
+          // While our own request is out, the lower node ID wins
+          DestinationState &state = GetDestination(entry.m_destination);
+          bool pending = m_pendingAeos.find(state.m_address) != m_pendingAeos.end();
+          bool granted = !(pending && header.GetSender() > m_nodeId) && SimpleLock(state.m_address, iface);
+          SendDdc(iface, granted ? DdcMessageHeader::LockGrant : DdcMessageHeader::LockDeny, state.m_address, 0);
+        }
+        break;
+      case DdcMessageHeader::LockGrant:
+      case DdcMessageHeader::LockDeny:
+        ReceiveLockReply(entry.m_destination, iface, entry.m_type == DdcMessageHeader::LockGrant);
+        break;
+      case DdcMessageHeader::Unlock:
+        SimpleUnlock(entry.m_destination, iface);
+        break;
+      case DdcMessageHeader::Vnode:
+        SetRemoteVnode(entry.m_destination, iface, entry.m_value);
+        break;
+      case DdcMessageHeader::Heartbeat:
+        HandleHeartbeat(entry.m_value, entry.m_destination, iface);
+        break;
+      default:
+        NS_LOG_WARN("Unknown DDC message entry " << (uint32_t)entry.m_type);
+    }
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::RequestLocks (Ipv4Address addr)
+{
+  DestinationState &state = GetDestination(addr);
+  if (m_pendingAeos.find(state.m_address) != m_pendingAeos.end()) {
+    // Retried by CompleteLocks ()
+    return;
+  }
+  if (!CanStartAeo(state)) {
+    // Retried by SimpleUnlock ()
+    NoteAeoDeferred(state);
+    return;
+  }
+  PendingAeo &pending = m_pendingAeos[state.m_address];
+  pending.m_outstanding = 0;
+  pending.m_denied = false;
+  pending.m_replies.assign(m_ipv4->GetNInterfaces(), NoRequest);
+  for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); i++) {
+    if (IsLinkUp(i)) {
+      pending.m_replies[i] = AwaitingReply;
+      pending.m_outstanding++;
+      SendDdc(i, DdcMessageHeader::LockRequest, state.m_address, 0);
+    }
+  }
+  if (pending.m_outstanding == 0) {
+    CompleteLocks(state.m_address);
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::ReceiveLockReply (Ipv4Address addr, uint32_t iface, bool granted)
+{
+  PendingAeos::iterator it = m_pendingAeos.find(GetDestination(addr).m_address);
+  if (it == m_pendingAeos.end() || iface >= it->second.m_replies.size() ||
+      it->second.m_replies[iface] != AwaitingReply) {
+    return;
+  }
+  PendingAeo &pending = it->second;
+  pending.m_replies[iface] = granted ? Granted : Denied;
+  pending.m_denied |= !granted;
+  if (--pending.m_outstanding == 0) {
+    CompleteLocks(it->first);
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::CompleteLocks (Ipv4Address addr)
+{
+  DestinationState &state = GetDestination(addr);
+  PendingAeos::iterator it = m_pendingAeos.find(state.m_address);
+  NS_ASSERT(it != m_pendingAeos.end());
+  if (!it->second.m_denied && CanStartAeo(state)) {
+    // LocalUnlock () releases the neighbours and drops the pending entry
+    state.m_held = true;
+    FinishAEO(state.m_address);
+    return;
+  }
+  for (uint32_t i = 1; i < it->second.m_replies.size(); i++) {
+    if (it->second.m_replies[i] == Granted) {
+      SendDdc(i, DdcMessageHeader::Unlock, state.m_address, 0);
+    }
+  }
+  m_pendingAeos.erase(it);
+  // A neighbour holding our lock retries through SimpleUnlock (); if it has
+  // let go already, retry now
+  NoteAeoDeferred(state);
+  if (CanStartAeo(state)) {
+    Simulator::ScheduleNow(&Ipv4GlobalRouting::PrimitiveAEO, this, state.m_address);
+  }
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::ReleaseDdcLink (uint32_t iface)
+{
+  if (iface < m_ddcOutgoing.size()) {
+    m_ddcOutgoing[iface].clear();
+  }
+  // The neighbour cannot unlock us anymore
+  for (uint32_t d = 0; d < m_destinations.size(); d++) {
+    if (iface < m_destinations[d].m_links.size() && m_destinations[d].m_links[iface].IsLocked()) {
+      SimpleUnlock(m_destinations[d].m_address, iface);
+    }
+  }
+  // Nor send its heartbeat, which might be all the destination waits for
+  for (uint32_t d = 0; d < m_destinations.size(); d++) {
+    DestinationState &state = m_destinations[d];
+    if (std::find(state.m_reverseBefore.begin(), state.m_reverseBefore.end(), iface) == state.m_reverseBefore.end()) {
+      continue;
+    }
+    if (state.m_heartbeatSequence < m_heartbeatRound) {
+      UpdateHeartbeat(m_heartbeatRound, state.m_address);
+    }
+    if (!state.m_links[0].m_heartbeat) {
+      CheckAndAEO(state.m_address, iface);
+    }
+  }
+  // Nor answer our requests
+  std::vector<Ipv4Address> complete;
+  for (PendingAeos::iterator it = m_pendingAeos.begin(); it != m_pendingAeos.end(); it++) {
+    PendingAeo &pending = it->second;
+    if (iface < pending.m_replies.size() && pending.m_replies[iface] == AwaitingReply) {
+      pending.m_replies[iface] = NoRequest;
+      if (--pending.m_outstanding == 0) {
+        complete.push_back(it->first);
+      }
+    }
+  }
+  for (std::vector<Ipv4Address>::iterator it = complete.begin(); it != complete.end(); it++) {
+    CompleteLocks(*it);
+  }
+}
+
+// @apanda
+bool
+Ipv4GlobalRouting::HeardHeartbeat (const DestinationState &state, uint32_t iface) const
+{
+  return state.m_links[iface].m_heartbeat || (m_ddcMessages && !IsLinkUp(iface));
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::BeginHeartbeatRound (void)
+{
+  m_heartbeatRound++;
+  if (!m_ddcMessages) {
+    return;
+  }
+  for (uint32_t d = 0; d < m_destinations.size(); d++) {
+    DestinationState &state = m_destinations[d];
+    if (state.m_reverseBefore.empty()) {
+      // The destination itself, SendInitialHeartbeat () starts it
+      continue;
+    }
+    bool dead = true;
+    for (std::vector<uint32_t>::iterator it = state.m_reverseBefore.begin(); it != state.m_reverseBefore.end(); it++) {
+      dead &= !IsLinkUp(*it);
+    }
+    if (dead) {
+      UpdateHeartbeat(m_heartbeatRound, state.m_address);
+      CheckAndAEO(state.m_address, state.m_reverseBefore.front());
+    }
+  }
+}
+
+// @apanda
+uint64_t
+Ipv4GlobalRouting::GetDdcMessagesSent (void) const
+{
+  return m_ddcMessagesSent;
+}
+
+// @apanda
+uint64_t
+Ipv4GlobalRouting::GetDdcMessageBytesSent (void) const
+{
+  return m_ddcMessageBytesSent;
+}
+
+// @apanda
+uint64_t
+Ipv4GlobalRouting::GetAeosDeferred (void) const
+{
+  return m_aeosDeferred;
+}
+
+// @apanda
+Time
+Ipv4GlobalRouting::GetAeoDeferralTime (void) const
+{
+  return m_aeoDeferralTime;
+}
+
+// @apanda
+uint64_t
+Ipv4GlobalRouting::GetReversalsSuppressed (void) const
+{
+  return m_reversalsSuppressed;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::RecordStretch (const Ipv4Header &header)
+{
+  if (!m_recordStretch) {
+    return;
+  }
+  uint32_t source;
+  if (!GlobalRouteManager::FindAddressNode(header.GetSource(), source)) {
+    return;
+  }
+  uint16_t shortest = GlobalRouteManager::GetDistance(source, m_nodeId);
+  if (shortest == 0 || shortest == 0xffff) {
+    return;
+  }
+  if (m_initialTtl == 0) {
+    // Read once the simulation runs, scenarios set it after installing
+    UintegerValue ttl;
+    m_ipv4->GetObject<Ipv4L3Protocol>()->GetAttribute("DefaultTtl", ttl);
+    m_initialTtl = ttl.Get();
+  }
+  // The source does not decrement the TTL, every later hop but the last does
+  uint32_t hops = m_initialTtl - header.GetTtl() + 1;
+  double stretch = (double)hops / shortest;
+  m_stretchPackets++;
+  m_stretchSum += stretch;
+  m_stretchMax = std::max(m_stretchMax, stretch);
+  m_stretchTrace(header.GetSource(), hops, shortest);
+}
+
+// @apanda
+uint64_t
+Ipv4GlobalRouting::GetStretchPackets (void) const
+{
+  return m_stretchPackets;
+}
+
+// @apanda
+double
+Ipv4GlobalRouting::GetMeanStretch (void) const
+{
+  return m_stretchPackets == 0 ? 0 : m_stretchSum / m_stretchPackets;
+}
+
+// @apanda
+double
+Ipv4GlobalRouting::GetMaxStretch (void) const
+{
+  return m_stretchMax;
+}
+
+// @apanda
+void
 Ipv4GlobalRouting::AddReversalCallback (Callback<void, uint32_t, Ipv4Address> callback)
 {
   m_reversalCallback.ConnectWithoutContext(callback);
 }
 
+// @apanda
+void
+Ipv4GlobalRouting::SaveState (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_saved.m_destinationIndex = m_destinationIndex;
+  m_saved.m_destinations = m_destinations;
+  m_saved.m_linkUp = m_linkUp;
+  for (int i = 0; i < MAX_VNODES; i++) {
+    m_saved.m_toReverseEpoch[i] = m_toReverseEpoch[i];
+  }
+  m_saved.m_heartbeatRound = m_heartbeatRound;
+  m_saved.m_reversalOrder = m_reversalOrder;
+  m_saved.m_ddcMessagesSent = m_ddcMessagesSent;
+  m_saved.m_ddcMessageBytesSent = m_ddcMessageBytesSent;
+  m_saved.m_aeosDeferred = m_aeosDeferred;
+  m_saved.m_aeoDeferralTime = m_aeoDeferralTime;
+  m_saved.m_reversalsSuppressed = m_reversalsSuppressed;
+  m_saved.m_stretchPackets = m_stretchPackets;
+  m_saved.m_stretchSum = m_stretchSum;
+  m_saved.m_stretchMax = m_stretchMax;
+  m_saved.m_nextHopBytes = m_nextHopBytes;
+  m_stateSaved = true;
+}
+
+// @apanda
+void
+Ipv4GlobalRouting::RestoreState (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_stateSaved, "RestoreState () without SaveState ()");
+  m_reversalEvent.Cancel ();
+  m_reversals[0].clear ();
+  m_reversals[1].clear ();
+  m_queuedReversals.clear ();
+  m_pendingAeos.clear ();
+  for (uint32_t i = 0; i < m_ddcFlush.size (); i++) {
+    m_ddcFlush[i].Cancel ();
+  }
+  for (uint32_t i = 0; i < m_ddcOutgoing.size (); i++) {
+    m_ddcOutgoing[i].clear ();
+  }
+  for (uint32_t i = 0; i < m_notificationEvents.size (); i++) {
+    m_notificationEvents[i].Cancel ();
+  }
+  for (uint32_t i = 0; i < m_notifications.size (); i++) {
+    m_notifications[i].clear ();
+  }
+
+  m_destinationIndex = m_saved.m_destinationIndex;
+  m_destinations = m_saved.m_destinations;
+  m_linkUp = m_saved.m_linkUp;
+  for (int i = 0; i < MAX_VNODES; i++) {
+    m_toReverseEpoch[i] = m_saved.m_toReverseEpoch[i];
+  }
+  m_heartbeatRound = m_saved.m_heartbeatRound;
+  m_reversalOrder = m_saved.m_reversalOrder;
+  m_ddcMessagesSent = m_saved.m_ddcMessagesSent;
+  m_ddcMessageBytesSent = m_saved.m_ddcMessageBytesSent;
+  m_aeosDeferred = m_saved.m_aeosDeferred;
+  m_aeoDeferralTime = m_saved.m_aeoDeferralTime;
+  m_reversalsSuppressed = m_saved.m_reversalsSuppressed;
+  m_stretchPackets = m_saved.m_stretchPackets;
+  m_stretchSum = m_saved.m_stretchSum;
+  m_stretchMax = m_saved.m_stretchMax;
+  m_nextHopBytes = m_saved.m_nextHopBytes;
+
+  // Cached routes are rebuilt on demand from the restored state
+  m_linkRoutes.clear ();
+  m_localRoutes.clear ();
+  ClearEntryRoutes ();
+}
+
 } // namespace ns3
@@ -22,10 +22,13 @@
 
 #include <list>
 #include <map>
+#include <set>
 #include <vector>
 #include <utility>
 #include <functional>
 #include <queue>
+#include <deque>
+#include <algorithm>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4-header.h"
@@ -38,6 +41,11 @@
 #include "ns3/node.h"
 #include "ns3/global-router-interface.h"
 #include "ns3/traced-callback.h"
+#include "ns3/sgi-hashmap.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ddc-message-header.h"
 
 namespace ns3 {
 
@@ -49,6 +57,35 @@ class Ipv4Header;
 class Ipv4RoutingTableEntry;
 class Ipv4MulticastRoutingTableEntry;
 
+/**
+ * @apanda
+ * Maps addresses onto the address whose DDC state they share.  One table is
+ * shared by every Ipv4GlobalRouting of a simulation.
+ */
+class Ipv4DestinationAliases : public SimpleRefCount<Ipv4DestinationAliases>
+{
+public:
+/**
+ * @apanda
+ * Keep the DDC state of alias under dest
+ */
+  void Add (Ipv4Address alias, Ipv4Address dest);
+
+/**
+ * @apanda
+ * Address the DDC state of addr is kept under, addr itself if it has no alias
+ */
+  Ipv4Address Resolve (Ipv4Address addr) const;
+
+/**
+ * @apanda
+ * Number of aliased addresses
+ */
+  uint32_t GetN (void) const;
+private:
+  typedef sgi::hash_map<Ipv4Address, Ipv4Address, Ipv4AddressHash> AliasMap;
+  AliasMap m_aliases;
+};
 
 /**
  * \brief Global routing protocol for IP version 4 stacks.
@@ -106,7 +143,7 @@ public:
                             UnicastForwardCallback ucb, MulticastForwardCallback mcb,
                             LocalDeliverCallback lcb, ErrorCallback ecb);
 
-  virtual Ptr<Ipv4Route> LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif = 0);
+  virtual Ptr<Ipv4Route> LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif = 0, uint32_t flowHash = 0);
 
   virtual void NotifyInterfaceUp (uint32_t interface);
   virtual void NotifyInterfaceDown (uint32_t interface);
@@ -234,6 +271,31 @@ public:
  */
   void RemoveRoute (uint32_t i);
 
+/**
+ * @apanda
+ * Bring the global routes of this node in line with the given host,
+ * network and AS external routes.  Entries that are still wanted stay
+ * where they are, so an ECMP group that loses or gains a next hop keeps its
+ * other members; only the entries that differ are removed or added.
+ *
+ * \return The number of entries removed plus the number added.
+ */
+  uint32_t UpdateRoutes (const std::vector<Ipv4RoutingTableEntry> &hostRoutes,
+                         const std::vector<Ipv4RoutingTableEntry> &networkRoutes,
+                         const std::vector<Ipv4RoutingTableEntry> &externalRoutes);
+
+/**
+ * @apanda
+ * Remove every host route to a destination, returns how many were removed
+ */
+  uint32_t RemoveHostRoutesTo (Ipv4Address dest);
+
+/**
+ * @apanda
+ * Remove every network route to a prefix, returns how many were removed
+ */
+  uint32_t RemoveNetworkRoutesTo (Ipv4Address network, Ipv4Mask networkMask);
+
 /** 
  * @apanda
  * Primitive AEO operation, for control plane and such
@@ -242,10 +304,19 @@ public:
 
 /**
  * @apanda
- * Set link priority, higher is better
+ * Set link priority, lower is better
  */
  void SetInterfacePriority(Ipv4Address dest, uint32_t interface, uint32_t priority);
 
+/**
+ * @apanda
+ * Set the cost from the neighbour behind interface to dest.  With the
+ * DistanceRanking attribute, links of equal priority rank by this cost, and
+ * the route manager updates it as links go down; ignored otherwise.
+ */
+  void SetInterfaceDistance (Ipv4Address dest, uint32_t interface, uint16_t distance);
+  bool GetDistanceRanking (void) const;
+
 /**
  * @apanda
  * Set reversal order
@@ -258,25 +329,133 @@ public:
  */
   void SendInitialHeartbeat (Ipv4Address);
 
+/**
+ * @apanda
+ * A new round of heartbeats starts.  With DdcMessages, destinations that
+ * will not hear it because every link earlier in their reversal order is
+ * down run their AEO right away.
+ */
+  void BeginHeartbeatRound (void);
+
+/**
+ * @apanda
+ * SendInitialHeartbeat () for several destinations in one event
+ */
+  void SendInitialHeartbeats (std::vector<Ipv4Address> destinations);
+
+/**
+ * @apanda
+ * Whether unlocks and heartbeats for a neighbour are delivered in batches,
+ * see the BatchHeartbeats attribute
+ */
+  bool GetBatchHeartbeats (void) const;
+
+/**
+ * @apanda
+ * Whether interface is an output link toward dest in the current DDC vnode
+ */
+  bool IsOutputLink (Ipv4Address dest, uint32_t interface);
+
 /**
  * @apanda
  * Set reversal callback
  */
  void AddReversalCallback (Callback<void, uint32_t, Ipv4Address>);
-protected:
-  void DoDispose (void);
 
 /**
  * @apanda
- * Find highest priority output port to send messages out of
+ * Bytes of the packets this node forwarded through an interface, for both
+ * the data plane and DDC.  Packets originating here are not counted since
+ * RouteOutput may be asked more than once for the same packet.
  */
- bool FindOutputPort (uint8_t, Ipv4Address addr, uint32_t &link, uint32_t iif);  
+  uint64_t GetNextHopBytes (uint32_t interface) const;
 
 /**
  * @apanda
- * Find highest priority live link
+ * Share DDC state between the addresses aliases maps onto one another, so
+ * that for instance all addresses of a node reverse as one DAG.  Only
+ * affects destinations whose state is created afterwards; 0 turns it off.
+ */
+  void SetDestinationAliases (Ptr<const Ipv4DestinationAliases> aliases);
+
+/**
+ * @apanda
+ * Number of destinations this node keeps DDC state for
  */
- bool FindHighPriorityLink (uint8_t, Ipv4Address address, uint32_t &link);
+  uint32_t GetNDestinations (void) const;
+
+/**
+ * @apanda
+ * Make room for the state of n destinations up front.  States are created
+ * on first use, and growing the table one destination at a time would copy
+ * every state already there each time it fills up.
+ */
+  void ReserveDestinations (uint32_t n);
+
+/**
+ * @apanda
+ * Bytes of DDC state this node holds: the destination table and index and
+ * the per-interface state of every destination.  Also the DdcMemoryUsage
+ * attribute.
+ */
+  uint64_t GetDdcMemoryUsage (void) const;
+
+/**
+ * @apanda
+ * Number and bytes of the DDC messages this node sent, see the DdcMessages
+ * attribute
+ */
+  uint64_t GetDdcMessagesSent (void) const;
+  uint64_t GetDdcMessageBytesSent (void) const;
+
+/**
+ * @apanda
+ * AEOs that could not start right away because neighbours still held locks
+ * on the vnode they needed, and the total time they waited
+ */
+  uint64_t GetAeosDeferred (void) const;
+  Time GetAeoDeferralTime (void) const;
+
+/**
+ * @apanda
+ * Delayed reversals that were dropped because the same reversal of the same
+ * link was already waiting
+ */
+  uint64_t GetReversalsSuppressed (void) const;
+
+/**
+ * @apanda
+ * Stretch of the unicast packets delivered to this node while the
+ * RecordStretch attribute is set: hops taken over the hops of the shortest
+ * path from the source.  Assumes every node uses the same DefaultTtl and
+ * links have unit metrics.
+ */
+  uint64_t GetStretchPackets (void) const;
+  double GetMeanStretch (void) const;
+  double GetMaxStretch (void) const;
+
+/**
+ * @apanda
+ * Keep a copy of the DDC state of every destination, the link states and
+ * the counters above, so RestoreState () can go back to it.  Routing table
+ * entries are not copied: they only change with RespondToInterfaceEvents.
+ */
+  void SaveState (void);
+
+/**
+ * @apanda
+ * Go back to the state kept by SaveState (), dropping queued reversals and
+ * DDC messages and cancelling their events.  Packets already on the links
+ * are not recalled, so restore once the simulator ran out of events.
+ */
+  void RestoreState (void);
+
+  /// @apanda Ethertype of DDC messages (IEEE local experimental)
+  static const uint16_t DDC_PROTOCOL = 0x88b5;
+  /// @apanda Largest value of the Vnodes attribute
+  static const uint8_t MAX_VNODES = 4;
+protected:
+  void DoDispose (void);
 
 /**
  * @apanda
@@ -298,28 +477,32 @@ protected:
 
 /**
  * @apanda
- * Send on outlink
+ * Which of the two reversals a queued reversal is; also indexes the queues
  */
-  void SendOnOutlink (uint8_t, Ipv4Address addr, Ipv4Header& header, uint32_t link);
+  enum ReversalKind {
+    ToOutput = 0,
+    ToInput = 1
+  };
 
 /**
  * @apanda
- * Standard receive
+ * Reverse link of addr after the delay of kind.  A reversal of the same
+ * link that is already waiting covers this one.
  */
-  void StandardReceive (Ipv4Address addr, Ipv4Header& header,
-                       Ptr<Ipv4Route>& route, Socket::SocketErrno& error, uint32_t iif);
+  void QueueReversal (ReversalKind kind, uint8_t vnode, Ipv4Address addr, uint32_t link);
 
 /**
  * @apanda
- * Create a generic routing entry, and prepare the header
+ * Run the queued reversals that are due, and arm the event for the next one
  */
-  void CreateRoutingEntry (uint8_t, uint32_t link, Ipv4Address addr, Ipv4Header& header, Ptr<Ipv4Route> &route);
+  void RunReversals (void);
 
 /**
  * @apanda
- * Schedule reversals
+ * Standard receive
  */
-  void ScheduleReversals(uint8_t, Ipv4Address addr);
+  void StandardReceive (Ipv4Address addr, Ipv4Header& header,
+                       Ptr<Ipv4Route>& route, Socket::SocketErrno& error, uint32_t iif);
 
 /**
  * @apanda
@@ -393,6 +576,8 @@ private:
 
 /**
  * @apanda
+ * Forget the directions and link sets of a vnode before an AEO moves onto
+ * it.  Resets the existing state in place, nothing is allocated.
  */
   void ClearVnode(uint8_t vnode, Ipv4Address addr);
 
@@ -402,17 +587,106 @@ private:
  */
   void UpdateHeartbeat(uint32_t, Ipv4Address);
 
-  /// @apanda Link direction for DDC
+/**
+ * @apanda
+ * The part of PrimitiveAEO () that runs once the neighbours are locked
+ */
+  void FinishAEO (Ipv4Address);
+
+/**
+ * @apanda
+ * Heartbeat for addr from the neighbour on interface iface
+ */
+  void HandleHeartbeat (uint32_t seq, Ipv4Address addr, uint32_t iface);
+
+/**
+ * @apanda
+ * With DdcMessages, queue an entry for the neighbour on interface, to be
+ * sent with the other entries queued for it in the same batch
+ */
+  void SendDdc (uint32_t interface, uint8_t type, Ipv4Address addr, uint32_t value);
+
+/**
+ * @apanda
+ * Send the entries queued for interface, in as few packets as the MTU allows
+ */
+  void FlushDdc (uint32_t interface);
+
+/**
+ * @apanda
+ * Protocol handler for DDC messages
+ */
+  void ReceiveDdc (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol,
+                   const Address &from, const Address &to, NetDevice::PacketType packetType);
+
+/**
+ * @apanda
+ * Ask every live neighbour for the lock on addr
+ */
+  void RequestLocks (Ipv4Address addr);
+
+/**
+ * @apanda
+ * A neighbour answered a lock request
+ */
+  void ReceiveLockReply (Ipv4Address addr, uint32_t iface, bool granted);
+
+/**
+ * @apanda
+ * Every neighbour answered: run the AEO, or give back the locks and wait
+ */
+  void CompleteLocks (Ipv4Address addr);
+
+/**
+ * @apanda
+ * Forget the lock traffic of a link that went down
+ */
+  void ReleaseDdcLink (uint32_t iface);
+
+  /// @apanda An unlock or heartbeat waiting for DeliverNotifications ()
+  struct Notification {
+    Ipv4Address m_destination;
+    /// Heartbeat sequence number, unused by unlocks
+    uint32_t m_sequence;
+    bool m_heartbeat;
+  };
+  typedef std::vector<Notification> Notifications;
+
+/**
+ * @apanda
+ * Queue an unlock or heartbeat for the neighbour on iface
+ */
+  void Notify (uint32_t iface, bool heartbeat, Ipv4Address addr, uint32_t seq);
+
+/**
+ * @apanda
+ * Hand the queued notifications of iface to the neighbour, in order
+ */
+  void DeliverNotifications (uint32_t iface);
+
+/**
+ * @apanda
+ * Handle the unlocks and heartbeats a neighbour queued for link
+ */
+  void ReceiveNotifications (Ptr<NetDevice> link, const Notifications &notifications);
+
+  /// @apanda Link direction for DDC, two bits per vnode in LinkState
   enum LinkDirection {
     In = 1,
     Out = 2,
-    Dead = 255,
+    Dead = 3,
     Unknown = 0
   };
   /// Set to true if packets are randomly routed among ECMP; set to false for using only one route consistently
   bool m_randomEcmpRouting;
+  /// @apanda Set to true if packets are routed among ECMP by their flow hash
+  bool m_flowEcmpRouting;
+  /// @apanda Mixed into flow hashes, differs between nodes to avoid polarization
+  uint32_t m_flowHashSeed;
   /// Set to true if this interface should respond to interface events by globallly recomputing routes 
   bool m_respondToInterfaceEvents;
+  /// @apanda Set to true to respond to link failures with UpdateRoutesForLink () instead of a full recompute
+  bool m_incrementalRouteUpdates;
   /// A uniform random number generator for randomly routing packets among ECMP 
   UniformVariable m_rand;
   typedef std::list<Ipv4RoutingTableEntry *> HostRoutes;
@@ -426,63 +700,478 @@ private:
   typedef std::list<Ipv4RoutingTableEntry *>::iterator ASExternalRoutesI;
 
   // @apanda Types
-  typedef std::map<Ipv4Address, std::vector<LinkDirection> > InterfaceDirection;
-  typedef std::map<Ipv4Address, std::vector<uint32_t> > InterfacePriorities;
-  typedef std::pair<uint32_t, uint32_t> PriorityInterface;
-  typedef std::priority_queue<PriorityInterface, std::vector<PriorityInterface>, 
-            std::greater< std::vector<PriorityInterface>::value_type> > InterfaceQueue;
-  typedef std::map<Ipv4Address, InterfaceQueue> DestinationPriorityInterfaceQueues;
-  typedef std::map<Ipv4Address, std::list<uint32_t> > DestinationListInterfaceQueues;
-  typedef std::map<Ipv4Address, std::vector<uint32_t> > InterfaceReversalTTL;
-  typedef std::map<Ipv4Address, std::vector<uint8_t> > SequenceNumbers;
-  typedef std::map<Ipv4Address, uint8_t> VnodeNumbers;
-  typedef std::map<Ipv4Address, std::vector<uint8_t> > RemoteVnodeNumbers;
-  typedef std::map<Ipv4Address, std::vector<bool> > LockStatus;
-  typedef std::map<Ipv4Address, bool> LockHeld;
-  typedef std::map<Ipv4Address, uint32_t> LockCounts; 
-  typedef std::map<Ipv4Address, bool> AeoRequests;
-  typedef std::map<Ipv4Address, std::vector<uint32_t> > LinkOrder;
-  typedef std::map<Ipv4Address, std::vector<bool> > HeartbeatState;
-  typedef std::map<Ipv4Address, uint32_t> CurrentSequence;
-
-  LockStatus m_locks;
-  LockCounts m_lockCounts;
-  LockHeld m_held;
-  VnodeNumbers m_localVnode;
-  RemoteVnodeNumbers m_remoteVnode;
-  InterfaceReversalTTL m_ttl;
-  InterfacePriorities m_priorities;
-  AeoRequests m_aeoRequested;
-  LinkOrder m_reverseBefore;
-  LinkOrder m_reverseAfter;
-  CurrentSequence m_heartbeatSequence;
-  HeartbeatState m_heartbeatState;
-  bool m_allowReversal;
-  struct ForwardingState {
-    /// @apanda Direction vectors
-    InterfaceDirection m_directions;
-    /// @apanda Book keeping for the various interfaces
-    DestinationListInterfaceQueues m_inputs;
-    DestinationListInterfaceQueues m_to_reverse;
-    DestinationPriorityInterfaceQueues m_outputs;
-    SequenceNumbers m_localSeq;
-    SequenceNumbers m_remoteSeq;
-    DestinationPriorityInterfaceQueues m_prioritized_links;
-    /// end @apanda
+  /// Priority in the upper and distance in the lower 16 bits, and interface
+  typedef std::pair<uint64_t, uint32_t> PriorityInterface;
+
+  /**
+   * @apanda
+   * Interface sets kept per (destination, vnode).  Each one is a bitmask
+   * indexed by priority rank rather than interface number, so the best
+   * member of a set is its lowest set bit.
+   */
+  enum LinkSet {
+    OutputLinks = 0,
+    InputLinks = 1,
+    ToReverseLinks = 2,
+    PrioritizedLinks = 3,
+    LinkSetCount = 4
   };
 
-  ForwardingState m_vnodeState[2];
+  /// @apanda m_lockedVnode of a link no neighbour holds a lock on
+  static const uint8_t NotLocked = 0xff;
+
+  /**
+   * @apanda
+   * DDC state of one interface for one destination.  Direction and sequence
+   * bits are kept for every vnode, so a forwarding decision reads a single
+   * record.  Bits 2v and 2v+1 of m_directions are the direction for vnode
+   * v; bit 2v of m_seq is the local and bit 2v+1 the remote sequence
+   * number.
+   */
+  struct LinkState {
+    uint32_t m_priority;
+    uint32_t m_ttl;
+    uint8_t m_directions;
+    uint8_t m_seq;
+    uint8_t m_remoteVnode;
+    /// Vnode the neighbour's lock on this link pins, NotLocked if none
+    uint8_t m_lockedVnode;
+    bool m_heartbeat;
+    /// Position of this interface in the priority order of the destination
+    uint16_t m_rank;
+
+    uint8_t GetDirection (uint8_t vnode) const { return (m_directions >> (2 * vnode)) & 0x3; }
+    void SetDirection (uint8_t vnode, uint8_t direction)
+    {
+      m_directions = (m_directions & ~(0x3 << (2 * vnode))) | ((direction & 0x3) << (2 * vnode));
+    }
+    bool IsLocked (void) const { return m_lockedVnode != NotLocked; }
+
+    uint8_t GetLocalSeq (uint8_t vnode) const { return (m_seq >> (2 * vnode)) & 0x1; }
+    uint8_t GetRemoteSeq (uint8_t vnode) const { return (m_seq >> (2 * vnode + 1)) & 0x1; }
+    void SetLocalSeq (uint8_t vnode, uint8_t seq)
+    {
+      m_seq = (m_seq & ~(0x1 << (2 * vnode))) | ((seq & 0x1) << (2 * vnode));
+    }
+    void SetRemoteSeq (uint8_t vnode, uint8_t seq)
+    {
+      m_seq = (m_seq & ~(0x2 << (2 * vnode))) | ((seq & 0x1) << (2 * vnode + 1));
+    }
+  };
+
+  /// @apanda All DDC state for one destination, indexed through m_destinationIndex
+  struct DestinationState {
+    Ipv4Address m_address;
+    uint8_t m_localVnode;
+    bool m_aeoRequested;
+    /// Set while a requested AEO waits for locks, since m_aeoDeferredAt
+    bool m_aeoDeferred;
+    Time m_aeoDeferredAt;
+    bool m_held;
+    bool m_reversalOrderSet;
+    uint32_t m_lockCount;
+    uint32_t m_heartbeatSequence;
+    std::vector<uint32_t> m_reverseBefore;
+    std::vector<uint32_t> m_reverseAfter;
+    std::vector<LinkState> m_links;
+    /// Interface holding each priority rank
+    std::vector<uint16_t> m_linkAtRank;
+    /// Set when priorities changed since the ranks were computed
+    bool m_rankStale;
+    /// Distance of the neighbour behind each interface, only kept with
+    /// m_distanceRanking
+    std::vector<uint16_t> m_linkDistances;
+    /// LinkSetCount sets per vnode, each LinkSetWords () words long
+    std::vector<uint64_t> m_linkSets;
+    /// The ToReverseLinks set of a vnode is only valid while this matches
+    /// m_toReverseEpoch of the vnode
+    uint32_t m_toReverseEpoch[MAX_VNODES];
+  };
+  typedef sgi::hash_map<Ipv4Address, uint32_t, Ipv4AddressHash> DestinationIndex;
+
+  /// @apanda A routing table entry and the route handed out for it
+  struct NextHop
+  {
+    Ipv4RoutingTableEntry *m_entry;
+    Ptr<Ipv4Route> m_route;
+  };
+  /// @apanda ECMP group, entries in the order they were added
+  typedef std::vector<NextHop> NextHopGroup;
+  typedef sgi::hash_map<Ipv4Address, NextHopGroup, Ipv4AddressHash> HostRouteIndex;
+  struct PrefixKeyHash
+  {
+    size_t operator() (uint64_t key) const
+    {
+      return static_cast<size_t> (key ^ (key >> 32));
+    }
+  };
+  /// @apanda Groups keyed by (masked network << 6 | prefix length)
+  typedef sgi::hash_map<uint64_t, NextHopGroup, PrefixKeyHash> PrefixIndex;
+  /**
+   * @apanda
+   * Longest prefix match table: one hash table holds every prefix length and
+   * m_lengths has bit l set while some prefix of length l is present, so a
+   * lookup only probes the lengths in use, longest first.  m_groupsOfLength
+   * counts the groups of each length, so removals clear the bit in O(1).
+   */
+  struct PrefixTable
+  {
+    PrefixTable () : m_lengths (0)
+    {
+      std::fill (m_groupsOfLength, m_groupsOfLength + 33, 0);
+    }
+    uint64_t m_lengths;
+    uint32_t m_groupsOfLength[33];
+    PrefixIndex m_groups;
+  };
+
+  /// @apanda The three route lists, in the order GetRoute () indexes them
+  enum RouteKind {
+    HostRoute = 0,
+    NetworkRoute = 1,
+    ExternalRoute = 2
+  };
+
+/**
+ * @apanda
+ * Route list of one kind
+ */
+  std::list<Ipv4RoutingTableEntry *> &GetRouteList (RouteKind kind);
+
+/**
+ * @apanda
+ * UpdateRoutes () for the routes of one kind
+ */
+  uint32_t UpdateRouteList (RouteKind kind, const std::vector<Ipv4RoutingTableEntry> &routes);
+
+/**
+ * @apanda
+ * Add a copy of a route to the list of its kind
+ */
+  void AddRoute (RouteKind kind, const Ipv4RoutingTableEntry &route);
+
+/**
+ * @apanda
+ * Unindex, free and unlink the given routes of one kind
+ */
+  void DeleteRoutes (RouteKind kind, const std::set<const Ipv4RoutingTableEntry *> &routes);
+
+/**
+ * @apanda
+ * Key of a prefix in a PrefixIndex
+ */
+  static uint64_t GetPrefixKey (Ipv4Address network, Ipv4Mask mask);
+
+/**
+ * @apanda
+ * Look up the DDC state for a destination, 0 if it was never initialized
+ */
+  DestinationState *FindDestination (Ipv4Address addr);
+
+/**
+ * @apanda
+ * Look up the DDC state for a destination, initializing it if needed
+ */
+  DestinationState &GetDestination (Ipv4Address addr);
+
+/**
+ * @apanda
+ * With DdcMessages, whether the neighbour on iface counts as having sent its
+ * heartbeat for state, which a dead link never will
+ */
+  bool HeardHeartbeat (const DestinationState &state, uint32_t iface) const;
+
+/**
+ * @apanda
+ * Whether an AEO for state can start: the next vnode of the ring must not be
+ * pinned by a neighbour's lock, and fewer than m_vnodes - 1 vnodes may be
+ * pinned at all.  With two vnodes that means no lock may be outstanding.
+ */
+  bool CanStartAeo (const DestinationState &state) const;
+
+/**
+ * @apanda
+ * Count an AEO of state that has to wait for locks
+ */
+  void NoteAeoDeferred (DestinationState &state);
+
+/**
+ * @apanda
+ * Bitmask for one of the interface sets of a (destination, vnode) pair
+ */
+  uint64_t *GetLinkSet (DestinationState &state, uint8_t vnode, LinkSet set);
+
+/**
+ * @apanda
+ * Pending reversals for a (destination, vnode) pair
+ */
+  uint64_t *GetToReverse (DestinationState &state, uint8_t vnode);
+
+/**
+ * @apanda
+ * Recompute the priority ranks of a destination and move its interface sets
+ * over to the new order
+ */
+  void RankLinks (DestinationState &state);
+
+/**
+ * @apanda
+ * Find highest priority output port to send messages out of
+ */
+  bool FindOutputPort (uint8_t, DestinationState &state, uint32_t &link, uint32_t iif);
+
+/**
+ * @apanda
+ * Find highest priority live link
+ */
+  bool FindHighPriorityLink (uint8_t, DestinationState &state, uint32_t &link);
+
+/**
+ * @apanda
+ * Send on outlink
+ */
+  void SendOnOutlink (uint8_t, DestinationState &state, Ipv4Header& header, uint32_t link);
+
+/**
+ * @apanda
+ * Create a generic routing entry, and prepare the header
+ */
+  void CreateRoutingEntry (uint8_t, uint32_t link, DestinationState &state, Ipv4Header& header, Ptr<Ipv4Route> &route);
+
+/**
+ * @apanda
+ * Schedule reversals, returns true if some input became an output right away
+ */
+  bool ScheduleReversals (uint8_t, DestinationState &state);
+
+/**
+ * @apanda
+ * Refresh the cached liveness of an interface from its NetDevice.  Link
+ * changes reach us through NotifyInterfaceUp/NotifyInterfaceDown, which
+ * Ipv4L3Protocol calls from the device link change callback.
+ */
+  void UpdateLinkState (uint32_t interface);
+
+/**
+ * @apanda
+ * Cached NetDevice::IsLinkUp for an interface
+ */
+  bool IsLinkUp (uint32_t interface) const;
+
+/**
+ * @apanda
+ * Shared route for control plane packets leaving on a link.  Point to point
+ * links get one immutable route per interface with the peer as gateway,
+ * built on first use and dropped when the interface changes.  Links with no
+ * single addressed peer get a fresh route towards dest.
+ */
+  Ptr<Ipv4Route> GetLinkRoute (uint32_t link, Ipv4Address dest);
+
+/**
+ * @apanda
+ * Shared route delivering to a local address of interface, through the
+ * loopback
+ */
+  Ptr<Ipv4Route> GetLocalRoute (uint32_t interface, uint32_t addressIndex);
+
+/**
+ * @apanda
+ * Shared route for a routing table entry, built on first use
+ */
+  Ptr<Ipv4Route> GetEntryRoute (NextHop &nextHop);
+
+/**
+ * @apanda
+ * Add a routing table entry to the lookup structures used by LookupGlobal
+ */
+  void IndexHostRoute (Ipv4RoutingTableEntry *route);
+  void IndexPrefixRoute (PrefixTable &table, Ipv4RoutingTableEntry *route);
+
+/**
+ * @apanda
+ * Remove a routing table entry from the lookup structures
+ */
+  void UnindexHostRoute (Ipv4RoutingTableEntry *route);
+  void UnindexPrefixRoute (PrefixTable &table, Ipv4RoutingTableEntry *route);
+
+/**
+ * @apanda
+ * Longest prefix match of dest in table, 0 if nothing usable matches
+ */
+  NextHop *LookupPrefix (PrefixTable &table, Ipv4Address dest, Ptr<NetDevice> oif, bool ecmp, uint32_t flowHash);
+
+/**
+ * @apanda
+ * Pick one next hop of group leaving through oif (any interface if oif is
+ * 0).  Without ecmp this is the first one, otherwise it is chosen by
+ * flowHash with FlowEcmpRouting and uniformly at random without.
+ */
+  NextHop *SelectNextHop (NextHopGroup &group, Ptr<NetDevice> oif, bool ecmp, uint32_t flowHash);
+
+/**
+ * @apanda
+ * Seeded 5-tuple hash of a forwarded packet, from its FlowHashTag or,
+ * for an untagged packet, computed and cached in one.
+ */
+  uint32_t GetFlowHash (Ptr<const Packet> p, const Ipv4Header &header);
+/**
+ * @apanda
+ * Seeded 5-tuple hash of a packet this node originates, computed from the
+ * complete header and cached in a FlowHashTag that replaces any earlier
+ * one.  A socket looking up its source address has no complete packet yet,
+ * so only the destination is hashed for it and nothing is cached.
+ */
+  uint32_t TagFlowHash (Ptr<Packet> p, const Ipv4Header &header);
+
+/**
+ * @apanda
+ * Account a forwarded packet to the output interface of route
+ */
+  void NotifyNextHop (Ptr<Ipv4Route> route, Ptr<const Packet> p, const Ipv4Header &header);
+
+/**
+ * @apanda
+ * Drop the shared route of every routing table entry
+ */
+  void ClearEntryRoutes (void);
+
+/**
+ * @apanda
+ * Drop the shared routes that depend on the addresses of interface
+ */
+  void InvalidateRoutes (uint32_t interface);
+
+  DestinationIndex m_destinationIndex;
+  std::vector<DestinationState> m_destinations;
+  /// @apanda Applied to every address before looking up its DDC state
+  Ptr<const Ipv4DestinationAliases> m_aliases;
+
+  /// @apanda Answer of a neighbour to a lock request
+  enum LockReply {
+    NoRequest = 0,
+    AwaitingReply = 1,
+    Granted = 2,
+    Denied = 3
+  };
+  /// @apanda A message based AEO, from the lock requests to the unlocks
+  struct PendingAeo {
+    uint32_t m_outstanding;
+    bool m_denied;
+    /// LockReply per interface
+    std::vector<uint8_t> m_replies;
+  };
+  typedef sgi::hash_map<Ipv4Address, PendingAeo, Ipv4AddressHash> PendingAeos;
+  PendingAeos m_pendingAeos;
+  /// @apanda Run AEO and heartbeats as messages over the links
+  bool m_ddcMessages;
+  Time m_ddcBatchDelay;
+  uint8_t m_ddcPriority;
+  /// @apanda Node ID, breaks ties between concurrent lock requests
+  uint32_t m_nodeId;
+  /// @apanda Heartbeat sequence number of the current round
+  uint32_t m_heartbeatRound;
+  /// @apanda One event per neighbour for unlocks and heartbeats
+  bool m_batchHeartbeats;
+  /// @apanda Notifications waiting for DeliverNotifications (), by interface
+  std::vector<Notifications> m_notifications;
+  std::vector<EventId> m_notificationEvents;
+  /// @apanda Entries waiting for the next FlushDdc () of each interface
+  std::vector<std::vector<DdcMessageHeader::Entry> > m_ddcOutgoing;
+  std::vector<EventId> m_ddcFlush;
+  uint64_t m_ddcMessagesSent;
+  uint64_t m_ddcMessageBytesSent;
+  /// @apanda Interface, entries and bytes of a DDC message sent
+  TracedCallback<uint32_t, uint32_t, uint32_t> m_ddcMessageTrace;
+  /// @apanda Bitmap of interfaces whose link is up, indexed by interface
+  std::vector<uint64_t> m_linkUp;
+  /// @apanda Shared control plane routes, indexed by interface
+  std::vector<Ptr<Ipv4Route> > m_linkRoutes;
+  std::vector<Ptr<Ipv4Route> > m_localRoutes;
+  /// @apanda Bumped whenever every pending reversal list of a vnode is dropped
+  uint32_t m_toReverseEpoch[MAX_VNODES];
+  /// @apanda Size of the vnode ring AEOs move through
+  uint8_t m_vnodes;
+  uint64_t m_aeosDeferred;
+  Time m_aeoDeferralTime;
+  /// @apanda Destination and waiting time of an AEO that had to wait for locks
+  TracedCallback<Ipv4Address, Time> m_aeoDeferredTrace;
+  bool m_allowReversal;
 
   Time m_reverseInputToOutputDelay;
   Time m_reverseOutputToInputDelay;
 
+  /// @apanda A reversal waiting for its delay
+  struct QueuedReversal {
+    Time m_due;
+    /// Breaks ties between reversals due at the same time, lower went first
+    uint64_t m_order;
+    Ipv4Address m_destination;
+    uint32_t m_link;
+    uint8_t m_vnode;
+  };
+  /**
+   * @apanda
+   * Queued reversals of each kind.  All reversals of a kind share a delay,
+   * so each queue is sorted by due time and only its front needs watching;
+   * one event, for the earliest front, stands in for all of them.
+   */
+  std::deque<QueuedReversal> m_reversals[2];
+  /// @apanda (destination, link, vnode, kind) of every queued reversal
+  sgi::hash_map<uint64_t, bool, PrefixKeyHash> m_queuedReversals;
+  uint64_t m_reversalOrder;
+  EventId m_reversalEvent;
+  uint64_t m_reversalsSuppressed;
+
+  /// @apanda Break priority ties by SetInterfaceDistance ()
+  bool m_distanceRanking;
+  /// @apanda Stretch of the packets delivered here, see GetMeanStretch ()
+  bool m_recordStretch;
+  uint8_t m_initialTtl;
+  uint64_t m_stretchPackets;
+  double m_stretchSum;
+  double m_stretchMax;
+  /// @apanda Source, hops taken and shortest path hops of a delivered packet
+  TracedCallback<Ipv4Address, uint32_t, uint32_t> m_stretchTrace;
+  void RecordStretch (const Ipv4Header &header);
+
   HostRoutes m_hostRoutes;
   NetworkRoutes m_networkRoutes;
   ASExternalRoutes m_ASexternalRoutes; // External routes imported
+  /// @apanda Lookup structures for the three route lists above
+  HostRouteIndex m_hostRouteIndex;
+  PrefixTable m_networkRouteIndex;
+  PrefixTable m_externalRouteIndex;
 
   Ptr<Ipv4> m_ipv4;
 
   TracedCallback<uint32_t, Ipv4Address> m_reversalCallback;
+
+  /// @apanda Bytes forwarded through each interface
+  std::vector<uint64_t> m_nextHopBytes;
+  /// @apanda Interface, bytes of the packet, bytes so far through the interface
+  TracedCallback<uint32_t, uint32_t, uint64_t> m_nextHopBytesTrace;
+
+  /// @apanda What SaveState () keeps
+  struct SavedState
+  {
+    DestinationIndex m_destinationIndex;
+    std::vector<DestinationState> m_destinations;
+    std::vector<uint64_t> m_linkUp;
+    uint32_t m_toReverseEpoch[MAX_VNODES];
+    uint32_t m_heartbeatRound;
+    uint64_t m_reversalOrder;
+    uint64_t m_ddcMessagesSent;
+    uint64_t m_ddcMessageBytesSent;
+    uint64_t m_aeosDeferred;
+    Time m_aeoDeferralTime;
+    uint64_t m_reversalsSuppressed;
+    uint64_t m_stretchPackets;
+    double m_stretchSum;
+    double m_stretchMax;
+    std::vector<uint64_t> m_nextHopBytes;
+  };
+  SavedState m_saved;
+  bool m_stateSaved;
 };
 
 } // Namespace ns3
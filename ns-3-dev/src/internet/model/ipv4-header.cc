@@ -41,7 +41,8 @@ Ipv4Header::Ipv4Header ()
     m_fragmentOffset (0),
     m_checksum (0),
     m_goodChecksum (true),
-    m_headerSize(5*4)
+    m_seq (0),
+    m_vnode (0)
 {
 }
 
@@ -332,19 +333,21 @@ Ipv4Header::Print (std::ostream &os) const
      << "protocol " << m_protocol << " "
      << "offset (bytes) " << m_fragmentOffset << " "
      << "flags [" << flags << "] "
-     << "length: " << (m_payloadSize + 5 * 4)
-     << "DDC seq: " << (uint32_t) m_seq
-     << "DDC vnode: " << (uint32_t) m_vnode
-     << "DDC control: " << (uint32_t) IsControl()
-     << " " 
+     << "length: " << (m_payloadSize + GetSerializedSize ()) << " ";
+  if (IsControl ())
+    {
+      os << "DDC seq " << (uint32_t) m_seq << " "
+         << "vnode " << (uint32_t) m_vnode << " ";
+    }
+  os
      << m_source << " > " << m_destination
   ;
 }
 uint32_t 
 Ipv4Header::GetSerializedSize (void) const
 {
-  //return 5 * 4;
-  return m_headerSize;
+  // @apanda Control packets carry the DDC option, padded to a 32 bit word
+  return IsControl () ? 6 * 4 : 5 * 4;
 }
 
 void
@@ -352,10 +355,11 @@ Ipv4Header::Serialize (Buffer::Iterator start) const
 {
   Buffer::Iterator i = start;
 
-  uint8_t verIhl = (4 << 4) | (5);
+  uint16_t headerSize = GetSerializedSize ();
+  uint8_t verIhl = (4 << 4) | (headerSize / 4);
   i.WriteU8 (verIhl);
   i.WriteU8 (m_tos);
-  i.WriteHtonU16 (m_payloadSize + 5*4);
+  i.WriteHtonU16 (m_payloadSize + headerSize);
   i.WriteHtonU16 (m_identification);
   uint32_t fragmentOffset = m_fragmentOffset / 8;
   uint8_t flagsFrag = (fragmentOffset >> 8) & 0x1f;
@@ -372,16 +376,23 @@ Ipv4Header::Serialize (Buffer::Iterator start) const
   i.WriteU8 (frag);
   i.WriteU8 (m_ttl);
   i.WriteU8 (m_protocol);
-  i.WriteU8 ((uint8_t)m_seq); 
-  i.WriteU8 ((uint8_t)m_vnode);
-  i.WriteU8 ((uint8_t)IsControl());
+  i.WriteHtonU16 (0);
   i.WriteHtonU32 (m_source.Get ());
   i.WriteHtonU32 (m_destination.Get ());
+  if (IsControl ())
+    {
+      // @apanda DDC option: type, length, then sequence bit and vnode
+      // packed into one byte; the end of option list pads the word
+      i.WriteU8 (DDC_OPTION);
+      i.WriteU8 (DDC_OPTION_LENGTH);
+      i.WriteU8 ((m_seq << 7) | m_vnode);
+      i.WriteU8 (0);
+    }
 
   if (m_calcChecksum) 
     {
       i = start;
-      uint16_t checksum = i.CalculateIpChecksum (20);
+      uint16_t checksum = i.CalculateIpChecksum (headerSize);
       NS_LOG_LOGIC ("checksum=" <<checksum);
       i = start;
       i.Next (10);
@@ -417,17 +428,51 @@ Ipv4Header::Deserialize (Buffer::Iterator start)
   m_fragmentOffset <<= 3;
   m_ttl = i.ReadU8 ();
   m_protocol = i.ReadU8 ();
-  m_seq = i.ReadU8() & 0x1;
-  m_vnode = i.ReadU8() & 0x1;
-  uint8_t control = i.ReadU8();
-  if (control) {
-    SetControl();
-  }
   m_checksum = 0;
-  /* i.Next (2); // checksum */
+  i.Next (2); // checksum
   m_source.Set (i.ReadNtohU32 ());
   m_destination.Set (i.ReadNtohU32 ());
-  m_headerSize = headerSize;
+  // @apanda Only control packets carry DDC state, as an option; other
+  // options are skipped
+  m_seq = 0;
+  m_vnode = 0;
+  uint16_t optionBytes = headerSize - 5 * 4;
+  while (optionBytes > 0)
+    {
+      uint8_t type = i.ReadU8 ();
+      optionBytes--;
+      if (type == 0)
+        {
+          // End of option list
+          i.Next (optionBytes);
+          break;
+        }
+      if (type == 1 || optionBytes == 0)
+        {
+          // No operation
+          continue;
+        }
+      uint8_t length = i.ReadU8 ();
+      optionBytes--;
+      if (length < 2 || length - 2 > optionBytes)
+        {
+          NS_LOG_WARN ("Malformed IPv4 option " << (uint32_t) type);
+          i.Next (optionBytes);
+          break;
+        }
+      if (type == DDC_OPTION && length == DDC_OPTION_LENGTH)
+        {
+          uint8_t ddc = i.ReadU8 ();
+          m_seq = ddc >> 7;
+          m_vnode = ddc & DDC_VNODE_MASK;
+          m_flags |= IS_CONTROL;
+        }
+      else
+        {
+          i.Next (length - 2);
+        }
+      optionBytes -= length - 2;
+    }
 
   if (m_calcChecksum) 
     {
@@ -458,14 +503,22 @@ Ipv4Header::GetSeq (void) const
 void
 Ipv4Header::SetVnode (uint32_t vnode)
 {
-  m_vnode = (vnode & 0x1);
+  NS_ASSERT_MSG (vnode <= DDC_VNODE_MASK, "DDC vnode " << vnode << " does not fit the header");
+  m_vnode = (vnode & DDC_VNODE_MASK);
 }
 
 // @apanda
 uint32_t
 Ipv4Header::GetVnode (void) const
 {
-  return (m_vnode & 0x1);
+  return m_vnode;
+}
+
+// @apanda
+uint32_t
+Ipv4Header::GetMaxVnode (void)
+{
+  return DDC_VNODE_MASK;
 }
 
 // @aor
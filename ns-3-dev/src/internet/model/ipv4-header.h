@@ -232,7 +232,8 @@ public:
 
   /**
    * @apanda
-   * \param DDC virtual node number
+   * \param DDC virtual node number, at most GetMaxVnode ().  Like the
+   * sequence number it is only carried by control packets.
    */
   void SetVnode (uint32_t);
 
@@ -242,6 +243,12 @@ public:
    */
   uint32_t GetVnode (void) const;
 
+  /**
+   * @apanda
+   * \returns the largest DDC virtual node number the header can carry
+   */
+  uint32_t static GetMaxVnode (void);
+
   /**
    * @aor
    * \param SDN control bit
@@ -293,6 +300,14 @@ private:
     IS_CONTROL = (1<<2)
   };
 
+  // @apanda IPv4 option carrying the DDC fields of control packets, the
+  // RFC 4727 experimental option number with the copied flag set
+  enum DdcOptionE {
+    DDC_OPTION = 0x9e,
+    DDC_OPTION_LENGTH = 3,
+    DDC_VNODE_MASK = 0x7f
+  };
+
   bool m_calcChecksum;
 
   uint16_t m_payloadSize;
@@ -306,9 +321,8 @@ private:
   Ipv4Address m_destination;
   uint16_t m_checksum;
   bool m_goodChecksum;
-  uint16_t m_headerSize;
   uint32_t m_seq : 1;
-  uint32_t m_vnode : 1;
+  uint32_t m_vnode : 7;
 };
 
 } // namespace ns3
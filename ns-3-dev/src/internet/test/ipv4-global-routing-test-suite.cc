@@ -0,0 +1,1062 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/arp-l3-protocol.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/ipv4-global-routing.h"
+#include "ns3/ipv4-routing-table-entry.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/flow-hash-tag.h"
+#include "ns3/simple-channel.h"
+#include "ns3/node-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/global-value.h"
+#include "ns3/config.h"
+#include "ns3/node-list.h"
+#include "ns3/global-route-manager.h"
+#include "ns3/global-route-manager-impl.h"
+#include "ns3/ddc-message-header.h"
+#include "ns3/nstime.h"
+#include "ns3/simulation-singleton.h"
+#include <sstream>
+#include <fstream>
+
+namespace ns3 {
+
+/**
+ * @apanda
+ * Node with three interfaces and global routing, for data plane lookups
+ */
+class Ipv4GlobalRoutingTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingTestCase (std::string name);
+protected:
+  void Setup (void);
+  void Teardown (void);
+  /// Output interface of the data plane route to dest, -1 if there is none
+  int32_t Lookup (Ipv4Address dest, Ptr<NetDevice> oif = 0);
+  /// Same for a UDP packet from 10.9.0.1 with the given ports
+  int32_t Lookup (Ipv4Address dest, Ptr<Packet> p);
+  Ptr<Packet> CreateUdpPacket (uint16_t sport, uint16_t dport);
+
+  Ptr<Node> m_node;
+  Ptr<Ipv4> m_ipv4;
+  Ptr<Ipv4GlobalRouting> m_routing;
+};
+
+Ipv4GlobalRoutingTestCase::Ipv4GlobalRoutingTestCase (std::string name)
+  : TestCase (name)
+{
+}
+
+void
+Ipv4GlobalRoutingTestCase::Setup (void)
+{
+  m_node = CreateObject<Node> ();
+  m_node->AggregateObject (CreateObject<ArpL3Protocol> ());
+  Ptr<Ipv4L3Protocol> ipv4 = CreateObject<Ipv4L3Protocol> ();
+  m_node->AggregateObject (ipv4);
+  m_routing = CreateObject<Ipv4GlobalRouting> ();
+  ipv4->SetRoutingProtocol (m_routing);
+  m_ipv4 = ipv4;
+  for (uint32_t i = 1; i <= 3; i++)
+    {
+      Ptr<SimpleNetDevice> dev = CreateObject<SimpleNetDevice> ();
+      dev->SetAddress (Mac48Address::Allocate ());
+      dev->SetChannel (CreateObject<SimpleChannel> ());
+      m_node->AddDevice (dev);
+      uint32_t interface = m_ipv4->AddInterface (dev);
+      Ipv4Address local (Ipv4Address ("192.168.0.0").Get () + (i << 8) + 1);
+      m_ipv4->AddAddress (interface, Ipv4InterfaceAddress (local, Ipv4Mask ("255.255.255.0")));
+      m_ipv4->SetUp (interface);
+    }
+}
+
+void
+Ipv4GlobalRoutingTestCase::Teardown (void)
+{
+  m_routing = 0;
+  m_ipv4 = 0;
+  m_node->Dispose ();
+  m_node = 0;
+  Simulator::Destroy ();
+}
+
+int32_t
+Ipv4GlobalRoutingTestCase::Lookup (Ipv4Address dest, Ptr<NetDevice> oif)
+{
+  Ipv4Header header;
+  header.SetDestination (dest);
+  Socket::SocketErrno sockerr;
+  Ptr<Ipv4Route> route = m_routing->RouteOutput (Create<Packet> (), header, oif, sockerr);
+  if (route == 0)
+    {
+      return -1;
+    }
+  return m_ipv4->GetInterfaceForDevice (route->GetOutputDevice ());
+}
+
+int32_t
+Ipv4GlobalRoutingTestCase::Lookup (Ipv4Address dest, Ptr<Packet> p)
+{
+  Ipv4Header header;
+  header.SetSource (Ipv4Address ("10.9.0.1"));
+  header.SetDestination (dest);
+  header.SetProtocol (17);
+  Socket::SocketErrno sockerr;
+  Ptr<Ipv4Route> route = m_routing->RouteOutput (p, header, 0, sockerr);
+  if (route == 0)
+    {
+      return -1;
+    }
+  return m_ipv4->GetInterfaceForDevice (route->GetOutputDevice ());
+}
+
+Ptr<Packet>
+Ipv4GlobalRoutingTestCase::CreateUdpPacket (uint16_t sport, uint16_t dport)
+{
+  uint8_t buf[8] = { 0, 0, 0, 0, 0, 8, 0, 0 };
+  buf[0] = sport >> 8;
+  buf[1] = sport & 0xff;
+  buf[2] = dport >> 8;
+  buf[3] = dport & 0xff;
+  return Create<Packet> (buf, sizeof (buf));
+}
+
+class Ipv4GlobalRoutingPrefixTestCase : public Ipv4GlobalRoutingTestCase
+{
+public:
+  Ipv4GlobalRoutingPrefixTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4GlobalRoutingPrefixTestCase::Ipv4GlobalRoutingPrefixTestCase ()
+  : Ipv4GlobalRoutingTestCase ("Host routes, then longest network prefix, then external routes")
+{
+}
+
+void
+Ipv4GlobalRoutingPrefixTestCase::DoRun (void)
+{
+  Setup ();
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("255.255.0.0"), Ipv4Address ("192.168.1.2"), 1);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.2.0"), Ipv4Mask ("255.255.255.0"), Ipv4Address ("192.168.2.2"), 2);
+  m_routing->AddHostRouteTo (Ipv4Address ("10.1.2.3"), Ipv4Address ("192.168.3.2"), 3);
+  m_routing->AddASExternalRouteTo (Ipv4Address ("0.0.0.0"), Ipv4Mask ("0.0.0.0"), Ipv4Address ("192.168.3.2"), 3);
+
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.2.3")), 3, "host route wins");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.2.4")), 2, "longest prefix wins");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.9.9")), 1, "shorter prefix still matches");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.2.0.1")), 3, "external route as a last resort");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.2.3"), m_ipv4->GetNetDevice (2)), 2,
+                         "routes not leaving through oif are skipped");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.9.9"), m_ipv4->GetNetDevice (2)), -1,
+                         "no route through oif");
+
+  // Route indices: host route first, then network routes, then external
+  NS_TEST_ASSERT_MSG_EQ (m_routing->GetNRoutes (), 4, "route count");
+  m_routing->RemoveRoute (2);
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.2.4")), 1, "removed prefix no longer matches");
+  m_routing->RemoveRoute (0);
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.2.3")), 1, "removed host route no longer matches");
+
+  // Removing one of two prefixes of a length keeps the other one matching
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.3.0"), Ipv4Mask ("255.255.255.0"), Ipv4Address ("192.168.3.2"), 3);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.4.0"), Ipv4Mask ("255.255.255.0"), Ipv4Address ("192.168.2.2"), 2);
+  m_routing->RemoveRoute (1);
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.3.1")), 1, "removed prefix no longer matches");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.4.1")), 2, "prefix of the same length still matches");
+  m_routing->RemoveRoute (1);
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.4.1")), 1, "last prefix of its length removed");
+  Teardown ();
+}
+
+class Ipv4GlobalRoutingEcmpTestCase : public Ipv4GlobalRoutingTestCase
+{
+public:
+  Ipv4GlobalRoutingEcmpTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4GlobalRoutingEcmpTestCase::Ipv4GlobalRoutingEcmpTestCase ()
+  : Ipv4GlobalRoutingTestCase ("Equal cost routes share a group")
+{
+}
+
+void
+Ipv4GlobalRoutingEcmpTestCase::DoRun (void)
+{
+  Setup ();
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("255.255.0.0"), Ipv4Address ("192.168.2.2"), 2);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("255.255.0.0"), Ipv4Address ("192.168.3.2"), 3);
+
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.0.1")), 2, "first route without RandomEcmpRouting");
+    }
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.0.1"), m_ipv4->GetNetDevice (3)), 3, "group member through oif");
+
+  m_routing->SetAttribute ("RandomEcmpRouting", BooleanValue (true));
+  bool seen[4] = { false, false, false, false };
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      int32_t interface = Lookup (Ipv4Address ("10.1.0.1"));
+      NS_TEST_ASSERT_MSG_EQ ((interface == 2 || interface == 3), true, "route from the group");
+      seen[interface] = true;
+    }
+  NS_TEST_ASSERT_MSG_EQ (seen[2] && seen[3], true, "RandomEcmpRouting uses every group member");
+  Teardown ();
+}
+
+class Ipv4GlobalRoutingFlowEcmpTestCase : public Ipv4GlobalRoutingTestCase
+{
+public:
+  Ipv4GlobalRoutingFlowEcmpTestCase ();
+  virtual void DoRun (void);
+private:
+  void Tx (Ptr<const Packet> p, Ptr<Ipv4> ipv4, uint32_t interface);
+  int32_t m_txInterface;
+};
+
+Ipv4GlobalRoutingFlowEcmpTestCase::Ipv4GlobalRoutingFlowEcmpTestCase ()
+  : Ipv4GlobalRoutingTestCase ("Flow hash ECMP keeps a flow on one route"),
+    m_txInterface (-1)
+{
+}
+
+void
+Ipv4GlobalRoutingFlowEcmpTestCase::Tx (Ptr<const Packet> p, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+  m_txInterface = interface;
+}
+
+void
+Ipv4GlobalRoutingFlowEcmpTestCase::DoRun (void)
+{
+  Setup ();
+  m_routing->SetAttribute ("FlowEcmpRouting", BooleanValue (true));
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("255.255.0.0"), Ipv4Address ("192.168.2.2"), 2);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("255.255.0.0"), Ipv4Address ("192.168.3.2"), 3);
+
+  Ptr<Packet> p = CreateUdpPacket (1000, 80);
+  int32_t first = Lookup (Ipv4Address ("10.1.0.1"), p);
+  FlowHashTag tag;
+  NS_TEST_ASSERT_MSG_EQ (p->PeekPacketTag (tag), true, "hash cached in the packet");
+  for (uint32_t i = 0; i < 20; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.0.1"), CreateUdpPacket (1000, 80)), first,
+                             "packets of a flow take the same route");
+    }
+
+  bool seen[4] = { false, false, false, false };
+  for (uint16_t sport = 1000; sport < 1064; sport++)
+    {
+      int32_t interface = Lookup (Ipv4Address ("10.1.0.1"), CreateUdpPacket (sport, 80));
+      NS_TEST_ASSERT_MSG_EQ ((interface == 2 || interface == 3), true, "route from the group");
+      seen[interface] = true;
+    }
+  NS_TEST_ASSERT_MSG_EQ (seen[2] && seen[3], true, "flows spread over the group");
+
+  // The cached hash is unseeded, so another seed may move the flow
+  uint32_t moved = 0;
+  for (uint16_t sport = 1000; sport < 1064; sport++)
+    {
+      m_routing->SetAttribute ("FlowHashSeed", UintegerValue (0));
+      int32_t before = Lookup (Ipv4Address ("10.1.0.1"), CreateUdpPacket (sport, 80));
+      m_routing->SetAttribute ("FlowHashSeed", UintegerValue (12345));
+      moved += (Lookup (Ipv4Address ("10.1.0.1"), CreateUdpPacket (sport, 80)) != before);
+    }
+  NS_TEST_ASSERT_MSG_GT (moved, 0, "the seed changes the choice of some flows");
+
+  // Packets the node sends itself are tagged with their own 5-tuple when
+  // their route is looked up with the complete IP header, replacing a tag
+  // left from an earlier hop
+  m_ipv4->TraceConnectWithoutContext ("Tx", MakeCallback (&Ipv4GlobalRoutingFlowEcmpTestCase::Tx, this));
+  Ipv4Header header;
+  header.SetSource (Ipv4Address ("10.9.0.1"));
+  header.SetDestination (Ipv4Address ("10.1.0.1"));
+  header.SetProtocol (17);
+  seen[2] = seen[3] = false;
+  for (uint16_t sport = 1000; sport < 1064; sport++)
+    {
+      Ptr<Packet> sent = CreateUdpPacket (sport, 80);
+      sent->AddPacketTag (FlowHashTag (0));
+      m_txInterface = -1;
+      m_ipv4->Send (sent, header.GetSource (), header.GetDestination (), 17, 0, 0);
+      NS_TEST_ASSERT_MSG_EQ (sent->PeekPacketTag (tag), true, "sent packet tagged");
+      NS_TEST_ASSERT_MSG_EQ (tag.GetHash (), FlowHashTag::Hash (CreateUdpPacket (sport, 80), header),
+                             "hash of the complete packet");
+      NS_TEST_ASSERT_MSG_EQ ((m_txInterface == 2 || m_txInterface == 3), true, "sent on the group");
+      seen[m_txInterface] = true;
+    }
+  NS_TEST_ASSERT_MSG_EQ (seen[2] && seen[3], true, "flows from the node spread over the group");
+
+  // Without flow ECMP nothing is hashed
+  m_routing->SetAttribute ("FlowEcmpRouting", BooleanValue (false));
+  Ptr<Packet> plain = CreateUdpPacket (1000, 80);
+  m_ipv4->Send (plain, header.GetSource (), header.GetDestination (), 17, 0, 0);
+  NS_TEST_ASSERT_MSG_EQ (plain->PeekPacketTag (tag), false, "untagged without flow ECMP");
+  Teardown ();
+}
+
+class Ipv4GlobalRoutingUpdateTestCase : public Ipv4GlobalRoutingTestCase
+{
+public:
+  Ipv4GlobalRoutingUpdateTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4GlobalRoutingUpdateTestCase::Ipv4GlobalRoutingUpdateTestCase ()
+  : Ipv4GlobalRoutingTestCase ("UpdateRoutes only rewrites changed entries")
+{
+}
+
+void
+Ipv4GlobalRoutingUpdateTestCase::DoRun (void)
+{
+  Setup ();
+  m_routing->AddHostRouteTo (Ipv4Address ("10.1.2.3"), Ipv4Address ("192.168.1.2"), 1);
+  m_routing->AddHostRouteTo (Ipv4Address ("10.1.2.4"), Ipv4Address ("192.168.2.2"), 2);
+  m_routing->AddHostRouteTo (Ipv4Address ("10.1.2.4"), Ipv4Address ("192.168.3.2"), 3);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.2.0.0"), Ipv4Mask ("255.255.0.0"), Ipv4Address ("192.168.1.2"), 1);
+  Ipv4RoutingTableEntry *kept = m_routing->GetRoute (0);
+
+  std::vector<Ipv4RoutingTableEntry> hosts;
+  std::vector<Ipv4RoutingTableEntry> networks;
+  std::vector<Ipv4RoutingTableEntry> externals;
+  hosts.push_back (Ipv4RoutingTableEntry::CreateHostRouteTo (Ipv4Address ("10.1.2.3"), Ipv4Address ("192.168.1.2"), 1));
+  hosts.push_back (Ipv4RoutingTableEntry::CreateHostRouteTo (Ipv4Address ("10.1.2.4"), Ipv4Address ("192.168.3.2"), 3));
+  networks.push_back (Ipv4RoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.2.0.0"), Ipv4Mask ("255.255.0.0"),
+                                                                   Ipv4Address ("192.168.1.2"), 1));
+  networks.push_back (Ipv4RoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.3.0.0"), Ipv4Mask ("255.255.0.0"),
+                                                                   Ipv4Address ("192.168.2.2"), 2));
+  // 10.1.2.4 loses its next hop through interface 2 and 10.3/16 is new
+  NS_TEST_ASSERT_MSG_EQ (m_routing->UpdateRoutes (hosts, networks, externals), 2, "only the differing entries");
+  NS_TEST_ASSERT_MSG_EQ (m_routing->GetNRoutes (), 4, "one route per wanted entry");
+  NS_TEST_ASSERT_MSG_EQ (m_routing->GetRoute (0), kept, "unchanged entry kept in place");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.1.2.4")), 3, "remaining next hop");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.3.0.1")), 2, "new prefix");
+  NS_TEST_ASSERT_MSG_EQ (m_routing->UpdateRoutes (hosts, networks, externals), 0, "nothing left to change");
+
+  NS_TEST_ASSERT_MSG_EQ (m_routing->RemoveHostRoutesTo (Ipv4Address ("10.1.2.4")), 1, "host group removed");
+  NS_TEST_ASSERT_MSG_EQ (m_routing->RemoveNetworkRoutesTo (Ipv4Address ("10.3.0.0"), Ipv4Mask ("255.255.0.0")), 1,
+                         "network group removed");
+  NS_TEST_ASSERT_MSG_EQ (Lookup (Ipv4Address ("10.3.0.1")), -1, "removed prefix no longer matches");
+  NS_TEST_ASSERT_MSG_EQ (m_routing->UpdateRoutes (std::vector<Ipv4RoutingTableEntry> (), networks, externals), 2,
+                         "routes missing from the update are removed");
+  Teardown ();
+}
+
+/**
+ * @apanda
+ * Link router i to router i + 1 for the first links routers, wrapping
+ * around, each link a SimpleChannel with a /24 of its own from 10.1.1.0:
+ * as many links as routers make a ring, fewer a chain.
+ */
+static void
+ConnectRouters (NodeContainer nodes, uint32_t links)
+{
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  for (uint32_t i = 0; i < links; i++)
+    {
+      Ptr<SimpleChannel> channel = CreateObject<SimpleChannel> ();
+      NetDeviceContainer devices;
+      for (uint32_t j = i; j < i + 2; j++)
+        {
+          Ptr<SimpleNetDevice> dev = CreateObject<SimpleNetDevice> ();
+          dev->SetAddress (Mac48Address::Allocate ());
+          dev->SetChannel (channel);
+          nodes.Get (j % nodes.GetN ())->AddDevice (dev);
+          devices.Add (dev);
+        }
+      address.Assign (devices);
+      address.NewNetwork ();
+    }
+}
+
+/// Route a control packet to dest from the given router
+static void
+Route (Ptr<Ipv4GlobalRouting> routing, Ipv4Address dest)
+{
+  Ipv4Header header;
+  header.SetDestination (dest);
+  header.SetControl ();
+  Socket::SocketErrno error;
+  routing->ControlplaneRouteOutput (Create<Packet> (), header, 0, error);
+}
+
+class Ipv4GlobalRoutingParallelSpfTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingParallelSpfTestCase ();
+  virtual void DoRun (void);
+private:
+  std::string DumpRoutes (NodeContainer nodes);
+};
+
+Ipv4GlobalRoutingParallelSpfTestCase::Ipv4GlobalRoutingParallelSpfTestCase ()
+  : TestCase ("SPF on worker threads installs the same routes as one thread")
+{
+}
+
+std::string
+Ipv4GlobalRoutingParallelSpfTestCase::DumpRoutes (NodeContainer nodes)
+{
+  std::ostringstream os;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      for (uint32_t j = 0; j < routing->GetNRoutes (); j++)
+        {
+          os << i << " " << *routing->GetRoute (j) << std::endl;
+        }
+    }
+  return os.str ();
+}
+
+void
+Ipv4GlobalRoutingParallelSpfTestCase::DoRun (void)
+{
+  UintegerValue threads;
+  GlobalValue::GetValueByName ("GlobalRoutingSpfThreads", threads);
+
+  // A ring of six routers, so that opposite routers have two equal cost paths
+  NodeContainer nodes;
+  nodes.Create (6);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  ConnectRouters (nodes, nodes.GetN ());
+
+  Config::SetGlobal ("GlobalRoutingSpfThreads", UintegerValue (1));
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  std::string serial = DumpRoutes (nodes);
+  Config::SetGlobal ("GlobalRoutingSpfThreads", UintegerValue (3));
+  Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+  std::string parallel = DumpRoutes (nodes);
+  Config::SetGlobal ("GlobalRoutingSpfThreads", threads);
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_NE (serial, "", "routes were installed");
+  NS_TEST_ASSERT_MSG_EQ (parallel, serial, "same routes in the same order");
+}
+
+class Ipv4GlobalRoutingDistanceTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingDistanceTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4GlobalRoutingDistanceTestCase::Ipv4GlobalRoutingDistanceTestCase ()
+  : TestCase ("All-pairs distance matrix and its binary dump")
+{
+}
+
+void
+Ipv4GlobalRoutingDistanceTestCase::DoRun (void)
+{
+  // A chain of four routers and a fifth router without links
+  NodeContainer nodes;
+  nodes.Create (5);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  ConnectRouters (nodes, 3);
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  uint32_t n = NodeList::GetNNodes ();
+  std::vector<uint16_t> expected (n * n, GlobalRouteManagerImpl::DISTANCE_UNREACHABLE);
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      for (uint32_t j = 0; j < 5; j++)
+        {
+          uint32_t from = nodes.Get (i)->GetId ();
+          uint32_t to = nodes.Get (j)->GetId ();
+          if (i == j || (i < 4 && j < 4))
+            {
+              expected[from * n + to] = i < j ? j - i : i - j;
+            }
+          NS_TEST_ASSERT_MSG_EQ (GlobalRouteManager::GetDistance (from, to), expected[from * n + to],
+                                 "distance from " << i << " to " << j);
+        }
+    }
+
+  std::string filename = CreateTempDirFilename ("distances.bin");
+  NS_TEST_ASSERT_MSG_EQ (GlobalRouteManager::WriteDistanceMatrix (filename), true, "matrix written");
+  Simulator::Destroy ();
+
+  std::ifstream in (filename.c_str (), std::ios::in | std::ios::binary);
+  uint32_t header[2] = { 0, 0 };
+  in.read (reinterpret_cast<char *> (header), sizeof (header));
+  NS_TEST_ASSERT_MSG_EQ (header[0], GlobalRouteManagerImpl::DISTANCE_MAGIC, "magic");
+  NS_TEST_ASSERT_MSG_EQ (header[1], n, "number of nodes");
+  std::vector<uint16_t> matrix (n * n);
+  in.read (reinterpret_cast<char *> (&matrix[0]), matrix.size () * sizeof (uint16_t));
+  NS_TEST_ASSERT_MSG_EQ (in.gcount (), static_cast<std::streamsize> (matrix.size () * sizeof (uint16_t)), "whole matrix read");
+  NS_TEST_ASSERT_MSG_EQ ((matrix == expected), true, "dumped matrix");
+}
+
+class Ipv4GlobalRoutingDdcPerNodeTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingDdcPerNodeTestCase ();
+  virtual void DoRun (void);
+private:
+  uint32_t CountDestinations (bool perNode);
+};
+
+Ipv4GlobalRoutingDdcPerNodeTestCase::Ipv4GlobalRoutingDdcPerNodeTestCase ()
+  : TestCase ("DDC state per destination node instead of per address")
+{
+}
+
+uint32_t
+Ipv4GlobalRoutingDdcPerNodeTestCase::CountDestinations (bool perNode)
+{
+  Config::SetGlobal ("GlobalRoutingDdcPerNode", BooleanValue (perNode));
+  // A chain of four routers, the inner two have two addresses each
+  NodeContainer nodes;
+  nodes.Create (4);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  ConnectRouters (nodes, 3);
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  uint32_t destinations = 0;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      NS_TEST_EXPECT_MSG_EQ (routing->GetNDestinations (), (perNode ? 4 : 6), "destinations of node " << i);
+      destinations += routing->GetNDestinations ();
+    }
+  Simulator::Destroy ();
+  return destinations;
+}
+
+void
+Ipv4GlobalRoutingDdcPerNodeTestCase::DoRun (void)
+{
+  BooleanValue perNode;
+  GlobalValue::GetValueByName ("GlobalRoutingDdcPerNode", perNode);
+  uint32_t perAddress = CountDestinations (false);
+  uint32_t aggregated = CountDestinations (true);
+  Config::SetGlobal ("GlobalRoutingDdcPerNode", perNode);
+  NS_TEST_ASSERT_MSG_EQ (perAddress, 24, "one DDC state per address");
+  NS_TEST_ASSERT_MSG_EQ (aggregated, 16, "one DDC state per node");
+
+  Ptr<Ipv4DestinationAliases> aliases = Create<Ipv4DestinationAliases> ();
+  aliases->Add (Ipv4Address ("10.1.2.1"), Ipv4Address ("10.1.1.2"));
+  aliases->Add (Ipv4Address ("10.1.1.2"), Ipv4Address ("10.1.1.2"));
+  NS_TEST_ASSERT_MSG_EQ (aliases->GetN (), 1, "addresses are not their own alias");
+  NS_TEST_ASSERT_MSG_EQ (aliases->Resolve (Ipv4Address ("10.1.2.1")), Ipv4Address ("10.1.1.2"), "alias resolved");
+  NS_TEST_ASSERT_MSG_EQ (aliases->Resolve (Ipv4Address ("10.1.3.1")), Ipv4Address ("10.1.3.1"), "other addresses unchanged");
+}
+
+class Ipv4GlobalRoutingDdcMessageTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingDdcMessageTestCase ();
+  virtual void DoRun (void);
+private:
+  void MessageSent (uint32_t iface, uint32_t entries, uint32_t bytes);
+  uint32_t m_messages;
+  uint32_t m_entries;
+  uint32_t m_bytes;
+};
+
+Ipv4GlobalRoutingDdcMessageTestCase::Ipv4GlobalRoutingDdcMessageTestCase ()
+  : TestCase ("DDC locking and heartbeats as batched control messages"),
+    m_messages (0),
+    m_entries (0),
+    m_bytes (0)
+{
+}
+
+void
+Ipv4GlobalRoutingDdcMessageTestCase::MessageSent (uint32_t iface, uint32_t entries, uint32_t bytes)
+{
+  NS_TEST_EXPECT_MSG_EQ (bytes, DdcMessageHeader::GetFixedSize () + entries * DdcMessageHeader::GetEntrySize (), "message size");
+  m_messages++;
+  m_entries += entries;
+  m_bytes += bytes;
+}
+
+void
+Ipv4GlobalRoutingDdcMessageTestCase::DoRun (void)
+{
+  DdcMessageHeader header;
+  header.SetSender (7);
+  header.AddEntry (DdcMessageHeader::LockRequest, Ipv4Address ("10.1.1.1"), 0);
+  header.AddEntry (DdcMessageHeader::Heartbeat, Ipv4Address ("10.1.2.2"), 3);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 24, "two entries on the wire");
+  DdcMessageHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetSender (), 7, "sender");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNEntries (), 2, "entries");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)received.GetEntry (1).m_type, DdcMessageHeader::Heartbeat, "entry type");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntry (1).m_destination, Ipv4Address ("10.1.2.2"), "entry destination");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntry (1).m_value, 3, "entry value");
+
+  // A chain of three routers that run the AEO over the wire
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DdcMessages", BooleanValue (true));
+  NodeContainer nodes;
+  nodes.Create (3);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DdcMessages", BooleanValue (false));
+  ConnectRouters (nodes, 2);
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      routing->TraceConnectWithoutContext ("DdcMessageTx", MakeCallback (&Ipv4GlobalRoutingDdcMessageTestCase::MessageSent, this));
+    }
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  uint64_t sent = 0;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      NS_TEST_EXPECT_MSG_GT (routing->GetDdcMessagesSent (), 0, "node " << i << " took part");
+      sent += routing->GetDdcMessagesSent ();
+    }
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (sent, m_messages, "every message traced");
+  NS_TEST_ASSERT_MSG_GT (m_entries, m_messages, "destinations share messages");
+}
+
+class Ipv4GlobalRoutingBatchHeartbeatsTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingBatchHeartbeatsTestCase ();
+  virtual void DoRun (void);
+private:
+  /// Output links of every (router, destination, interface) after two rounds
+  std::vector<bool> BuildDag (bool batch);
+};
+
+Ipv4GlobalRoutingBatchHeartbeatsTestCase::Ipv4GlobalRoutingBatchHeartbeatsTestCase ()
+  : TestCase ("Batched heartbeats build the same DDC DAG")
+{
+}
+
+std::vector<bool>
+Ipv4GlobalRoutingBatchHeartbeatsTestCase::BuildDag (bool batch)
+{
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::BatchHeartbeats", BooleanValue (batch));
+  // A ring of five, so that every router has neighbours on both sides
+  // of its position in the order while shortest paths stay unique
+  NodeContainer nodes;
+  nodes.Create (5);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::BatchHeartbeats", BooleanValue (false));
+  ConnectRouters (nodes, nodes.GetN ());
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Simulator::Schedule (Seconds (1), &GlobalRouteManagerImpl::SendHeartbeats,
+                       SimulationSingleton<GlobalRouteManagerImpl>::Get ());
+  Simulator::Stop (Seconds (2));
+  Simulator::Run ();
+
+  std::vector<bool> dag;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      NS_TEST_EXPECT_MSG_EQ (routing->GetBatchHeartbeats (), batch, "attribute of node " << i);
+      Ptr<Ipv4> ipv4 = nodes.Get (i)->GetObject<Ipv4> ();
+      for (uint32_t d = 0; d < nodes.GetN (); d++)
+        {
+          Ipv4Address dest = nodes.Get (d)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+          for (uint32_t iface = 1; iface < ipv4->GetNInterfaces (); iface++)
+            {
+              dag.push_back (routing->IsOutputLink (dest, iface));
+            }
+        }
+    }
+  Simulator::Destroy ();
+  return dag;
+}
+
+void
+Ipv4GlobalRoutingBatchHeartbeatsTestCase::DoRun (void)
+{
+  std::vector<bool> single = BuildDag (false);
+  std::vector<bool> batched = BuildDag (true);
+  NS_TEST_ASSERT_MSG_EQ (single.size (), 5 * 10, "one entry per destination and link end");
+  uint32_t outputs = 0;
+  for (uint32_t i = 0; i < single.size (); i++)
+    {
+      outputs += single[i];
+    }
+  NS_TEST_ASSERT_MSG_GT (outputs, 0, "the AEO set output links");
+  NS_TEST_ASSERT_MSG_EQ ((single == batched), true, "same DAG");
+}
+
+class Ipv4GlobalRoutingVnodesTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingVnodesTestCase ();
+  virtual void DoRun (void);
+private:
+  void AeoDeferred (Ipv4Address dest, Time waited);
+  /// Output links of every (router, destination, interface) after a
+  /// heartbeat round, and the deferred AEOs counted by the routers
+  std::vector<bool> BuildDag (uint32_t vnodes, uint64_t &deferred);
+  uint32_t m_traced;
+  Time m_waited;
+};
+
+Ipv4GlobalRoutingVnodesTestCase::Ipv4GlobalRoutingVnodesTestCase ()
+  : TestCase ("DDC with a ring of more than two vnodes"),
+    m_traced (0)
+{
+}
+
+void
+Ipv4GlobalRoutingVnodesTestCase::AeoDeferred (Ipv4Address dest, Time waited)
+{
+  m_traced++;
+  m_waited += waited;
+}
+
+std::vector<bool>
+Ipv4GlobalRoutingVnodesTestCase::BuildDag (uint32_t vnodes, uint64_t &deferred)
+{
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::Vnodes", UintegerValue (vnodes));
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DdcMessages", BooleanValue (true));
+  // Simple channels have no delay; collecting messages makes locks stay
+  // out for a while
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DdcMessageBatchDelay", TimeValue (MilliSeconds (1)));
+  NodeContainer nodes;
+  nodes.Create (5);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::Vnodes", UintegerValue (2));
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DdcMessages", BooleanValue (false));
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DdcMessageBatchDelay", TimeValue (MicroSeconds (0)));
+  ConnectRouters (nodes, nodes.GetN ());
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      routing->TraceConnectWithoutContext ("AeoDeferred", MakeCallback (&Ipv4GlobalRoutingVnodesTestCase::AeoDeferred, this));
+    }
+  // Neighbours that start an AEO for the same destination at once grant
+  // each other's lock requests, so each finds its own vnode pinned
+  Ipv4Address far = nodes.Get (3)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      Simulator::Schedule (Seconds (1), &Ipv4GlobalRouting::PrimitiveAEO, routing, far);
+    }
+  m_traced = 0;
+  m_waited = Seconds (0);
+  Simulator::Stop (Seconds (2));
+  Simulator::Run ();
+
+  std::vector<bool> dag;
+  deferred = 0;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      deferred += routing->GetAeosDeferred ();
+      Ptr<Ipv4> ipv4 = nodes.Get (i)->GetObject<Ipv4> ();
+      for (uint32_t d = 0; d < nodes.GetN (); d++)
+        {
+          Ipv4Address dest = nodes.Get (d)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+          for (uint32_t iface = 1; iface < ipv4->GetNInterfaces (); iface++)
+            {
+              dag.push_back (routing->IsOutputLink (dest, iface));
+            }
+        }
+    }
+  Simulator::Destroy ();
+  return dag;
+}
+
+void
+Ipv4GlobalRoutingVnodesTestCase::DoRun (void)
+{
+  uint64_t twoDeferred;
+  std::vector<bool> two = BuildDag (2, twoDeferred);
+  uint32_t twoTraced = m_traced;
+  Time twoWaited = m_waited;
+  uint64_t threeDeferred;
+  std::vector<bool> three = BuildDag (3, threeDeferred);
+  NS_TEST_ASSERT_MSG_EQ (twoDeferred, 1, "the denied AEO waited");
+  NS_TEST_ASSERT_MSG_EQ (twoTraced, twoDeferred, "deferred AEO went through");
+  NS_TEST_ASSERT_MSG_EQ (m_traced, threeDeferred, "deferred AEO went through");
+  NS_TEST_ASSERT_MSG_EQ ((m_waited < twoWaited), true, "a third vnode shortens the wait");
+  NS_TEST_ASSERT_MSG_EQ ((two == three), true, "same DAG");
+}
+
+class Ipv4GlobalRoutingDdcMemoryTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingDdcMemoryTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4GlobalRoutingDdcMemoryTestCase::Ipv4GlobalRoutingDdcMemoryTestCase ()
+  : TestCase ("DDC memory accounting")
+{
+}
+
+void
+Ipv4GlobalRoutingDdcMemoryTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (5);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  ConnectRouters (nodes, nodes.GetN ());
+  Ptr<Ipv4GlobalRouting> routing = nodes.Get (0)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+  uint64_t empty = routing->GetDdcMemoryUsage ();
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  // Two addresses per node, all of them destinations
+  NS_TEST_ASSERT_MSG_EQ (routing->GetNDestinations (), 10, "one state per address");
+  uint64_t used = routing->GetDdcMemoryUsage ();
+  NS_TEST_ASSERT_MSG_GT (used, empty + 10 * 3 * sizeof (uint32_t), "states are counted");
+  UintegerValue attribute;
+  routing->GetAttribute ("DdcMemoryUsage", attribute);
+  NS_TEST_ASSERT_MSG_EQ (attribute.Get (), used, "attribute reports the same");
+
+  // AEOs clear vnodes in place
+  Ipv4Address far = nodes.Get (2)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Simulator::Schedule (Seconds (i + 1), &Ipv4GlobalRouting::PrimitiveAEO, routing, far);
+    }
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (routing->GetDdcMemoryUsage (), used, "no growth across AEOs");
+  Simulator::Destroy ();
+}
+
+class Ipv4GlobalRoutingReversalQueueTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingReversalQueueTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4GlobalRoutingReversalQueueTestCase::Ipv4GlobalRoutingReversalQueueTestCase ()
+  : TestCase ("Delayed DDC reversals are queued once per link")
+{
+}
+
+void
+Ipv4GlobalRoutingReversalQueueTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::ReverseInputToOutputDelay", TimeValue (MilliSeconds (10)));
+  NodeContainer nodes;
+  nodes.Create (5);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::ReverseInputToOutputDelay", TimeValue (MicroSeconds (0)));
+  ConnectRouters (nodes, nodes.GetN ());
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  // Node 2's AEO made its link to node 1 an input of node 1, which has no
+  // output towards node 2 yet
+  Ptr<Ipv4GlobalRouting> routing = nodes.Get (1)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+  Ipv4Address dest = nodes.Get (2)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  uint32_t toNode2 = 2;
+  NS_TEST_ASSERT_MSG_EQ (routing->IsOutputLink (dest, 1), false, "no output");
+  NS_TEST_ASSERT_MSG_EQ (routing->IsOutputLink (dest, toNode2), false, "no output");
+
+  // Each packet asks for the input to be reversed; only the first request
+  // is queued
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Simulator::Schedule (MilliSeconds (i), &Route, routing, dest);
+    }
+  Simulator::Stop (MilliSeconds (5));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (routing->IsOutputLink (dest, toNode2), false, "reversal still waiting");
+  NS_TEST_EXPECT_MSG_EQ (routing->GetReversalsSuppressed (), 2, "duplicates suppressed");
+  Simulator::Stop (MilliSeconds (10));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (routing->IsOutputLink (dest, toNode2), true, "reversed after the delay");
+  NS_TEST_EXPECT_MSG_EQ (routing->IsOutputLink (dest, 1), false, "only inputs are reversed");
+  Simulator::Destroy ();
+}
+
+class Ipv4GlobalRoutingStretchTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingStretchTestCase ();
+  virtual void DoRun (void);
+private:
+  void Deliver (Ptr<const Packet> p, const Ipv4Header &header, uint32_t iif);
+  uint32_t m_delivered;
+};
+
+Ipv4GlobalRoutingStretchTestCase::Ipv4GlobalRoutingStretchTestCase ()
+  : TestCase ("Per-packet stretch with distance ranked DDC links"),
+    m_delivered (0)
+{
+}
+
+void
+Ipv4GlobalRoutingStretchTestCase::Deliver (Ptr<const Packet> p, const Ipv4Header &header, uint32_t iif)
+{
+  m_delivered++;
+}
+
+void
+Ipv4GlobalRoutingStretchTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DistanceRanking", BooleanValue (true));
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::RecordStretch", BooleanValue (true));
+  NodeContainer nodes;
+  nodes.Create (5);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::DistanceRanking", BooleanValue (false));
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::RecordStretch", BooleanValue (false));
+  ConnectRouters (nodes, nodes.GetN ());
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  // Node 0 is two hops from node 2 around the short side of the ring and
+  // three around the long side
+  Ptr<Ipv4> ipv4 = nodes.Get (2)->GetObject<Ipv4> ();
+  Ptr<Ipv4GlobalRouting> routing = nodes.Get (2)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+  NS_TEST_ASSERT_MSG_EQ (routing->GetDistanceRanking (), true, "distance ranking");
+  Ipv4Header header;
+  header.SetSource (nodes.Get (0)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ());
+  header.SetDestination (ipv4->GetAddress (1, 0).GetLocal ());
+  Ipv4RoutingProtocol::LocalDeliverCallback lcb =
+    MakeCallback (&Ipv4GlobalRoutingStretchTestCase::Deliver, this);
+  uint8_t ttls[] = { 63, 61 };
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      header.SetTtl (ttls[i]);
+      routing->RouteInput (Create<Packet> (), header, ipv4->GetNetDevice (1),
+                           Ipv4RoutingProtocol::UnicastForwardCallback (),
+                           Ipv4RoutingProtocol::MulticastForwardCallback (),
+                           lcb, Ipv4RoutingProtocol::ErrorCallback ());
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_delivered, 2, "delivered locally");
+  NS_TEST_EXPECT_MSG_EQ (routing->GetStretchPackets (), 2, "packets with a stretch");
+  NS_TEST_EXPECT_MSG_EQ_TOL (routing->GetMaxStretch (), 2.0, 1e-9, "four hops over two");
+  NS_TEST_EXPECT_MSG_EQ_TOL (routing->GetMeanStretch (), 1.5, 1e-9, "mean of one and two");
+  Simulator::Destroy ();
+}
+
+class Ipv4GlobalRoutingSaveStateTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingSaveStateTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4GlobalRoutingSaveStateTestCase::Ipv4GlobalRoutingSaveStateTestCase ()
+  : TestCase ("Restoring converged DDC state undoes reversals")
+{
+}
+
+void
+Ipv4GlobalRoutingSaveStateTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::ReverseInputToOutputDelay", TimeValue (MilliSeconds (10)));
+  NodeContainer nodes;
+  nodes.Create (5);
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::ReverseInputToOutputDelay", TimeValue (MicroSeconds (0)));
+  ConnectRouters (nodes, nodes.GetN ());
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  GlobalRouteManager::SaveRoutingState ();
+
+  // As in the reversal queue test, node 1 has no output towards node 2
+  // until a packet reverses its input
+  Ptr<Ipv4GlobalRouting> routing = nodes.Get (1)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+  Ipv4Address dest = nodes.Get (2)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  uint32_t toNode2 = 2;
+  Route (routing, dest);
+  Route (routing, dest);
+  Simulator::Stop (MilliSeconds (20));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (routing->IsOutputLink (dest, toNode2), true, "reversed");
+  NS_TEST_EXPECT_MSG_EQ (routing->GetReversalsSuppressed (), 1, "duplicate suppressed");
+
+  GlobalRouteManager::RestoreRoutingState ();
+  NS_TEST_EXPECT_MSG_EQ (routing->IsOutputLink (dest, toNode2), false, "reversal undone");
+  NS_TEST_EXPECT_MSG_EQ (routing->GetReversalsSuppressed (), 0, "counters restored");
+
+  // A reversal still waiting for its delay is dropped with the scenario
+  Route (routing, dest);
+  Simulator::Stop (MilliSeconds (5));
+  Simulator::Run ();
+  GlobalRouteManager::RestoreRoutingState ();
+  Simulator::Stop (MilliSeconds (20));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (routing->IsOutputLink (dest, toNode2), false, "queued reversal cancelled");
+
+  // The restored state behaves like the converged one
+  Route (routing, dest);
+  Simulator::Stop (MilliSeconds (20));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (routing->IsOutputLink (dest, toNode2), true, "reversed again");
+  Simulator::Destroy ();
+}
+
+static class Ipv4GlobalRoutingTestSuite : public TestSuite
+{
+public:
+  Ipv4GlobalRoutingTestSuite ()
+    : TestSuite ("ipv4-global-routing", UNIT)
+  {
+    AddTestCase (new Ipv4GlobalRoutingPrefixTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingEcmpTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingFlowEcmpTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingUpdateTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingParallelSpfTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingDistanceTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingDdcPerNodeTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingDdcMessageTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingBatchHeartbeatsTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingVnodesTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingDdcMemoryTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingReversalQueueTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingStretchTestCase ());
+    AddTestCase (new Ipv4GlobalRoutingSaveStateTestCase ());
+  }
+} g_ipv4GlobalRoutingTestSuite;
+
+} // namespace ns3
@@ -42,6 +42,7 @@
 #include <string>
 #include <sstream>
 #include <limits>
+#include <cstring>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -255,12 +256,82 @@ Ipv4HeaderTest::DoRun (void)
   Simulator::Destroy ();
 }
 //-----------------------------------------------------------------------------
+// @apanda
+class Ipv4HeaderDdcTest : public TestCase
+{
+public:
+  Ipv4HeaderDdcTest ();
+  virtual void DoRun (void);
+private:
+  Ipv4Header RoundTrip (const Ipv4Header &header, uint32_t &size);
+};
+
+Ipv4HeaderDdcTest::Ipv4HeaderDdcTest ()
+  : TestCase ("DDC fields only on control packets")
+{
+}
+
+Ipv4Header
+Ipv4HeaderDdcTest::RoundTrip (const Ipv4Header &header, uint32_t &size)
+{
+  // The payload catches writes past the end of the header
+  uint8_t payload[8] = { 0xa5, 0xa5, 0xa5, 0xa5, 0xa5, 0xa5, 0xa5, 0xa5 };
+  Ptr<Packet> p = Create<Packet> (payload, sizeof (payload));
+  p->AddHeader (header);
+  size = p->GetSize ();
+  Ipv4Header received;
+  received.EnableChecksum ();
+  p->RemoveHeader (received);
+  uint8_t after[8];
+  p->CopyData (after, sizeof (after));
+  NS_TEST_EXPECT_MSG_EQ ((memcmp (payload, after, sizeof (payload)) == 0), true, "payload untouched");
+  NS_TEST_EXPECT_MSG_EQ (received.IsChecksumOk (), true, "checksum");
+  NS_TEST_EXPECT_MSG_EQ (received.GetSource (), header.GetSource (), "source");
+  NS_TEST_EXPECT_MSG_EQ (received.GetDestination (), header.GetDestination (), "destination");
+  NS_TEST_EXPECT_MSG_EQ (received.GetPayloadSize (), 8, "payload size");
+  return received;
+}
+
+void
+Ipv4HeaderDdcTest::DoRun (void)
+{
+  Ipv4Header header;
+  header.EnableChecksum ();
+  header.SetSource (Ipv4Address ("10.0.0.1"));
+  header.SetDestination (Ipv4Address ("10.0.0.2"));
+  header.SetPayloadSize (8);
+  header.SetTtl (64);
+  header.SetSeq (1);
+  header.SetVnode (5);
+
+  uint32_t size;
+  Ipv4Header data = RoundTrip (header, size);
+  NS_TEST_ASSERT_MSG_EQ (size, 20 + 8, "standard header on the data plane");
+  NS_TEST_EXPECT_MSG_EQ (data.IsControl (), false, "data packet");
+  NS_TEST_EXPECT_MSG_EQ (data.GetSeq (), 0, "no DDC sequence number on the data plane");
+  NS_TEST_EXPECT_MSG_EQ (data.GetVnode (), 0, "no DDC vnode on the data plane");
+
+  header.SetControl ();
+  Ipv4Header control = RoundTrip (header, size);
+  NS_TEST_ASSERT_MSG_EQ (size, 24 + 8, "DDC option on control packets");
+  NS_TEST_EXPECT_MSG_EQ (control.IsControl (), true, "control packet");
+  NS_TEST_EXPECT_MSG_EQ (control.GetSeq (), 1, "DDC sequence number");
+  NS_TEST_EXPECT_MSG_EQ (control.GetVnode (), 5, "DDC vnode");
+
+  header.SetSeq (0);
+  header.SetVnode (Ipv4Header::GetMaxVnode ());
+  control = RoundTrip (header, size);
+  NS_TEST_EXPECT_MSG_EQ (control.GetSeq (), 0, "DDC sequence number");
+  NS_TEST_EXPECT_MSG_EQ (control.GetVnode (), Ipv4Header::GetMaxVnode (), "largest DDC vnode");
+}
+//-----------------------------------------------------------------------------
 class Ipv4HeaderTestSuite : public TestSuite
 {
 public:
   Ipv4HeaderTestSuite () : TestSuite ("ipv4-header", UNIT)
   {
     AddTestCase (new Ipv4HeaderTest);
+    AddTestCase (new Ipv4HeaderDdcTest);
   }
 } g_ipv4HeaderTestSuite;
 
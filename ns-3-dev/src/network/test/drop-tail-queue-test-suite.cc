@@ -19,6 +19,8 @@
 #include "ns3/test.h"
 #include "ns3/drop-tail-queue.h"
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/shared-buffer.h"
 
 namespace ns3 {
 
@@ -77,6 +79,56 @@ DropTailQueueTestCase::DoRun (void)
   NS_TEST_EXPECT_MSG_EQ ((p == 0), true, "There are really no packets in there");
 }
 
+class DropTailQueueSharedBufferTestCase : public TestCase
+{
+public:
+  DropTailQueueSharedBufferTestCase ();
+  virtual void DoRun (void);
+};
+
+DropTailQueueSharedBufferTestCase::DropTailQueueSharedBufferTestCase ()
+  : TestCase ("Drop tail queues in a shared buffer keep their own limit")
+{
+}
+
+void
+DropTailQueueSharedBufferTestCase::DoRun (void)
+{
+  Ptr<SharedBuffer> buffer = CreateObject<SharedBuffer> ();
+  buffer->SetAttribute ("Size", UintegerValue (1000));
+  buffer->SetAttribute ("Alpha", DoubleValue (1.0));
+  Ptr<DropTailQueue> a = CreateObject<DropTailQueue> ();
+  Ptr<DropTailQueue> b = CreateObject<DropTailQueue> ();
+  b->SetAttribute ("MaxPackets", UintegerValue (2));
+  a->SetSharedBuffer (buffer);
+  b->SetSharedBuffer (buffer);
+  NS_TEST_ASSERT_MSG_EQ (buffer->GetNPorts (), 2, "two ports");
+
+  // Queue a holds as much as is left free
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      a->Enqueue (Create<Packet> (100));
+    }
+  NS_TEST_EXPECT_MSG_EQ (a->GetNBytes (), 500, "500 held, 500 free");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetAdmissionDrops (), 1, "refused by the buffer");
+
+  // Queue b hits its own limit before the buffer's
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      b->Enqueue (Create<Packet> (100));
+    }
+  NS_TEST_EXPECT_MSG_EQ (b->GetNPackets (), 2, "MaxPackets still applies");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetAdmissionDrops (), 1, "not refused by the buffer");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetOccupancy (), 700, "occupancy");
+
+  // Dequeued and flushed packets return their bytes
+  a->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetOccupancy (), 600, "dequeue releases");
+  a->DequeueAll ();
+  b->DequeueAll ();
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetOccupancy (), 0, "flush releases");
+}
+
 static class DropTailQueueTestSuite : public TestSuite
 {
 public:
@@ -84,6 +136,7 @@ public:
     : TestSuite ("drop-tail-queue", UNIT)
   {
     AddTestCase (new DropTailQueueTestCase ());
+    AddTestCase (new DropTailQueueSharedBufferTestCase ());
   }
 } g_dropTailQueueTestSuite;
 
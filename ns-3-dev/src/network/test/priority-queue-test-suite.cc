@@ -0,0 +1,271 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/priority-queue.h"
+#include "ns3/priority-tag.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/enum.h"
+#include "ns3/double.h"
+#include "ns3/shared-buffer.h"
+
+namespace ns3 {
+
+static Ptr<Packet>
+CreateTaggedPacket (uint8_t priority, uint32_t flow, uint32_t seq, uint32_t size)
+{
+  Ptr<Packet> p = Create<Packet> (size);
+  PriorityTag tag;
+  tag.SetPriority (priority);
+  tag.SetId (flow);
+  tag.m_seq = seq;
+  p->AddPacketTag (tag);
+  return p;
+}
+
+class PriorityQueueStrictTestCase : public TestCase
+{
+public:
+  PriorityQueueStrictTestCase ();
+  virtual void DoRun (void);
+};
+
+PriorityQueueStrictTestCase::PriorityQueueStrictTestCase ()
+  : TestCase ("Strict priority order, clamping and drops")
+{
+}
+
+void
+PriorityQueueStrictTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  queue->SetAttribute ("Mode", EnumValue (Queue::QUEUE_MODE_PACKETS));
+  queue->SetAttribute ("MaxPackets", UintegerValue (4));
+  NS_TEST_EXPECT_MSG_EQ (queue->GetClasses (), NUM_PRIORITY_QUEUES, "default classes");
+
+  Ptr<Packet> control = CreateTaggedPacket (255, 0, 0, 10);
+  Ptr<Packet> p2 = CreateTaggedPacket (2, 1, 0, 10);
+  Ptr<Packet> p0 = CreateTaggedPacket (0, 1, 0, 10);
+  Ptr<Packet> p1 = CreateTaggedPacket (1, 1, 0, 10);
+  queue->Enqueue (control);
+  queue->Enqueue (p2);
+  queue->Enqueue (p0);
+  queue->Enqueue (p1);
+  NS_TEST_EXPECT_MSG_EQ (queue->GetClassPackets (NUM_PRIORITY_QUEUES - 1), 1, "control packet in the last class");
+
+  // A full queue makes room by dropping the lowest priority packet
+  Ptr<Packet> p3 = CreateTaggedPacket (0, 1, 0, 10);
+  NS_TEST_EXPECT_MSG_EQ (queue->Enqueue (p3), true, "enqueued over a lower priority packet");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetClassPackets (NUM_PRIORITY_QUEUES - 1), 0, "control packet dropped");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 4, "still full");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetTotalDroppedPackets (), 1, "one drop");
+
+  Ptr<Packet> expected[] = { p0, p3, p1, p2 };
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (queue->Peek ()->GetUid (), expected[i]->GetUid (), "peek " << i);
+      NS_TEST_EXPECT_MSG_EQ (queue->Dequeue ()->GetUid (), expected[i]->GetUid (), "dequeue " << i);
+    }
+  NS_TEST_EXPECT_MSG_EQ ((queue->Dequeue () == 0), true, "empty");
+}
+
+class PriorityQueueFlowTestCase : public TestCase
+{
+public:
+  PriorityQueueFlowTestCase ();
+  virtual void DoRun (void);
+};
+
+PriorityQueueFlowTestCase::PriorityQueueFlowTestCase ()
+  : TestCase ("Flushing and draining a flow")
+{
+}
+
+void
+PriorityQueueFlowTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  for (uint32_t seq = 1; seq <= 3; seq++)
+    {
+      for (uint8_t priority = 0; priority < 3; priority++)
+        {
+          queue->Enqueue (CreateTaggedPacket (priority, 7, seq, 100));
+          queue->Enqueue (CreateTaggedPacket (priority, 8, seq + 10, 100));
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 18, "all queued");
+
+  // Class 0 is never flushed or drained
+  queue->FlushOutFlowPackets (7);
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 12, "flow 7 flushed from classes 1 and 2");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetTotalDroppedPackets (), 0, "flushing does not count drops");
+  NS_TEST_EXPECT_MSG_EQ (queue->drainLowPriority (8), 13, "highest drained sequence number");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 6, "flow 8 drained from classes 1 and 2");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetTotalDroppedPackets (), 6, "draining drops");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (), 600, "bytes");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetClassBytes (0), 600, "class 0 untouched");
+
+  // The flow index still matches the classes
+  queue->Enqueue (CreateTaggedPacket (1, 7, 4, 100));
+  queue->FlushOutFlowPackets (7);
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      queue->Dequeue ();
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 0, "empty");
+  NS_TEST_EXPECT_MSG_EQ ((queue->Dequeue () == 0), true, "nothing left");
+}
+
+class PriorityQueueDrrTestCase : public TestCase
+{
+public:
+  PriorityQueueDrrTestCase ();
+  virtual void DoRun (void);
+};
+
+PriorityQueueDrrTestCase::PriorityQueueDrrTestCase ()
+  : TestCase ("Deficit round robin between weighted classes")
+{
+}
+
+void
+PriorityQueueDrrTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  queue->SetAttribute ("Classes", UintegerValue (3));
+  queue->SetAttribute ("Weights", StringValue ("2,1"));
+  queue->SetAttribute ("Quantum", UintegerValue (100));
+  StringValue weights;
+  queue->GetAttribute ("Weights", weights);
+  NS_TEST_EXPECT_MSG_EQ (weights.Get (), "2,1", "weights");
+
+  // Class 2 weighs 1 as it is past the list, and its 250 byte packets need
+  // three rounds of credit for the first and two for the next
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      queue->Enqueue (CreateTaggedPacket (0, 0, i, 100));
+      queue->Enqueue (CreateTaggedPacket (1, 0, i, 100));
+    }
+  queue->Enqueue (CreateTaggedPacket (2, 0, 0, 250));
+  queue->Enqueue (CreateTaggedPacket (2, 0, 1, 250));
+
+  uint32_t expected[] = { 0, 0, 1, 0, 0, 1, 0, 0, 1, 2, 1, 1, 2, 1 };
+  for (uint32_t i = 0; i < 14; i++)
+    {
+      Ptr<const Packet> peeked = queue->Peek ();
+      Ptr<Packet> p = queue->Dequeue ();
+      NS_TEST_EXPECT_MSG_EQ (peeked->GetUid (), p->GetUid (), "peek matches dequeue " << i);
+      PriorityTag tag;
+      p->PeekPacketTag (tag);
+      NS_TEST_EXPECT_MSG_EQ ((uint32_t)tag.GetPriority (), expected[i], "class of packet " << i);
+    }
+  NS_TEST_EXPECT_MSG_EQ ((queue->Dequeue () == 0), true, "empty");
+}
+
+class PriorityQueueSharedBufferTestCase : public TestCase
+{
+public:
+  PriorityQueueSharedBufferTestCase ();
+  virtual void DoRun (void);
+};
+
+PriorityQueueSharedBufferTestCase::PriorityQueueSharedBufferTestCase ()
+  : TestCase ("Dynamic threshold admission into a shared buffer")
+{
+}
+
+void
+PriorityQueueSharedBufferTestCase::DoRun (void)
+{
+  Ptr<SharedBuffer> buffer = CreateObject<SharedBuffer> ();
+  buffer->SetAttribute ("Size", UintegerValue (1000));
+  buffer->SetAttribute ("Alpha", DoubleValue (1.0));
+  buffer->SetAttribute ("Reserved", StringValue ("100"));
+  Ptr<PriorityQueue> a = CreateObject<PriorityQueue> ();
+  Ptr<PriorityQueue> b = CreateObject<PriorityQueue> ();
+  a->SetSharedBuffer (buffer);
+  b->SetSharedBuffer (buffer);
+  NS_TEST_ASSERT_MSG_EQ (buffer->GetNPorts (), 2, "two ports");
+  NS_TEST_ASSERT_MSG_EQ (buffer->GetSharedSize (), 800, "class 0 of each port reserves 100 bytes");
+
+  // Port a grows into the pool until it holds as much as is left free
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      a->Enqueue (CreateTaggedPacket (1, 0, i, 100));
+    }
+  NS_TEST_EXPECT_MSG_EQ (a->GetNBytes (), 400, "400 held, 400 free");
+  NS_TEST_EXPECT_MSG_EQ (a->GetTotalDroppedPackets (), 1, "refused by the buffer");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetThreshold (1, 1), 400, "port b may take as much as is free");
+
+  // Port b gets less of what remains, but its reservation is always there
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      b->Enqueue (CreateTaggedPacket (1, 0, i, 100));
+    }
+  NS_TEST_EXPECT_MSG_EQ (b->GetClassBytes (1), 200, "200 held, 200 free");
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      b->Enqueue (CreateTaggedPacket (0, 0, i, 100));
+    }
+  NS_TEST_EXPECT_MSG_EQ (b->GetClassBytes (0), 200, "reservation and 100 shared bytes");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetOccupancy (), 800, "occupancy");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetSharedOccupancy (), 700, "shared occupancy");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetAdmissionDrops (), 3, "admission drops");
+
+  // Leaving packets return their bytes
+  a->Dequeue ();
+  b->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetSharedOccupancy (), 500, "reservation emptied last");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetQueueOccupancy (1, 0), 100, "class 0 of port b");
+  a->FlushOutFlowPackets (0);
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetOccupancy (), 300, "flushed bytes returned");
+  NS_TEST_EXPECT_MSG_EQ (buffer->GetPeakOccupancy (), 800, "peak");
+
+  // A full queue evicts lower classes only for packets the buffer admits
+  Ptr<SharedBuffer> small = CreateObject<SharedBuffer> ();
+  small->SetAttribute ("Size", UintegerValue (300));
+  small->SetAttribute ("Alpha", DoubleValue (1.0));
+  small->SetAttribute ("Reserved", StringValue ("0"));
+  Ptr<PriorityQueue> c = CreateObject<PriorityQueue> ();
+  c->SetAttribute ("Mode", EnumValue (Queue::QUEUE_MODE_PACKETS));
+  c->SetAttribute ("MaxPackets", UintegerValue (2));
+  c->SetSharedBuffer (small);
+  c->Enqueue (CreateTaggedPacket (1, 0, 0, 100));
+  c->Enqueue (CreateTaggedPacket (1, 0, 1, 100));
+  NS_TEST_EXPECT_MSG_EQ (c->Enqueue (CreateTaggedPacket (0, 1, 0, 250)), false, "more than is free");
+  NS_TEST_EXPECT_MSG_EQ (c->GetNPackets (), 2, "nothing evicted for it");
+  NS_TEST_EXPECT_MSG_EQ (c->GetTotalDroppedPackets (), 1, "only the arrival dropped");
+  NS_TEST_EXPECT_MSG_EQ (small->GetOccupancy (), 200, "buffer unchanged");
+  NS_TEST_EXPECT_MSG_EQ (c->Enqueue (CreateTaggedPacket (0, 1, 1, 50)), true, "admitted");
+  NS_TEST_EXPECT_MSG_EQ (c->GetClassPackets (1), 1, "a lower class packet evicted for it");
+  NS_TEST_EXPECT_MSG_EQ (small->GetOccupancy (), 150, "evicted bytes returned");
+}
+
+static class PriorityQueueTestSuite : public TestSuite
+{
+public:
+  PriorityQueueTestSuite ()
+    : TestSuite ("priority-queue", UNIT)
+  {
+    AddTestCase (new PriorityQueueStrictTestCase ());
+    AddTestCase (new PriorityQueueFlowTestCase ());
+    AddTestCase (new PriorityQueueDrrTestCase ());
+    AddTestCase (new PriorityQueueSharedBufferTestCase ());
+  }
+} g_priorityQueueTestSuite;
+
+} // namespace ns3
@@ -56,7 +56,8 @@ TypeId DropTailQueue::GetTypeId (void)
 DropTailQueue::DropTailQueue () :
   Queue (),
   m_packets (),
-  m_bytesInQueue (0)
+  m_bytesInQueue (0),
+  m_bufferPort (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -80,6 +81,21 @@ DropTailQueue::GetMode (void)
   return m_mode;
 }
 
+void
+DropTailQueue::SetSharedBuffer (Ptr<SharedBuffer> buffer)
+{
+  NS_LOG_FUNCTION (this << buffer);
+  NS_ASSERT_MSG (m_buffer == 0 && m_packets.empty (), "Cannot move a DropTailQueue to another shared buffer");
+  m_buffer = buffer;
+  m_bufferPort = buffer->AddPort (1);
+}
+
+Ptr<SharedBuffer>
+DropTailQueue::GetSharedBuffer (void) const
+{
+  return m_buffer;
+}
+
 bool 
 DropTailQueue::DoEnqueue (Ptr<Packet> p)
 {
@@ -99,6 +115,13 @@ DropTailQueue::DoEnqueue (Ptr<Packet> p)
       return false;
     }
 
+  if (m_buffer != 0 && !m_buffer->Admit (m_bufferPort, 0, p->GetSize ()))
+    {
+      NS_LOG_LOGIC ("Shared buffer full -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
   m_bytesInQueue += p->GetSize ();
   m_packets.push (p);
 
@@ -122,6 +145,10 @@ DropTailQueue::DoDequeue (void)
   Ptr<Packet> p = m_packets.front ();
   m_packets.pop ();
   m_bytesInQueue -= p->GetSize ();
+  if (m_buffer != 0)
+    {
+      m_buffer->Release (m_bufferPort, 0, p->GetSize ());
+    }
 
   NS_LOG_LOGIC ("Popped " << p);
 
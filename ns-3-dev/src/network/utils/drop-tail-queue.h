@@ -22,6 +22,7 @@
 #include <queue>
 #include "ns3/packet.h"
 #include "ns3/queue.h"
+#include "shared-buffer.h"
 
 namespace ns3 {
 
@@ -31,6 +32,10 @@ class TraceContainer;
  * \ingroup queue
  *
  * \brief A FIFO packet queue that drops tail-end packets on overflow
+ *
+ * With a SharedBuffer, packets are also admitted against the buffer shared
+ * with the other ports of the node, as one class, on top of MaxBytes or
+ * MaxPackets.
  */
 class DropTailQueue : public Queue {
 public:
@@ -59,6 +64,13 @@ public:
    */
   DropTailQueue::QueueMode GetMode (void);
 
+  /**
+   * Allocate packets from a buffer shared with other queues, before the
+   * first packet is enqueued
+   */
+  void SetSharedBuffer (Ptr<SharedBuffer> buffer);
+  Ptr<SharedBuffer> GetSharedBuffer (void) const;
+
 private:
   virtual bool DoEnqueue (Ptr<Packet> p);
   virtual Ptr<Packet> DoDequeue (void);
@@ -69,6 +81,8 @@ private:
   uint32_t m_maxBytes;
   uint32_t m_bytesInQueue;
   QueueMode m_mode;
+  Ptr<SharedBuffer> m_buffer;
+  uint32_t m_bufferPort;
 };
 
 } // namespace ns3
@@ -18,6 +18,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
 #include "ns3/simulator.h"
 #include "ns3/ptr.h"
 #include "ns3/log.h"
@@ -25,6 +28,7 @@
 #include "ns3/boolean.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/string.h"
 #include "ns3/random-variable.h"
 #include "ns3/priority-tag.h"
 #include "priority-queue.h"
@@ -71,6 +75,23 @@ TypeId PriorityQueue::GetTypeId (void)
                     DoubleValue(0.0),
                     MakeDoubleAccessor(&PriorityQueue::m_backgrounddrop),
                     MakeDoubleChecker<double> ())  
+    .AddAttribute ("Classes",
+                   "The number of priority classes; tags past the last class are queued in it.",
+                   UintegerValue (NUM_PRIORITY_QUEUES),
+                   MakeUintegerAccessor (&PriorityQueue::SetClasses,
+                                         &PriorityQueue::GetClasses),
+                   MakeUintegerChecker<uint32_t> (1, MAX_PRIORITY_QUEUES))
+    .AddAttribute ("Weights",
+                   "Comma separated deficit round robin weights of the classes, strict priority when empty.",
+                   StringValue (""),
+                   MakeStringAccessor (&PriorityQueue::SetWeights,
+                                       &PriorityQueue::GetWeights),
+                   MakeStringChecker ())
+    .AddAttribute ("Quantum",
+                   "Bytes a class of weight 1 may send per deficit round robin round.",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&PriorityQueue::m_quantum),
+                   MakeUintegerChecker<uint32_t> (1))
     ;
   return tid;
 }
@@ -79,13 +100,17 @@ void
 PriorityQueue::LogQueueLength()
 {
   //std::ofstream ofs("queuelength.txt", std::ios::app);
-  //ofs<<Simulator::Now().GetSeconds()<<"\t"<<m_id<<"\t"<<m_packets[0].size()<<"\t"<<m_totalpackets<<"\t"<<m_bytesInSubQueue[0]<<"\t"<<m_bytesInQueue<<"\n";
+  //ofs<<Simulator::Now().GetSeconds()<<"\t"<<m_id<<"\t"<<m_classes[0].m_packets.size()<<"\t"<<m_totalpackets<<"\t"<<m_classes[0].m_bytes<<"\t"<<m_bytesInQueue<<"\n";
   //ofs.close();
   //m_sendEvent = Simulator::Schedule(Seconds(0.1), &PriorityQueue::LogQueueLength, this);
 }
 
 PriorityQueue::PriorityQueue () :
   Queue (),
+  m_nonEmpty (0),
+  m_quantum (1500),
+  m_activeFresh (true),
+  m_bufferPort (0),
   m_totalpackets (0),
   m_bytesInQueue (0),
   m_id(0),
@@ -97,10 +122,7 @@ PriorityQueue::PriorityQueue () :
   //m_isPacketInfoFull(false)
 {
   NS_LOG_FUNCTION_NOARGS ();
-  for (int i=0; i< NUM_PRIORITY_QUEUES; i++){
-    m_bytesInSubQueue[i] = 0;
-    counts[i] = 0;
-  }
+  SetClasses (NUM_PRIORITY_QUEUES);
   LogQueueLength();
 }
 
@@ -124,103 +146,210 @@ PriorityQueue::GetMode (void)
 }
 
 
+void
+PriorityQueue::SetClasses (uint32_t classes)
+{
+  NS_LOG_FUNCTION (this << classes);
+  NS_ASSERT_MSG (m_totalpackets == 0, "Cannot change the classes of a non-empty PriorityQueue");
+  NS_ASSERT_MSG (m_buffer == 0, "Cannot change the classes of a PriorityQueue in a shared buffer");
+  m_classes.assign (classes, Class ());
+  m_nonEmpty = 0;
+  m_active.clear ();
+  m_activeFresh = true;
+}
+
+uint32_t
+PriorityQueue::GetClasses (void) const
+{
+  return m_classes.size ();
+}
+
+void
+PriorityQueue::SetWeights (std::string weights)
+{
+  NS_LOG_FUNCTION (this << weights);
+  NS_ASSERT_MSG (m_totalpackets == 0, "Cannot change the weights of a non-empty PriorityQueue");
+  m_weights.clear ();
+  std::istringstream in (weights);
+  std::string weight;
+  while (std::getline (in, weight, ','))
+  {
+    uint32_t w = atoi (weight.c_str ());
+    NS_ASSERT_MSG (w > 0, "Bad PriorityQueue weight \"" << weight << "\"");
+    m_weights.push_back (w);
+  }
+}
+
+std::string
+PriorityQueue::GetWeights (void) const
+{
+  std::ostringstream out;
+  for (uint32_t i = 0; i < m_weights.size (); i++)
+  {
+    out << (i == 0 ? "" : ",") << m_weights[i];
+  }
+  return out.str ();
+}
+
+void
+PriorityQueue::SetSharedBuffer (Ptr<SharedBuffer> buffer)
+{
+  NS_LOG_FUNCTION (this << buffer);
+  NS_ASSERT_MSG (m_buffer == 0 && m_totalpackets == 0, "Cannot move a PriorityQueue to another shared buffer");
+  m_buffer = buffer;
+  m_bufferPort = buffer->AddPort (m_classes.size ());
+}
+
+Ptr<SharedBuffer>
+PriorityQueue::GetSharedBuffer (void) const
+{
+  return m_buffer;
+}
+
+uint32_t
+PriorityQueue::GetClassPackets (uint32_t cls) const
+{
+  NS_ASSERT (cls < m_classes.size ());
+  return m_classes[cls].m_packets.size ();
+}
+
+uint32_t
+PriorityQueue::GetClassBytes (uint32_t cls) const
+{
+  NS_ASSERT (cls < m_classes.size ());
+  return m_classes[cls].m_bytes;
+}
+
 uint16_t 
-PriorityQueue::GetPriorityFromPacket(Ptr <const Packet> p)
+PriorityQueue::ClassifyPacket (Ptr <const Packet> p, Entry &entry) const
 {
   PriorityTag tag;
-  bool peeked = p->PeekPacketTag(tag);
-  if (!peeked)
+  entry.m_flow = 0;
+  entry.m_seq = 0;
+  if (!p->PeekPacketTag(tag))
   {
     //some rare flagged packets sent directly from l4 might not contain the tag...in that case, just assume 0 priority
     return 0;
   }
-  NS_ASSERT(tag.GetTypeId().GetName() == "ns3::PriorityTag");
-  return tag.GetPriority();
+  entry.m_flow = tag.GetId();
+  entry.m_seq = tag.m_seq;
+  uint16_t pr = tag.GetPriority();
+  //enqueue on basis of priority...also take priority 0 into consideration 
+  if (pr >= m_classes.size()) {
+    pr = m_classes.size() - 1;
+  }
+  return pr;
 }
 
-uint32_t 
-PriorityQueue::GetIdFromPacket(Ptr <const Packet> p)
+void
+PriorityQueue::RemoveEntry (uint32_t cls, EntryList::iterator it)
 {
-  PriorityTag tag;
-  bool peeked = p->PeekPacketTag(tag);
-  if (!peeked)
+  Class &c = m_classes[cls];
+  uint32_t size = it->m_packet->GetSize ();
+  c.m_bytes -= size;
+  m_bytesInQueue -= size;
+  m_totalpackets--;
+  c.m_packets.erase (it);
+  if (c.m_packets.empty ())
   {
-    //some rare flagged packets sent directly from l4 might not contain the tag...in that case, just assume 0 priority
-    return 0;
+    m_nonEmpty &= ~(1u << cls);
+  }
+  if (m_buffer != 0)
+  {
+    m_buffer->Release (m_bufferPort, cls, size);
   }
-  NS_ASSERT(tag.GetTypeId().GetName() == "ns3::PriorityTag");
-  return tag.GetId();
 }
 
+void
+PriorityQueue::DropArrival (Ptr<Packet> p, uint16_t cls)
+{
+  if (m_buffer != 0)
+  {
+    m_buffer->Release (m_bufferPort, cls, p->GetSize ());
+  }
+  Drop (p);
+}
 
+Ptr<Packet>
+PriorityQueue::PopHead (uint32_t cls)
+{
+  Class &c = m_classes[cls];
+  Entry &entry = c.m_packets.front ();
+  Ptr<Packet> p = entry.m_packet;
+  FlowIndex::iterator flow = c.m_flows.find (entry.m_flow);
+  flow->second.pop_front ();
+  if (flow->second.empty ())
+  {
+    c.m_flows.erase (flow);
+  }
+  RemoveEntry (cls, c.m_packets.begin ());
+  c.m_dequeued++;
+  return p;
+}
+
+uint32_t
+PriorityQueue::GetQuantum (uint32_t cls) const
+{
+  return m_quantum * (cls < m_weights.size () ? m_weights[cls] : 1);
+}
 
 bool
 PriorityQueue::DropPacket(uint16_t pr)
 {
-  uint32_t i;
-  Ptr<Packet> p;
-  for (i=NUM_PRIORITY_QUEUES-1;i>pr;i--)
+  // Non-empty classes of lower priority than pr
+  uint32_t lower = m_nonEmpty & ~((2u << pr) - 1);
+  if (lower == 0)
   {
-    if (m_packets[i].empty())
-    {
-      //NS_LOG_LOGIC("Queue"<<i+1<<" is empty");
-      continue;
-    }
- 
-    p = m_packets[i].back();
-    m_packets[i].pop_back();
-    
-    /*std::ofstream ofsdrop("drops.txt",std::ios::app);
-    ofsdrop<<"1\n";*/
-    Drop (p);
-    m_totalpackets--;
-    m_bytesInQueue -= p->GetSize ();
-    m_bytesInSubQueue[i] -= p->GetSize ();
-    m_nPackets--;
-    m_nBytes -= p->GetSize ();
-    
-    NS_LOG_LOGIC("Dropped packet from queue"<<i+1);
-    NS_LOG_ERROR("Dropped packet");
-    return true;
+    return false;
   }
-  return false;
+  uint32_t i = 31 - __builtin_clz (lower);
+  Class &c = m_classes[i];
+  EntryList::iterator it = --c.m_packets.end ();
+  Ptr<Packet> p = it->m_packet;
+  FlowIndex::iterator flow = c.m_flows.find (it->m_flow);
+  flow->second.pop_back ();
+  if (flow->second.empty ())
+  {
+    c.m_flows.erase (flow);
+  }
+  RemoveEntry (i, it);
+
+  /*std::ofstream ofsdrop("drops.txt",std::ios::app);
+  ofsdrop<<"1\n";*/
+  Drop (p);
+  m_nPackets--;
+  m_nBytes -= p->GetSize ();
+
+  NS_LOG_LOGIC("Dropped packet from queue"<<i+1);
+  NS_LOG_ERROR("Dropped packet");
+  return true;
 }
 
 uint32_t PriorityQueue::drainLowPriority(uint32_t flowid){
-  uint32_t i;
-  Ptr<Packet> p;
-  
   uint32_t mindrop = 0;
-  for (i=NUM_PRIORITY_QUEUES-1;i>0;i--)
+  for (uint32_t i = m_classes.size() - 1; i > 0; i--)
   {
-    std::deque<Ptr<Packet> > backup;
-
-    while (!m_packets[i].empty())
+    Class &c = m_classes[i];
+    FlowIndex::iterator flow = c.m_flows.find (flowid);
+    if (flow == c.m_flows.end ())
     {
-      p = m_packets[i].back();
-      m_packets[i].pop_back();
-     
-      PriorityTag tag;
-      bool peeked = p->PeekPacketTag(tag);
-      if (peeked && flowid == tag.GetId()){ 
-        Drop (p);
-        m_totalpackets--;
-        m_bytesInQueue -= p->GetSize ();
-        m_bytesInSubQueue[i] -= p->GetSize ();
-        m_nPackets--;
-        m_nBytes -= p->GetSize ();
-        if (tag.m_seq > mindrop){
-          mindrop = tag.m_seq;
-        }
-      } else{
-        backup.push_front(p);
+      continue;
+    }
+    std::deque<EntryList::iterator> &entries = flow->second;
+    while (!entries.empty ())
+    {
+      EntryList::iterator it = entries.back ();
+      entries.pop_back ();
+      Ptr<Packet> p = it->m_packet;
+      if (it->m_seq > mindrop){
+        mindrop = it->m_seq;
       }
-    }  
-    while(!backup.empty()){
-      p = backup.front();
-      backup.pop_front();
-      m_packets[i].push_back(p);
+      RemoveEntry (i, it);
+      Drop (p);
+      m_nPackets--;
+      m_nBytes -= p->GetSize ();
     }
+    c.m_flows.erase (flow);
     NS_LOG_LOGIC("Drained queue "<<i);
   }
   return mindrop;
@@ -231,26 +360,23 @@ void PriorityQueue::FlushOutFlowPackets(uint32_t flowId)
   //flushing out packets with priority flowId
   NS_LOG_FUNCTION (this<<m_id);
 
-  for (int i=NUM_PRIORITY_QUEUES-1;i>=1;i--)
+  for (uint32_t i = m_classes.size() - 1; i >= 1; i--)
   {
-    int j = 0;
-    while ((m_packets[i].begin() + j) != m_packets[i].end())
+    Class &c = m_classes[i];
+    FlowIndex::iterator flow = c.m_flows.find (flowId);
+    if (flow == c.m_flows.end ())
     {
-      std::deque< Ptr<Packet> >::iterator it = m_packets[i].begin() + j;
-      if (GetIdFromPacket(*it) == flowId)
-      {
-        NS_LOG_INFO("Erasing packet from queue "<<i);
-        m_totalpackets--;
-        m_bytesInQueue -= (*it)->GetSize ();
-        m_bytesInSubQueue[i] -= (*it)->GetSize ();
-        m_nPackets--;
-        m_nBytes -= (*it)->GetSize ();
-        m_packets[i].erase(m_packets[i].begin() + j);
-      }
-      else {
-        j++;
-      }
+      continue;
     }
+    std::deque<EntryList::iterator> &entries = flow->second;
+    for (std::deque<EntryList::iterator>::iterator it = entries.begin (); it != entries.end (); it++)
+    {
+      NS_LOG_INFO("Erasing packet from queue "<<i);
+      m_nPackets--;
+      m_nBytes -= (*it)->m_packet->GetSize ();
+      RemoveEntry (i, *it);
+    }
+    c.m_flows.erase (flow);
   }
 }
 
@@ -260,21 +386,29 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this << p << m_id);
   bool dropped = true;
-  uint16_t pr;
-
-  pr = GetPriorityFromPacket(p);
+  Entry entry;
+  uint16_t pr = ClassifyPacket(p, entry);
 
   NS_LOG_LOGIC("Enqueueing in priority queue");
   //p->Print(std::cout);
   //std::cout<<std::endl;
 
+  // Ask the shared buffer first, so that no packet of a lower class is
+  // evicted to make room for one the buffer then refuses
+  if (m_buffer != 0 && !m_buffer->Admit (m_bufferPort, pr, p->GetSize ()))
+  {
+    NS_LOG_LOGIC ("Shared buffer full for queue " << pr);
+    Drop (p);
+    return false;
+  }
+
   if (m_mode == QUEUE_MODE_PACKETS && (m_totalpackets >= m_maxPackets))
   {
     NS_LOG_LOGIC ("Queue full (at max packets) -- droppping pkt");
     dropped = DropPacket(pr);
     if (!dropped)
     {
-      Drop (p);
+      DropArrival (p, pr);
       NS_LOG_LOGIC("Dropped the packet from queue 0");
       return false;
     }
@@ -288,7 +422,7 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
     }
     if ((m_bytesInQueue + p->GetSize() >= m_maxBytes) && (!dropped))
     {
-      Drop (p);
+      DropArrival (p, pr);
       NS_LOG_LOGIC("Dropped the packet from queue 0");
       return false;
     }
@@ -305,7 +439,7 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
       //dropped = DropPacket(pr);
       //if(!dropped)
       //{
-        Drop (p);
+        DropArrival (p, pr);
       
         NS_LOG_LOGIC("Dropped the packet from queue 0");
         return false;
@@ -313,20 +447,22 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
     }
   } 
 
-  
-
-  //enqueue on basis of priority...also take priority 0 into consideration 
-  if (pr>=NUM_PRIORITY_QUEUES) {
-    pr = NUM_PRIORITY_QUEUES - 1;
+  Class &c = m_classes[pr];
+  entry.m_packet = p;
+  c.m_packets.push_back(entry);
+  c.m_flows[entry.m_flow].push_back(--c.m_packets.end());
+  m_nonEmpty |= 1u << pr;
+  if (!m_weights.empty() && !c.m_active)
+  {
+    c.m_active = true;
+    m_active.push_back(pr);
   }
 
-  m_packets[pr].push_back(p);
-
-  m_bytesInSubQueue[pr] += p->GetSize ();
+  c.m_bytes += p->GetSize ();
   m_bytesInQueue += p->GetSize ();
   m_totalpackets++; 
   
-  NS_LOG_INFO(Simulator::Now().GetSeconds()<<": "<<m_id<<"\t Enqueueing in queue "<<pr<<" Total bytes in subqueue = "<<m_bytesInSubQueue[pr]);
+  NS_LOG_INFO(Simulator::Now().GetSeconds()<<": "<<m_id<<"\t Enqueueing in queue "<<pr<<" Total bytes in subqueue = "<<c.m_bytes);
   
   NS_LOG_LOGIC ("Number packets " << m_totalpackets);
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
@@ -335,61 +471,141 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
 }
 
 Ptr<Packet>
-PriorityQueue::DoDequeue (void)
+PriorityQueue::DequeueDrr (uint32_t &i)
 {
-  //dequeue based on priority
-  int i;
-  NS_LOG_FUNCTION (this<<m_id);
-
-  for(i=0;i<NUM_PRIORITY_QUEUES;i++)
-  //for(i=NUM_PRIORITY_QUEUES-1; i>=0; i--)
+  while (true)
   {
-    while (!m_packets[i].empty ())
+    i = m_active.front ();
+    Class &c = m_classes[i];
+    if (!c.m_packets.empty ())
     {
+      if (m_activeFresh)
+      {
+        c.m_deficit += GetQuantum (i);
+        m_activeFresh = false;
+      }
+      uint32_t size = c.m_packets.front ().m_packet->GetSize ();
+      if (c.m_deficit >= size)
+      {
+        c.m_deficit -= size;
         NS_LOG_LOGIC(Simulator::Now().GetSeconds()<<":Dequeuing from queue"<<i);
-        Ptr<Packet> p = m_packets[i].front ();
-        m_packets[i].pop_front ();
-        m_bytesInQueue -= p->GetSize ();
-        m_bytesInSubQueue[i] -= p->GetSize ();
-        m_totalpackets--;
-
-        NS_LOG_LOGIC ("Popped " << p);
-        //p->Print(std::cout);
-        //std::cout<<std::endl;     
-        NS_LOG_LOGIC ("Number packets " << m_totalpackets);
-        NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-        counts[i]++;
-        NS_LOG_INFO(Simulator::Now().GetSeconds()<<": "<<m_id<<"\t Dequeueing in queue "<<i<<" Total bytes in subqueue = "<<m_bytesInSubQueue[i]);
+        Ptr<Packet> p = PopHead (i);
+        if (c.m_packets.empty ())
+        {
+          // A class leaves the round with no credit
+          c.m_active = false;
+          c.m_deficit = 0;
+          m_active.pop_front ();
+          m_activeFresh = true;
+        }
         return p;
+      }
+      // Out of credit, serve the next class
+      m_active.push_back (i);
     }
+    else
+    {
+      // Emptied by drops or flushes
+      c.m_active = false;
+      c.m_deficit = 0;
+    }
+    m_active.pop_front ();
+    m_activeFresh = true;
   }
-  NS_LOG_LOGIC ("All queues empty");
-  return 0;
-
 }
 
-Ptr<const Packet>
-PriorityQueue::DoPeek (void) const
+uint32_t
+PriorityQueue::PeekDrrClass (void) const
 {
-  NS_LOG_FUNCTION (this);
-  int i;
-
-  for(i=0;i<NUM_PRIORITY_QUEUES;i++)
+  // Number the turns DequeueDrr () would give the classes from now on: the
+  // front is at turn 0 and the class at position i of n gets its k-th
+  // quantum at turn (k - 1) * n + i, or k * n for a front that already got
+  // its quantum.  The first class with enough credit is served.
+  uint32_t n = m_active.size ();
+  uint32_t best = 0;
+  uint64_t bestTurn = 0;
+  bool found = false;
+  for (uint32_t i = 0; i < n; i++)
   {
-    if (m_packets[i].empty ())
+    uint32_t cls = m_active[i];
+    const Class &c = m_classes[cls];
+    if (c.m_packets.empty ())
     {
-      NS_LOG_LOGIC ("Queue empty");
       continue;
     }
+    uint32_t size = c.m_packets.front ().m_packet->GetSize ();
+    uint32_t quantum = GetQuantum (cls);
+    uint32_t needed = size > c.m_deficit ? size - c.m_deficit : 0;
+    uint64_t quanta = (needed + quantum - 1) / quantum;
+    uint64_t turn;
+    if (i == 0 && !m_activeFresh)
+    {
+      turn = quanta * n;
+    }
+    else
+    {
+      turn = (std::max (quanta, (uint64_t)1) - 1) * n + i;
+    }
+    if (!found || turn < bestTurn)
+    {
+      best = cls;
+      bestTurn = turn;
+      found = true;
+    }
+  }
+  return best;
+}
 
-    Ptr<Packet> p = m_packets[i].front ();
+Ptr<Packet>
+PriorityQueue::DoDequeue (void)
+{
+  //dequeue based on priority
+  NS_LOG_FUNCTION (this<<m_id);
 
-    NS_LOG_LOGIC ("Number packets " << m_totalpackets);
-    NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-    return p;
+  if (m_totalpackets == 0)
+  {
+    NS_LOG_LOGIC ("All queues empty");
+    return 0;
   }
-  NS_LOG_LOGIC ("All queues empty");
-  return 0;
+
+  Ptr<Packet> p;
+  uint32_t i;
+  if (m_weights.empty ())
+  {
+    i = __builtin_ctz (m_nonEmpty);
+    NS_LOG_LOGIC(Simulator::Now().GetSeconds()<<":Dequeuing from queue"<<i);
+    p = PopHead (i);
+  }
+  else
+  {
+    p = DequeueDrr (i);
+  }
+
+  NS_LOG_LOGIC ("Popped " << p);
+  //p->Print(std::cout);
+  //std::cout<<std::endl;     
+  NS_LOG_LOGIC ("Number packets " << m_totalpackets);
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+  NS_LOG_INFO(Simulator::Now().GetSeconds()<<": "<<m_id<<"\t Dequeueing in queue "<<i<<" Total bytes in subqueue = "<<m_classes[i].m_bytes);
+  return p;
+}
+
+Ptr<const Packet>
+PriorityQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_totalpackets == 0)
+  {
+    NS_LOG_LOGIC ("All queues empty");
+    return 0;
+  }
+  uint32_t i = m_weights.empty () ? __builtin_ctz (m_nonEmpty) : PeekDrrClass ();
+  Ptr<Packet> p = m_classes[i].m_packets.front ().m_packet;
+
+  NS_LOG_LOGIC ("Number packets " << m_totalpackets);
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+  return p;
 }
 
 } // namespace ns3
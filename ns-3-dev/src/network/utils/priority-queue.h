@@ -16,21 +16,41 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-#ifndef DROPTAIL_H
-#define DROPTAIL_H
+#ifndef PRIORITY_QUEUE_H
+#define PRIORITY_QUEUE_H
 
 #include <queue>
+#include <list>
+#include <vector>
 #include "ns3/packet.h"
 #include "ns3/queue.h"
+#include "ns3/event-id.h"
+#include "sgi-hashmap.h"
+#include "shared-buffer.h"
 
 #define NUM_PRIORITY_QUEUES 5    
+#define MAX_PRIORITY_QUEUES 32
 //#define BUFSZ 1000000
 
 namespace ns3 {
 
 class TraceContainer;
 
-//defining priority queue
+/**
+ * \brief Queue with one FIFO per PriorityTag class
+ *
+ * Class 0 is served first and tags at or above the number of classes (such
+ * as the control packets' UINT8_MAX) go to the last class.  When the queue
+ * is full, packets are dropped from the tail of the lowest priority class.
+ * Setting Weights serves the classes by byte-mode deficit round robin
+ * instead, each class getting Quantum times its weight bytes per round.
+ * Enqueue and dequeue are O(1) in the number of packets, and every class
+ * indexes its packets by flow so that dropping a flow only touches the
+ * packets of that flow.
+ *
+ * With a SharedBuffer, every class is also admitted against the buffer
+ * shared with the other ports of the node, on top of MaxBytes/MaxPackets.
+ */
 class PriorityQueue : public Queue {
 public:
   static TypeId GetTypeId (void);
@@ -61,18 +81,84 @@ public:
   uint32_t drainLowPriority(uint32_t sourceport);
   void FlushOutFlowPackets(uint32_t flowId);
 
+  /**
+   * Set the number of classes, only while the queue is empty
+   */
+  void SetClasses (uint32_t classes);
+  uint32_t GetClasses (void) const;
+
+  /**
+   * Set the deficit round robin weights of the classes from a comma
+   * separated list, e.g. "4,2,1"; classes past the end of the list weigh 1.
+   * An empty list selects strict priority.
+   */
+  void SetWeights (std::string weights);
+  std::string GetWeights (void) const;
+
+  /**
+   * Allocate packets from a buffer shared with other queues, before the
+   * first packet is enqueued
+   */
+  void SetSharedBuffer (Ptr<SharedBuffer> buffer);
+  Ptr<SharedBuffer> GetSharedBuffer (void) const;
+
+  uint32_t GetClassPackets (uint32_t cls) const;
+  uint32_t GetClassBytes (uint32_t cls) const;
+
 private:
   virtual bool DoEnqueue (Ptr<Packet> p);
   virtual Ptr<Packet> DoDequeue (void);
   virtual Ptr<const Packet> DoPeek (void) const;
   bool DropPacket(uint16_t);
-  uint16_t GetPriorityFromPacket(Ptr<const Packet>);
-  uint32_t GetIdFromPacket(Ptr<const Packet>);
   void LogQueueLength();
 
-  uint32_t counts[NUM_PRIORITY_QUEUES];
-  std::deque<Ptr<Packet> > m_packets[NUM_PRIORITY_QUEUES];
-  uint32_t m_bytesInSubQueue[NUM_PRIORITY_QUEUES];
+  /// A queued packet with the fields of its PriorityTag
+  struct Entry
+  {
+    Ptr<Packet> m_packet;
+    uint32_t m_flow;
+    uint32_t m_seq;
+  };
+  typedef std::list<Entry> EntryList;
+  /// Packets of each flow in the order they sit in the class
+  typedef sgi::hash_map<uint32_t, std::deque<EntryList::iterator> > FlowIndex;
+
+  struct Class
+  {
+    Class () : m_bytes (0), m_dequeued (0), m_deficit (0), m_active (false) {}
+    EntryList m_packets;
+    FlowIndex m_flows;
+    uint32_t m_bytes;
+    uint32_t m_dequeued;
+    /// Deficit round robin credit in bytes
+    uint32_t m_deficit;
+    /// Whether the class is in m_active
+    bool m_active;
+  };
+
+  uint16_t ClassifyPacket (Ptr<const Packet> p, Entry &entry) const;
+  /// Remove a packet from its class and the queue's byte and packet counts
+  void RemoveEntry (uint32_t cls, EntryList::iterator it);
+  /// Drop an arriving packet, returning what the shared buffer admitted
+  void DropArrival (Ptr<Packet> p, uint16_t cls);
+  /// Pop the head of a class
+  Ptr<Packet> PopHead (uint32_t cls);
+  uint32_t GetQuantum (uint32_t cls) const;
+  /// The class deficit round robin serves next, without changing its state
+  uint32_t PeekDrrClass (void) const;
+  Ptr<Packet> DequeueDrr (uint32_t &cls);
+
+  std::vector<Class> m_classes;
+  /// Bit i is set while class i holds packets
+  uint32_t m_nonEmpty;
+  std::vector<uint32_t> m_weights;
+  uint32_t m_quantum;
+  /// Classes with packets in deficit round robin order; the front is
+  /// being served and got its quantum unless m_activeFresh is set
+  std::deque<uint32_t> m_active;
+  bool m_activeFresh;
+  Ptr<SharedBuffer> m_buffer;
+  uint32_t m_bufferPort;
   uint32_t m_totalpackets;
   uint32_t m_maxPackets;
   uint32_t m_maxBytes;
@@ -88,4 +174,4 @@ private:
 
 } // namespace ns3
 
-#endif /* PRIORITY_H */
+#endif /* PRIORITY_QUEUE_H */
@@ -0,0 +1,220 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/string.h"
+#include "ns3/trace-source-accessor.h"
+#include "shared-buffer.h"
+
+NS_LOG_COMPONENT_DEFINE ("SharedBuffer");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (SharedBuffer);
+
+TypeId
+SharedBuffer::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SharedBuffer")
+    .SetParent<Object> ()
+    .AddConstructor<SharedBuffer> ()
+    .AddAttribute ("Size",
+                   "Bytes of the buffer, reservations included.",
+                   UintegerValue (9 * 1024 * 1024),
+                   MakeUintegerAccessor (&SharedBuffer::m_size),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Alpha",
+                   "A queue may hold this many times the free shared bytes beyond its reservation.",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&SharedBuffer::m_alpha),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("Reserved",
+                   "Comma separated bytes reserved for every port queue of each class.",
+                   StringValue (""),
+                   MakeStringAccessor (&SharedBuffer::SetReserved,
+                                       &SharedBuffer::GetReserved),
+                   MakeStringChecker ())
+    .AddTraceSource ("Occupancy",
+                     "Bytes held by all queues",
+                     MakeTraceSourceAccessor (&SharedBuffer::m_occupancy))
+    .AddTraceSource ("AdmissionDrop",
+                     "A packet found its queue over the threshold: port, class, bytes",
+                     MakeTraceSourceAccessor (&SharedBuffer::m_dropTrace))
+  ;
+  return tid;
+}
+
+SharedBuffer::SharedBuffer ()
+  : m_size (0),
+    m_alpha (1.0),
+    m_totalReserved (0),
+    m_sharedUsed (0),
+    m_drops (0),
+    m_peak (0),
+    m_occupancy (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SharedBuffer::~SharedBuffer ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+SharedBuffer::SetReserved (std::string reserved)
+{
+  NS_LOG_FUNCTION (this << reserved);
+  NS_ASSERT_MSG (m_queues.empty (), "Cannot change the reservations of a SharedBuffer in use");
+  m_reserved.clear ();
+  std::istringstream in (reserved);
+  std::string bytes;
+  while (std::getline (in, bytes, ','))
+    {
+      m_reserved.push_back (atoi (bytes.c_str ()));
+    }
+}
+
+std::string
+SharedBuffer::GetReserved (void) const
+{
+  std::ostringstream out;
+  for (uint32_t i = 0; i < m_reserved.size (); i++)
+    {
+      out << (i == 0 ? "" : ",") << m_reserved[i];
+    }
+  return out.str ();
+}
+
+uint32_t
+SharedBuffer::GetReservation (uint32_t cls) const
+{
+  return cls < m_reserved.size () ? m_reserved[cls] : 0;
+}
+
+uint32_t
+SharedBuffer::AddPort (uint32_t classes)
+{
+  NS_LOG_FUNCTION (this << classes);
+  for (uint32_t cls = 0; cls < classes; cls++)
+    {
+      m_totalReserved += GetReservation (cls);
+    }
+  NS_ASSERT_MSG (m_totalReserved <= m_size, "SharedBuffer reservations exceed its size");
+  m_queues.push_back (std::vector<uint32_t> (classes, 0));
+  return m_queues.size () - 1;
+}
+
+bool
+SharedBuffer::Admit (uint32_t port, uint32_t cls, uint32_t bytes)
+{
+  NS_LOG_FUNCTION (this << port << cls << bytes);
+  NS_ASSERT (port < m_queues.size () && cls < m_queues[port].size ());
+  uint32_t &used = m_queues[port][cls];
+  uint32_t reserved = GetReservation (cls);
+  // Bytes of the queue in the shared pool before and after the packet
+  uint32_t before = used > reserved ? used - reserved : 0;
+  uint32_t after = used + bytes > reserved ? used + bytes - reserved : 0;
+  if (after > before)
+    {
+      uint32_t free = GetSharedSize () - m_sharedUsed;
+      if (after - before > free || before >= m_alpha * free)
+        {
+          NS_LOG_LOGIC ("Port " << port << " class " << cls << " over its threshold, " << free << " shared bytes free");
+          m_drops++;
+          m_dropTrace (port, cls, bytes);
+          return false;
+        }
+      m_sharedUsed += after - before;
+    }
+  used += bytes;
+  m_occupancy = m_occupancy + bytes;
+  m_peak = std::max (m_peak, m_occupancy.Get ());
+  return true;
+}
+
+void
+SharedBuffer::Release (uint32_t port, uint32_t cls, uint32_t bytes)
+{
+  NS_LOG_FUNCTION (this << port << cls << bytes);
+  NS_ASSERT (port < m_queues.size () && cls < m_queues[port].size ());
+  uint32_t &used = m_queues[port][cls];
+  NS_ASSERT (used >= bytes);
+  uint32_t reserved = GetReservation (cls);
+  uint32_t before = used > reserved ? used - reserved : 0;
+  used -= bytes;
+  uint32_t after = used > reserved ? used - reserved : 0;
+  m_sharedUsed -= before - after;
+  m_occupancy = m_occupancy - bytes;
+}
+
+uint32_t
+SharedBuffer::GetNPorts (void) const
+{
+  return m_queues.size ();
+}
+
+uint32_t
+SharedBuffer::GetOccupancy (void) const
+{
+  return m_occupancy;
+}
+
+uint32_t
+SharedBuffer::GetPeakOccupancy (void) const
+{
+  return m_peak;
+}
+
+uint32_t
+SharedBuffer::GetSharedOccupancy (void) const
+{
+  return m_sharedUsed;
+}
+
+uint32_t
+SharedBuffer::GetSharedSize (void) const
+{
+  return m_size - m_totalReserved;
+}
+
+uint32_t
+SharedBuffer::GetQueueOccupancy (uint32_t port, uint32_t cls) const
+{
+  NS_ASSERT (port < m_queues.size () && cls < m_queues[port].size ());
+  return m_queues[port][cls];
+}
+
+uint32_t
+SharedBuffer::GetThreshold (uint32_t port, uint32_t cls) const
+{
+  NS_ASSERT (port < m_queues.size () && cls < m_queues[port].size ());
+  return GetReservation (cls) + (uint32_t)(m_alpha * (GetSharedSize () - m_sharedUsed));
+}
+
+uint64_t
+SharedBuffer::GetAdmissionDrops (void) const
+{
+  return m_drops;
+}
+
+} // namespace ns3
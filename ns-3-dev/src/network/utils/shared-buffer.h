@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SHARED_BUFFER_H
+#define SHARED_BUFFER_H
+
+#include <string>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/traced-value.h"
+#include "ns3/traced-callback.h"
+
+namespace ns3 {
+
+/**
+ * \brief Packet buffer shared by the port queues of a switch
+ *
+ * Every (port, class) queue owns a reservation; bytes beyond it come from
+ * the shared pool, which is what remains of Size after the reservations of
+ * all ports.  A queue may only grow into the pool while its shared bytes
+ * stay below Alpha times the free shared bytes (dynamic thresholds, as in
+ * Broadcom switch ASICs), so one congested port cannot take the whole
+ * buffer and the limit tightens as the buffer fills.
+ *
+ * Queues call AddPort () once, then Admit () for every arriving packet and
+ * Release () for every packet that leaves.
+ */
+class SharedBuffer : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SharedBuffer ();
+  virtual ~SharedBuffer ();
+
+  /**
+   * Register a port queue with this many classes
+   * \returns the port number to pass to Admit () and Release ()
+   */
+  uint32_t AddPort (uint32_t classes);
+
+  /**
+   * Account for a packet arriving at a queue
+   * \returns false if the packet must be dropped
+   */
+  bool Admit (uint32_t port, uint32_t cls, uint32_t bytes);
+  /// Return the bytes of a packet that left a queue
+  void Release (uint32_t port, uint32_t cls, uint32_t bytes);
+
+  /**
+   * Set the bytes reserved for each (port, class) queue from a comma
+   * separated list per class, e.g. "3000,1500"; classes past the end of the
+   * list reserve nothing.  Only before ports are added.
+   */
+  void SetReserved (std::string reserved);
+  std::string GetReserved (void) const;
+
+  uint32_t GetNPorts (void) const;
+  /// Bytes held by all queues
+  uint32_t GetOccupancy (void) const;
+  /// Most bytes held by all queues at once
+  uint32_t GetPeakOccupancy (void) const;
+  /// Bytes held in the shared pool
+  uint32_t GetSharedOccupancy (void) const;
+  /// Bytes of the pool not reserved by any queue
+  uint32_t GetSharedSize (void) const;
+  /// Bytes held by one queue
+  uint32_t GetQueueOccupancy (uint32_t port, uint32_t cls) const;
+  /// Largest number of bytes the queue could hold right now
+  uint32_t GetThreshold (uint32_t port, uint32_t cls) const;
+  uint64_t GetAdmissionDrops (void) const;
+
+private:
+  uint32_t GetReservation (uint32_t cls) const;
+
+  uint32_t m_size;
+  double m_alpha;
+  std::vector<uint32_t> m_reserved;
+  uint32_t m_totalReserved;
+  /// Bytes held by each queue, indexed by port then class
+  std::vector<std::vector<uint32_t> > m_queues;
+  uint32_t m_sharedUsed;
+  uint64_t m_drops;
+  uint32_t m_peak;
+  TracedValue<uint32_t> m_occupancy;
+  /// Port, class and bytes of a packet that was refused
+  TracedCallback<uint32_t, uint32_t, uint32_t> m_dropTrace;
+};
+
+} // namespace ns3
+
+#endif /* SHARED_BUFFER_H */
@@ -25,6 +25,9 @@
 #include "ns3/point-to-point-channel.h"
 #include "ns3/point-to-point-remote-channel.h"
 #include "ns3/queue.h"
+#include "ns3/priority-queue.h"
+#include "ns3/drop-tail-queue.h"
+#include "ns3/shared-buffer.h"
 #include "ns3/config.h"
 #include "ns3/packet.h"
 #include "ns3/names.h"
@@ -39,8 +42,10 @@ NS_LOG_COMPONENT_DEFINE ("PointToPointHelper");
 namespace ns3 {
 
 PointToPointHelper::PointToPointHelper ()
+  : m_sharedBuffer (false)
 {
   m_queueFactory.SetTypeId ("ns3::DropTailQueue");
+  m_bufferFactory.SetTypeId ("ns3::SharedBuffer");
   m_deviceFactory.SetTypeId ("ns3::PointToPointNetDevice");
   m_channelFactory.SetTypeId ("ns3::PointToPointChannel");
   m_remoteChannelFactory.SetTypeId ("ns3::PointToPointRemoteChannel");
@@ -60,6 +65,44 @@ PointToPointHelper::SetQueue (std::string type,
   m_queueFactory.Set (n4, v4);
 }
 
+void 
+PointToPointHelper::SetSharedBuffer (std::string n1, const AttributeValue &v1,
+                                     std::string n2, const AttributeValue &v2,
+                                     std::string n3, const AttributeValue &v3)
+{
+  m_sharedBuffer = true;
+  m_bufferFactory.Set (n1, v1);
+  m_bufferFactory.Set (n2, v2);
+  m_bufferFactory.Set (n3, v3);
+}
+
+void
+PointToPointHelper::AttachSharedBuffer (Ptr<Node> node, Ptr<Queue> queue)
+{
+  if (!m_sharedBuffer)
+    {
+      return;
+    }
+  Ptr<PriorityQueue> priorityQueue = DynamicCast<PriorityQueue> (queue);
+  Ptr<DropTailQueue> dropTailQueue = DynamicCast<DropTailQueue> (queue);
+  NS_ABORT_MSG_UNLESS (priorityQueue != 0 || dropTailQueue != 0,
+                       "Shared buffers need ns3::PriorityQueue or ns3::DropTailQueue queues");
+  Ptr<SharedBuffer> buffer = node->GetObject<SharedBuffer> ();
+  if (buffer == 0)
+    {
+      buffer = m_bufferFactory.Create<SharedBuffer> ();
+      node->AggregateObject (buffer);
+    }
+  if (priorityQueue != 0)
+    {
+      priorityQueue->SetSharedBuffer (buffer);
+    }
+  else
+    {
+      dropTailQueue->SetSharedBuffer (buffer);
+    }
+}
+
 void 
 PointToPointHelper::SetDeviceAttribute (std::string n1, const AttributeValue &v1)
 {
@@ -231,11 +274,13 @@ PointToPointHelper::Install (Ptr<Node> a, Ptr<Node> b)
   a->AddDevice (devA);
   Ptr<Queue> queueA = m_queueFactory.Create<Queue> ();
   devA->SetQueue (queueA);
+  AttachSharedBuffer (a, queueA);
   Ptr<PointToPointNetDevice> devB = m_deviceFactory.Create<PointToPointNetDevice> ();
   devB->SetAddress (Mac48Address::Allocate ());
   b->AddDevice (devB);
   Ptr<Queue> queueB = m_queueFactory.Create<Queue> ();
   devB->SetQueue (queueB);
+  AttachSharedBuffer (b, queueB);
   // If MPI is enabled, we need to see if both nodes have the same system id 
   // (rank), and the rank is the same as this instance.  If both are true, 
   //use a normal p2p channel, otherwise use a remote channel
@@ -76,6 +76,23 @@ public:
                  std::string n3 = "", const AttributeValue &v3 = EmptyAttributeValue (),
                  std::string n4 = "", const AttributeValue &v4 = EmptyAttributeValue ());
 
+  /**
+   * Make the queues of each node allocate from a ns3::SharedBuffer with
+   * these attributes, created when the node gets its first device from
+   * this helper and aggregated to it.  The queues must be
+   * ns3::PriorityQueue or ns3::DropTailQueue, and keep their own limits.
+   *
+   * \param n1 the name of the attribute to set on the buffer
+   * \param v1 the value of the attribute to set on the buffer
+   * \param n2 the name of the attribute to set on the buffer
+   * \param v2 the value of the attribute to set on the buffer
+   * \param n3 the name of the attribute to set on the buffer
+   * \param v3 the value of the attribute to set on the buffer
+   */
+  void SetSharedBuffer (std::string n1 = "", const AttributeValue &v1 = EmptyAttributeValue (),
+                        std::string n2 = "", const AttributeValue &v2 = EmptyAttributeValue (),
+                        std::string n3 = "", const AttributeValue &v3 = EmptyAttributeValue ());
+
   /**
    * Set an attribute value to be propagated to each NetDevice created by the
    * helper.
@@ -177,7 +194,14 @@ private:
     Ptr<NetDevice> nd,
     bool explicitFilename);
 
+  /**
+   * \brief Attach a queue to the shared buffer of its node, if enabled.
+   */
+  void AttachSharedBuffer (Ptr<Node> node, Ptr<Queue> queue);
+
   ObjectFactory m_queueFactory;
+  ObjectFactory m_bufferFactory;
+  bool m_sharedBuffer;
   ObjectFactory m_channelFactory;
   ObjectFactory m_remoteChannelFactory;
   ObjectFactory m_deviceFactory;
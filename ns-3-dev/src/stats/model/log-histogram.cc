@@ -0,0 +1,260 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include "ns3/assert.h"
+#include "log-histogram.h"
+
+namespace ns3 {
+
+LogHistogram::LogHistogram (double precision, double minValue)
+  : m_precision (precision),
+    m_minValue (minValue)
+{
+  NS_ASSERT_MSG (precision > 0 && precision < 1, "Precision must be in (0, 1)");
+  NS_ASSERT_MSG (minValue > 0, "Minimum value must be positive");
+  m_logGamma = std::log ((1 + precision) / (1 - precision));
+  Reset ();
+}
+
+void
+LogHistogram::Reset (void)
+{
+  m_count = 0;
+  m_mean = 0;
+  m_m2 = 0;
+  m_min = 0;
+  m_max = 0;
+  m_buckets.clear ();
+}
+
+int32_t
+LogHistogram::GetBucket (double value) const
+{
+  if (value < m_minValue)
+    {
+      return 0;
+    }
+  return 1 + (int32_t)std::floor (std::log (value / m_minValue) / m_logGamma);
+}
+
+double
+LogHistogram::GetBucketValue (int32_t bucket) const
+{
+  if (bucket == 0)
+    {
+      return 0;
+    }
+  // lower * (1 + p) = 2 * lower * gamma / (1 + gamma) is within the
+  // precision of both ends of [lower, lower * gamma)
+  double lower = m_minValue * std::exp ((bucket - 1) * m_logGamma);
+  return lower * (1 + m_precision);
+}
+
+void
+LogHistogram::Update (double value)
+{
+  NS_ASSERT_MSG (value >= 0, "LogHistogram counts non-negative values");
+  m_count++;
+  if (m_count == 1)
+    {
+      m_min = value;
+      m_max = value;
+    }
+  else
+    {
+      m_min = std::min (m_min, value);
+      m_max = std::max (m_max, value);
+    }
+  double delta = value - m_mean;
+  m_mean += delta / m_count;
+  m_m2 += delta * (value - m_mean);
+  m_buckets[GetBucket (value)]++;
+}
+
+void
+LogHistogram::Merge (const LogHistogram &other)
+{
+  NS_ASSERT_MSG (m_precision == other.m_precision && m_minValue == other.m_minValue,
+                 "Only histograms with the same buckets merge");
+  if (other.m_count == 0)
+    {
+      return;
+    }
+  if (m_count == 0)
+    {
+      *this = other;
+      return;
+    }
+  // Chan et al.'s pairwise update of the moments
+  uint64_t count = m_count + other.m_count;
+  double delta = other.m_mean - m_mean;
+  m_mean += delta * other.m_count / count;
+  m_m2 += other.m_m2 + delta * delta * ((double)m_count * other.m_count / count);
+  m_count = count;
+  m_min = std::min (m_min, other.m_min);
+  m_max = std::max (m_max, other.m_max);
+  for (std::map<int32_t, uint64_t>::const_iterator it = other.m_buckets.begin (); it != other.m_buckets.end (); it++)
+    {
+      m_buckets[it->first] += it->second;
+    }
+}
+
+double
+LogHistogram::GetQuantile (double q) const
+{
+  if (m_count == 0)
+    {
+      return NaN;
+    }
+  if (q <= 0)
+    {
+      return m_min;
+    }
+  if (q >= 1)
+    {
+      return m_max;
+    }
+  double rank = q * (m_count - 1);
+  uint64_t seen = 0;
+  for (std::map<int32_t, uint64_t>::const_iterator it = m_buckets.begin (); it != m_buckets.end (); it++)
+    {
+      seen += it->second;
+      if (seen > rank)
+        {
+          return std::min (m_max, std::max (m_min, GetBucketValue (it->first)));
+        }
+    }
+  return m_max;
+}
+
+double
+LogHistogram::GetPrecision (void) const
+{
+  return m_precision;
+}
+
+uint32_t
+LogHistogram::GetNBuckets (void) const
+{
+  return m_buckets.size ();
+}
+
+long
+LogHistogram::getCount () const
+{
+  return m_count;
+}
+
+double
+LogHistogram::getSum () const
+{
+  return m_mean * m_count;
+}
+
+double
+LogHistogram::getSqrSum () const
+{
+  return m_m2 + m_mean * m_mean * m_count;
+}
+
+double
+LogHistogram::getMin () const
+{
+  return m_count == 0 ? NaN : m_min;
+}
+
+double
+LogHistogram::getMax () const
+{
+  return m_count == 0 ? NaN : m_max;
+}
+
+double
+LogHistogram::getMean () const
+{
+  return m_count == 0 ? NaN : m_mean;
+}
+
+double
+LogHistogram::getStddev () const
+{
+  return std::sqrt (getVariance ());
+}
+
+double
+LogHistogram::getVariance () const
+{
+  if (m_count == 0)
+    {
+      return NaN;
+    }
+  return m_count == 1 ? 0 : m_m2 / (m_count - 1);
+}
+
+void
+LogHistogram::Serialize (std::ostream &os) const
+{
+  std::streamsize precision = os.precision (17);
+  os << m_precision << " " << m_minValue << " " << m_count << " " << m_mean << " " << m_m2
+     << " " << m_min << " " << m_max << " " << m_buckets.size ();
+  for (std::map<int32_t, uint64_t>::const_iterator it = m_buckets.begin (); it != m_buckets.end (); it++)
+    {
+      os << " " << it->first << ":" << it->second;
+    }
+  os.precision (precision);
+}
+
+bool
+LogHistogram::Deserialize (std::istream &is)
+{
+  double precision;
+  double minValue;
+  uint32_t buckets;
+  LogHistogram result;
+  if (!(is >> precision >> minValue) || !(precision > 0 && precision < 1) || !(minValue > 0))
+    {
+      return false;
+    }
+  result = LogHistogram (precision, minValue);
+  if (!(is >> result.m_count >> result.m_mean >> result.m_m2 >> result.m_min >> result.m_max >> buckets))
+    {
+      return false;
+    }
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < buckets; i++)
+    {
+      int32_t bucket;
+      char colon;
+      uint64_t count;
+      if (!(is >> bucket >> colon >> count) || colon != ':')
+        {
+          return false;
+        }
+      result.m_buckets[bucket] = count;
+      total += count;
+    }
+  if (total != result.m_count)
+    {
+      return false;
+    }
+  *this = result;
+  return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,99 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_HISTOGRAM_H
+#define LOG_HISTOGRAM_H
+
+#include <iostream>
+#include <map>
+#include "data-calculator.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup stats
+ * \brief Streaming moments and quantiles of non-negative values
+ *
+ * Values are counted in logarithmically sized buckets, so quantiles are
+ * within the relative error given to the constructor whatever the number
+ * of values, while memory grows only with the range they span.  Values
+ * below the minimum share one bucket.  Moments are exact and kept with
+ * Welford's method; the variance is the sample variance, as in
+ * MinMaxAvgTotalCalculator.
+ *
+ * Histograms of equal precision and minimum merge exactly, so summaries of
+ * separate runs can be combined into the summary of all of them.
+ */
+class LogHistogram : public StatisticalSummary
+{
+public:
+  /**
+   * \param precision relative error of quantiles, in (0, 1)
+   * \param minValue smallest value told apart from 0
+   */
+  LogHistogram (double precision = 0.01, double minValue = 1e-9);
+
+  void Update (double value);
+  /// Add the values counted by other
+  void Merge (const LogHistogram &other);
+  void Reset (void);
+
+  /// Value of quantile q in [0, 1]; the minimum and maximum are exact
+  double GetQuantile (double q) const;
+  double GetPrecision (void) const;
+  /// Number of non-empty buckets
+  uint32_t GetNBuckets (void) const;
+
+  virtual long getCount () const;
+  virtual double getSum () const;
+  virtual double getSqrSum () const;
+  virtual double getMin () const;
+  virtual double getMax () const;
+  virtual double getMean () const;
+  virtual double getStddev () const;
+  virtual double getVariance () const;
+
+  /**
+   * Write the histogram as one line of space-separated fields: precision,
+   * minimum value, count, mean, sum of squared deviations, min, max, the
+   * number of buckets and then index:count per bucket.
+   */
+  void Serialize (std::ostream &os) const;
+  /// Read what Serialize wrote; false if it is malformed
+  bool Deserialize (std::istream &is);
+
+private:
+  int32_t GetBucket (double value) const;
+  double GetBucketValue (int32_t bucket) const;
+
+  double m_precision;
+  double m_minValue;
+  /// log of the bucket growth factor (1 + precision) / (1 - precision)
+  double m_logGamma;
+  uint64_t m_count;
+  double m_mean;
+  /// Sum of squared deviations from the mean
+  double m_m2;
+  double m_min;
+  double m_max;
+  /// Bucket 0 counts values below m_minValue, bucket i > 0 values in
+  /// [m_minValue * gamma^(i - 1), m_minValue * gamma^i)
+  std::map<int32_t, uint64_t> m_buckets;
+};
+
+} // namespace ns3
+
+#endif /* LOG_HISTOGRAM_H */
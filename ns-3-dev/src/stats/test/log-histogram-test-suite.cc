@@ -0,0 +1,122 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+#include <sstream>
+
+#include "ns3/test.h"
+#include "ns3/log-histogram.h"
+
+using namespace ns3;
+
+class LogHistogramTestCase : public TestCase
+{
+public:
+  LogHistogramTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LogHistogramTestCase::LogHistogramTestCase ()
+  : TestCase ("Quantiles within the precision, exact moments and merges")
+{
+}
+
+void
+LogHistogramTestCase::DoRun (void)
+{
+  // 1 ms to 1 s, the odd ones and the even ones counted separately
+  LogHistogram all (0.01);
+  LogHistogram odd (0.01);
+  LogHistogram even (0.01);
+  for (uint32_t i = 1; i <= 1000; i++)
+    {
+      all.Update (i * 1e-3);
+      (i % 2 ? odd : even).Update (i * 1e-3);
+    }
+  NS_TEST_ASSERT_MSG_EQ (all.getCount (), 1000, "count");
+  NS_TEST_EXPECT_MSG_EQ_TOL (all.getMean (), 0.5005, 1e-12, "mean");
+  NS_TEST_EXPECT_MSG_EQ_TOL (all.getVariance (), 1000 * 1001 / 12.0 * 1e-6, 1e-9, "sample variance");
+  NS_TEST_EXPECT_MSG_EQ (all.getMin (), 1e-3, "exact minimum");
+  NS_TEST_EXPECT_MSG_EQ (all.getMax (), 1.0, "exact maximum");
+  NS_TEST_EXPECT_MSG_EQ_TOL (all.GetQuantile (0.5), 0.5005, 0.5005 * 0.01, "median");
+  NS_TEST_EXPECT_MSG_EQ_TOL (all.GetQuantile (0.99), 0.99001, 0.99001 * 0.01, "99th percentile");
+  NS_TEST_EXPECT_MSG_EQ (all.GetQuantile (0), 1e-3, "quantile 0");
+  NS_TEST_EXPECT_MSG_EQ (all.GetQuantile (1), 1.0, "quantile 1");
+  // ln (1000) / ln (1.01 / 0.99) buckets at most
+  NS_TEST_EXPECT_MSG_LT (all.GetNBuckets (), 350, "memory bound by the range");
+
+  // Merged halves are the whole, also through a serialized summary
+  std::ostringstream summary;
+  odd.Serialize (summary);
+  LogHistogram merged;
+  std::istringstream in (summary.str ());
+  NS_TEST_ASSERT_MSG_EQ (merged.Deserialize (in), true, "read back " << summary.str ());
+  merged.Merge (even);
+  NS_TEST_EXPECT_MSG_EQ (merged.getCount (), 1000, "merged count");
+  NS_TEST_EXPECT_MSG_EQ_TOL (merged.getMean (), all.getMean (), 1e-12, "merged mean");
+  NS_TEST_EXPECT_MSG_EQ_TOL (merged.getVariance (), all.getVariance (), 1e-12, "merged variance");
+  NS_TEST_EXPECT_MSG_EQ (merged.getMin (), all.getMin (), "merged minimum");
+  NS_TEST_EXPECT_MSG_EQ (merged.GetNBuckets (), all.GetNBuckets (), "merged buckets");
+  for (double q = 0.05; q < 1; q += 0.05)
+    {
+      NS_TEST_EXPECT_MSG_EQ (merged.GetQuantile (q), all.GetQuantile (q), "merged quantile " << q);
+    }
+
+  // Values at either edge of a bucket read back within the precision; the
+  // smallest and largest values keep the quantile from being clamped
+  double gamma = 1.01 / 0.99;
+  double edges[] = { 1e-3 * pow (gamma, 10) * (1 + 1e-9),
+                     1e-3 * pow (gamma, 11) * (1 - 1e-9) };
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      LogHistogram edge (0.01, 1e-3);
+      edge.Update (1e-6);
+      for (uint32_t j = 0; j < 3; j++)
+        {
+          edge.Update (edges[i]);
+        }
+      edge.Update (1.0);
+      NS_TEST_EXPECT_MSG_EQ_TOL (edge.GetQuantile (0.5), edges[i], edges[i] * 0.01 * (1 + 1e-6),
+                                 "bucket edge " << i);
+    }
+
+  // Zero and values below the minimum share a bucket
+  LogHistogram small;
+  small.Update (0);
+  small.Update (1e-12);
+  NS_TEST_EXPECT_MSG_EQ (small.GetNBuckets (), 1, "one bucket below the minimum");
+  NS_TEST_EXPECT_MSG_EQ (small.GetQuantile (0.5), 0, "below the minimum reads as 0");
+
+  std::istringstream bad ("0.01 1e-09 3 1 0 1 1 1 5:2");
+  NS_TEST_EXPECT_MSG_EQ (small.Deserialize (bad), false, "bucket counts must add up");
+  NS_TEST_EXPECT_MSG_EQ (small.getCount (), 2, "left alone on error");
+}
+
+class LogHistogramTestSuite : public TestSuite
+{
+public:
+  LogHistogramTestSuite ();
+};
+
+LogHistogramTestSuite::LogHistogramTestSuite ()
+  : TestSuite ("log-histogram", UNIT)
+{
+  AddTestCase (new LogHistogramTestCase);
+}
+
+static LogHistogramTestSuite logHistogramTestSuite;